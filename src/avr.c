@@ -33,7 +33,7 @@
 
 #include "tpi.h"
 
-FP_UpdateProgress update_progress;
+AVRDUDE_TLS FP_UpdateProgress update_progress;
 
 // TPI: returns nonzero if NVM controller busy, 0 if free
 int avr_tpi_poll_nvmbsy(const PROGRAMMER *pgm) {
@@ -47,6 +47,75 @@ int avr_tpi_poll_nvmbsy(const PROGRAMMER *pgm) {
   return (res & TPI_IOREG_NVMCSR_NVMBSY);
 }
 
+/*
+ * Wait for an NVM controller to finish the operation identified by key,
+ * typically the NVM command just issued
+ *
+ * poll() returns 0 once the NVM controller is ready, 1 while it is busy and a
+ * negative value on error. Each poll costs a programmer round trip, so rather
+ * than polling back to back, sleep through most of the time the operation is
+ * expected to take and then poll with exponential back-off. The expected time
+ * is seeded with the min_write_delay of mem (if any) and afterwards tracks
+ * the completion times observed in this session: it moves towards the
+ * elapsed time when the controller was still busy at the first poll and
+ * shrinks by an eighth when it was already ready, as then the elapsed time
+ * only measures the sleep. Key AVR_NVM_NOCMD means no command is pending;
+ * such waits poll right away and are not learned from. Give up after
+ * timeout_us or twice the max_write_delay of mem, whichever is larger.
+ */
+int avr_nvm_wait(const PROGRAMMER *pgm, const AVRPART *p, int (*poll)(const PROGRAMMER *pgm, const AVRPART *p),
+  int key, const AVRMEM *mem, unsigned long timeout_us) {
+
+  int nocmd = (key & 0xff) == AVR_NVM_NOCMD;
+  unsigned long *learned = cx->avr_nvm_wait_us + (key & 0xff);
+  unsigned long expected = nocmd? 0: *learned? *learned:
+    mem && mem->min_write_delay > 0? (unsigned long) mem->min_write_delay: 0;
+  unsigned long backoff = expected/16, elapsed;
+  uint64_t start = avr_ustimestamp();
+  int rc, slept = expected >= AVR_NVM_MIN_SLEEP_US, nbusy = 0;
+
+  if(mem && mem->max_write_delay > 0 && 2UL*mem->max_write_delay > timeout_us)
+    timeout_us = 2UL*mem->max_write_delay;
+  if(slept)                     // Waking up early costs a poll, late costs idle time
+    usleep(expected - expected/8);
+  if(backoff < AVR_NVM_MIN_BACKOFF_US)
+    backoff = AVR_NVM_MIN_BACKOFF_US;
+
+  while((rc = poll(pgm, p)) > 0) {
+    nbusy++;
+    if(avr_ustimestamp() - start > timeout_us) {
+      pmsg_error("NVM controller still busy after %.1f ms\n", timeout_us/1000.0);
+      return LIBAVRDUDE_GENERAL_FAILURE;
+    }
+    usleep(backoff);
+    if(backoff < AVR_NVM_MAX_BACKOFF_US)
+      backoff *= 2;
+  }
+  if(rc < 0 || nocmd)
+    return rc;
+
+  elapsed = avr_ustimestamp() - start;
+  if(slept && !nbusy)           // Slept too long: elapsed says nothing about the busy time
+    *learned = expected - expected/8;
+  else
+    *learned = *learned? (3*(*learned) + elapsed)/4: elapsed;
+  if(!*learned)                 // Keep 0 for not yet observed
+    *learned = 1;
+  pmsg_debug("%s(key 0x%02x) took %lu us with %d busy poll%s, now expecting %lu us\n", __func__,
+    key & 0xff, elapsed, nbusy, str_plural(nbusy), *learned);
+
+  return 0;
+}
+
+static int avr_tpi_nvm_poll(const PROGRAMMER *pgm, const AVRPART *p) {
+  return avr_tpi_poll_nvmbsy(pgm) != 0;
+}
+
+// TPI: wait until the NVM controller has finished NVM command cmd (TPI_NVMCMD_NO_OPERATION: none pending)
+int avr_tpi_wait_nvm(const PROGRAMMER *pgm, const AVRPART *p, const AVRMEM *mem, int cmd) {
+  return avr_nvm_wait(pgm, p, avr_tpi_nvm_poll, cmd, mem, AVR_NVM_TIMEOUT_US);
+}
+
 // TPI chip erase sequence
 int avr_tpi_chip_erase(const PROGRAMMER *pgm, const AVRPART *p) {
   int err;
@@ -82,19 +151,17 @@ int avr_tpi_chip_erase(const PROGRAMMER *pgm, const AVRPART *p) {
       0xFF
     };
 
-    while(avr_tpi_poll_nvmbsy(pgm))
-      continue;
-
-    err = pgm->cmd_tpi(pgm, cmd, sizeof(cmd), NULL, 0);
+    err = avr_tpi_wait_nvm(pgm, p, NULL, TPI_NVMCMD_NO_OPERATION);
+    if(!err)
+      err = pgm->cmd_tpi(pgm, cmd, sizeof(cmd), NULL, 0);
+    if(!err)
+      err = avr_tpi_wait_nvm(pgm, p, mem, TPI_NVMCMD_CHIP_ERASE);
     if(err) {
       led_set(pgm, LED_ERR);
       led_clr(pgm, LED_PGM);
       return err;
     }
 
-    while(avr_tpi_poll_nvmbsy(pgm))
-      continue;
-
     led_clr(pgm, LED_PGM);
     return 0;
   } else {
@@ -252,8 +319,8 @@ int avr_read_byte_default(const PROGRAMMER *pgm, const AVRPART *p, const AVRMEM
       goto error;
     }
 
-    while(avr_tpi_poll_nvmbsy(pgm))
-      continue;
+    if(avr_tpi_wait_nvm(pgm, p, NULL, TPI_NVMCMD_NO_OPERATION) < 0)
+      goto error;
 
     // Setup for read
     avr_tpi_setup_rw(pgm, mem, addr, TPI_NVMCMD_NO_OPERATION);
@@ -317,6 +384,129 @@ rcerror:
   return rc;
 }
 
+/*
+ * Issue the n 4-byte SPI commands in cmds[] and store their 4-byte results
+ * in res[]; programmers with a cmd_multi() method send them as one transfer,
+ * others one by one through cmd(). Return 0 on success and < 0 on failure.
+ */
+int avr_cmd_multi(const PROGRAMMER *pgm, const unsigned char *cmds, unsigned char *res, int n) {
+  if(pgm->cmd_multi)
+    return pgm->cmd_multi(pgm, cmds, res, n);
+
+  if(pgm->cmd == NULL) {
+    pmsg_error("%s programmer uses %s() without providing a cmd() method\n", pgm->type, __func__);
+    return -1;
+  }
+  for(int i = 0; i < n; i++)
+    if(pgm->cmd(pgm, cmds + 4*i, res + 4*i) < 0)
+      return -1;
+
+  return 0;
+}
+
+#define AVR_CMDQ_MAX 128        // Max number of SPI commands flushed in one transfer
+
+// Queue of SPI commands whose results are scattered back into a memory buffer
+typedef struct {
+  unsigned char cmd[4*AVR_CMDQ_MAX], res[4*AVR_CMDQ_MAX];
+  const OPCODE *op[AVR_CMDQ_MAX]; // Read opcode for extracting the result, NULL if not needed
+  unsigned char *dst[AVR_CMDQ_MAX]; // Where to put the result byte
+  int n;
+} Cmd_queue;
+
+static void cmdq_add(Cmd_queue *q, const OPCODE *op, unsigned long addr, const OPCODE *rdop,
+  unsigned char *dst) {
+
+  unsigned char *cmd = q->cmd + 4*q->n;
+
+  memset(cmd, 0, 4);
+  avr_set_bits(op, cmd);
+  avr_set_addr(op, cmd, addr);
+  q->op[q->n] = rdop;
+  q->dst[q->n] = dst;
+  q->n++;
+}
+
+static int cmdq_flush(const PROGRAMMER *pgm, Cmd_queue *q) {
+  int n = q->n;
+
+  q->n = 0;
+  if(!n)
+    return 0;
+  if(avr_cmd_multi(pgm, q->cmd, q->res, n) < 0)
+    return -1;
+  for(int i = 0; i < n; i++)
+    if(q->op[i]) {
+      unsigned char data = 0;
+
+      avr_get_output(q->op[i], q->res + 4*i, &data);
+      *q->dst[i] = data;
+    }
+
+  return 0;
+}
+
+/*
+ * Read the bytes of an SPI-programmed memory that need reading (all of them
+ * when vmem is NULL) by queueing the read commands and flushing them in
+ * batches through avr_cmd_multi(); the load extended address command is only
+ * queued when it changes. This is what avr_read_byte_default() does one byte
+ * at a time. Return 0 on success and < 0 on failure.
+ */
+static int avr_read_mem_cmdq(const PROGRAMMER *pgm, const AVRPART *p, const AVRMEM *mem,
+  const AVRMEM *vmem) {
+
+  const OPCODE *lext = mem->op[AVR_OP_LOAD_EXT_ADDR];
+  unsigned char lastext[4] = { 0 };
+  int haveext = 0, ntrans = 0, nbytes = 0, rc = 0;
+  Cmd_queue *q = mmt_malloc(sizeof *q);
+
+  for(unsigned long i = 0; i < (unsigned long) mem->size; i++) {
+    if(vmem && !(vmem->tags[i] & TAG_ALLOCATED))
+      continue;
+
+    const OPCODE *readop = mem->op[AVR_OP_READ];
+    unsigned long addr = i;
+
+    if(mem->op[AVR_OP_READ_LO]) {
+      readop = mem->op[i & 1? AVR_OP_READ_HI: AVR_OP_READ_LO];
+      addr = i/2;
+    }
+    if(!readop) {
+      rc = -1;
+      break;
+    }
+    if(q->n + 2 > AVR_CMDQ_MAX) { // Room for a load extended address and a read command
+      if((rc = cmdq_flush(pgm, q)) < 0)
+        break;
+      ntrans++;
+      report_progress(i, mem->size, NULL);
+    }
+    if(lext) {
+      unsigned char ext[4] = { 0 };
+
+      avr_set_bits(lext, ext);
+      avr_set_addr(lext, ext, addr);
+      if(!haveext || memcmp(ext, lastext, 4)) {
+        cmdq_add(q, lext, addr, NULL, NULL);
+        memcpy(lastext, ext, 4);
+        haveext = 1;
+      }
+    }
+    cmdq_add(q, readop, addr + avr_sigrow_offset(p, mem, addr), readop, mem->buf + i);
+    nbytes++;
+  }
+  if(rc == 0 && q->n) {
+    rc = cmdq_flush(pgm, q);
+    ntrans++;
+  }
+  if(rc == 0)
+    avr_count_io(mem, 0, ntrans, nbytes);
+  mmt_free(q);
+
+  return rc;
+}
+
 /*
  * Return the number of interesting bytes in a flash memory buffer, interesting
  * being defined as up to the last non-0xff data value. This is useful for
@@ -345,6 +535,41 @@ ok:
   return ret;
 }
 
+#define AVR_PAGE_BATCH 32       // Max number of pages handed over per multi-page call
+
+/*
+ * Transfer the npages pages described by pages[] using the programmer's
+ * multi-page callback in batches of up to AVR_PAGE_BATCH pages; this lets
+ * programmers keep several requests in flight rather than wait for each page.
+ *
+ * Return 0 on success and < 0 on failure.
+ */
+static int avr_paged_multi(const PROGRAMMER *pgm, const AVRPART *p, const AVRMEM *mem,
+  int write, const Page_desc *pages, int npages) {
+
+  for(int k = 0; k < npages; k += AVR_PAGE_BATCH) {
+    int nb = npages - k < AVR_PAGE_BATCH? npages - k: AVR_PAGE_BATCH;
+    int rc = write?
+      pgm->paged_write_multi(pgm, p, mem, mem->page_size, pages + k, nb):
+      pgm->paged_load_multi(pgm, p, mem, mem->page_size, pages + k, nb);
+
+    if(rc < 0) {
+      pmsg_debug("%s(): multi-page %s of %s failed at 0x%04x\n", __func__,
+        write? "write": "read", mem->desc, pages[k].addr);
+      avr_count_retry(mem);     // Caller falls back to byte access
+      return rc;
+    }
+    unsigned long nbytes = 0;
+
+    for(int j = k; j < k + nb; j++)
+      nbytes += pages[j].n;
+    avr_count_io(mem, write, 1, nbytes);
+    report_progress(k + nb, npages, NULL);
+  }
+
+  return 0;
+}
+
 /*
  * Read the entirety of the specified memory into the corresponding buffer of
  * the avrpart pointed to by p. If v is non-NULL, verify against v's memory
@@ -386,8 +611,11 @@ int avr_read_mem(const PROGRAMMER *pgm, const AVRPART *p, const AVRMEM *mem, con
   // Supports paged load thru post-increment
   if(is_tpi(p) && mem->page_size > 1 && mem->size%mem->page_size == 0 && pgm->cmd_tpi != NULL) {
 
-    while(avr_tpi_poll_nvmbsy(pgm))
-      continue;
+    if(avr_tpi_wait_nvm(pgm, p, NULL, TPI_NVMCMD_NO_OPERATION) < 0) {
+      led_set(pgm, LED_ERR);
+      led_clr(pgm, LED_PGM);
+      return -1;
+    }
 
     // Setup for read (NOOP)
     avr_tpi_setup_rw(pgm, mem, 0, TPI_NVMCMD_NO_OPERATION);
@@ -431,33 +659,50 @@ int avr_read_mem(const PROGRAMMER *pgm, const AVRPART *p, const AVRMEM *mem, con
       // Check whether this page must be read
       for(i = pageaddr; i < pageaddr + mem->page_size; i++) {
         // No verify: read everything; verify: only read needed pages in input file
-        if(vmem == NULL || (mem->tags[i] & TAG_ALLOCATED) != 0) {
+        if(vmem == NULL || (vmem->tags[i] & TAG_ALLOCATED) != 0) {
           npages++;
           break;
         }
       }
     }
 
-    for(pageaddr = 0, failure = 0, nread = 0;
-      !failure && pageaddr < (unsigned int) mem->size; pageaddr += mem->page_size) {
+    failure = 0;
+    if(pgm->paged_load_multi) { // Hand over pages in batches so the programmer can pipeline them
+      Page_desc *pages = mmt_malloc((mem->size/mem->page_size + 1)*sizeof *pages);
+      int n = 0;
 
-      // Check whether this page must be read
-      for(i = pageaddr, need_read = 0; i < pageaddr + mem->page_size; i++) {
-        // No verify: read everything; verify: only read needed pages in input file
-        if(vmem == NULL || (vmem->tags[i] & TAG_ALLOCATED) != 0) {
-          need_read = 1;
-          break;
+      for(pageaddr = 0; pageaddr < (unsigned int) mem->size; pageaddr += mem->page_size)
+        for(i = pageaddr; i < pageaddr + mem->page_size; i++)
+          if(vmem == NULL || (vmem->tags[i] & TAG_ALLOCATED) != 0) {
+            pages[n++] = (Page_desc) { pageaddr, mem->page_size };
+            break;
+          }
+      if(avr_paged_multi(pgm, p, mem, 0, pages, n) < 0)
+        failure = 1;            // Fall back to byte-at-a-time read below
+      mmt_free(pages);
+    } else {
+      for(pageaddr = 0, nread = 0; !failure && pageaddr < (unsigned int) mem->size; pageaddr += mem->page_size) {
+        // Check whether this page must be read
+        for(i = pageaddr, need_read = 0; i < pageaddr + mem->page_size; i++) {
+          // No verify: read everything; verify: only read needed pages in input file
+          if(vmem == NULL || (vmem->tags[i] & TAG_ALLOCATED) != 0) {
+            need_read = 1;
+            break;
+          }
+        }
+        if(need_read) {
+          rc = pgm->paged_load(pgm, p, mem, mem->page_size, pageaddr, mem->page_size);
+          if(rc < 0) {
+            // Paged load failed, fall back to byte-at-a-time read below
+            failure = 1;
+            avr_count_retry(mem);
+          } else
+            avr_count_io(mem, 0, 1, mem->page_size);
+          nread++;
+          report_progress(nread, npages, NULL);
+        } else {
+          pmsg_debug("%s(): skipping page %u: no interesting data\n", __func__, pageaddr/mem->page_size);
         }
-      }
-      if(need_read) {
-        rc = pgm->paged_load(pgm, p, mem, mem->page_size, pageaddr, mem->page_size);
-        if(rc < 0)
-          // Paged load failed, fall back to byte-at-a-time read below
-          failure = 1;
-        nread++;
-        report_progress(nread, npages, NULL);
-      } else {
-        pmsg_debug("%s(): skipping page %u: no interesting data\n", __func__, pageaddr/mem->page_size);
       }
     }
     if(!failure) {
@@ -478,9 +723,20 @@ int avr_read_mem(const PROGRAMMER *pgm, const AVRPART *p, const AVRMEM *mem, con
     }
   }
 
+  // SPI programmers read byte by byte: batch the commands if that saves round trips
+  if(pgm->cmd_multi && pgm->read_byte == avr_read_byte_default && !is_tpi(p)) {
+    if(avr_read_mem_cmdq(pgm, p, mem, vmem) == 0) {
+      led_clr(pgm, LED_PGM);
+      return avr_mem_hiaddr(mem);
+    }
+    pmsg_notice2("batched read of %s failed, falling back to byte-at-a-time read\n", mem->desc);
+  }
+
   for(i = 0; i < (unsigned long) mem->size; i++) {
     if(vmem == NULL || (vmem->tags[i] & TAG_ALLOCATED) != 0) {
       rc = pgm->read_byte(pgm, p, mem, i, mem->buf + i);
+      if(rc == LIBAVRDUDE_SUCCESS && pgm->read_byte != avr_read_byte_cached)
+        avr_count_io(mem, 0, 1, 1);
       if(rc != LIBAVRDUDE_SUCCESS) {
         pmsg_error("unable to read byte at address 0x%04lx\n", i);
         if(rc == LIBAVRDUDE_GENERAL_FAILURE) {
@@ -504,6 +760,115 @@ int avr_read_mem(const PROGRAMMER *pgm, const AVRPART *p, const AVRMEM *mem, con
   return avr_mem_hiaddr(mem);
 }
 
+static const uint32_t crc32_nibble[16] = {
+  0x00000000, 0x1db71064, 0x3b6e20c8, 0x26d930ac, 0x76dc4190, 0x6b6b51f4, 0x4db26158, 0x5005713c,
+  0xedb88320, 0xf00f9344, 0xd6d6a3e8, 0xcb61b38c, 0x9b64c2b0, 0x86d3d2d4, 0xa00ae278, 0xbdbdf21c,
+};
+
+// CRC-32 (IEEE 802.3, as used by zlib) of buf continuing from crc; start with crc = 0
+uint32_t avr_crc32(uint32_t crc, const unsigned char *buf, size_t n) {
+  crc = ~crc;
+  while(n--) {
+    crc ^= *buf++;
+    crc = (crc >> 4) ^ crc32_nibble[crc & 15];
+    crc = (crc >> 4) ^ crc32_nibble[crc & 15];
+  }
+
+  return ~crc;
+}
+
+#define AVR_CRC_CHUNK 1024      // Checksum allocated data in ranges of at most this size
+
+/*
+ * Compare the device contents of mem in [addr, addr+n) with buf + addr via
+ * the programmer's checksum() callback. Return 1 if the CRCs match, 0 if they
+ * do not and < 0 if the programmer cannot checksum this range.
+ */
+static int avr_crc_matches(const PROGRAMMER *pgm, const AVRPART *p, const AVRMEM *mem,
+  const unsigned char *buf, unsigned int addr, unsigned int n) {
+
+  uint32_t crc;
+
+  if(!pgm->checksum || !avr_has_paged_access(pgm, p, mem))
+    return LIBAVRDUDE_NOTSUPPORTED;
+  if(pgm->checksum(pgm, p, mem, addr, n, &crc) < 0)
+    return LIBAVRDUDE_GENERAL_FAILURE;
+
+  return crc == avr_crc32(0, buf + addr, n);
+}
+
+/*
+ * Read memory mem of part p for a subsequent avr_verify_mem() against v. When
+ * the programmer can checksum device memory, compare device CRCs of the
+ * allocated ranges in v with those computed by the host; only the pages of
+ * mismatching ranges are read back, whilst matching ranges are copied from v.
+ * Otherwise, or when the programmer cannot checksum this memory, read all
+ * needed pages with avr_read_mem().
+ *
+ * Return the number of bytes read, or < 0 if an error occurs.
+ */
+int avr_read_mem_verify(const PROGRAMMER *pgm, const AVRPART *p, const AVRMEM *mem, const AVRPART *v) {
+  AVRMEM *vmem = v? avr_locate_mem(v, mem->desc): NULL;
+  unsigned char *tags;
+  int chunk, nranges = 0, nmatch = 0, rc;
+
+  if(!pgm->checksum || !vmem || mem->size <= 0 || vmem->size != mem->size ||
+    !avr_has_paged_access(pgm, p, mem))
+    return avr_read_mem(pgm, p, mem, v);
+
+  pmsg_debug("%s(%s, %s, %s, %s)\n", __func__, pgmid, p->id, mem->desc, v->desc);
+
+  chunk = AVR_CRC_CHUNK > mem->page_size? AVR_CRC_CHUNK - AVR_CRC_CHUNK%mem->page_size: mem->page_size;
+  tags = mmt_malloc(mem->size); // Copy of vmem tags with matching ranges unallocated
+  memcpy(tags, vmem->tags, mem->size);
+
+  for(int beg = 0; beg < mem->size; beg += chunk) {
+    int end = beg + chunk > mem->size? mem->size: beg + chunk;
+
+    for(int i = beg, j; i < end; i = j) {
+      for(; i < end && !(tags[i] & TAG_ALLOCATED); i++)
+        continue;
+      for(j = i; j < end && (tags[j] & TAG_ALLOCATED); j++)
+        continue;
+      if(i == j)
+        break;
+      nranges++;
+      if((rc = avr_crc_matches(pgm, p, mem, vmem->buf, i, j - i)) < 0) {
+        pmsg_debug("%s(): cannot checksum %s, reading back instead\n", __func__, mem->desc);
+        mmt_free(tags);
+        return avr_read_mem(pgm, p, mem, v);
+      }
+      if(rc) {
+        for(int k = i; k < j; k++)
+          tags[k] &= ~TAG_ALLOCATED;
+        nmatch++;
+      }
+    }
+  }
+  pmsg_notice2("%d of %d %s range%s verified by device checksum\n", nmatch, nranges, mem->desc,
+    str_plural(nranges));
+
+  if(nmatch < nranges) {        // Read back mismatching ranges only
+    unsigned char *vtags = vmem->tags;
+
+    vmem->tags = tags;
+    rc = avr_read_mem(pgm, p, mem, v);
+    vmem->tags = vtags;
+    if(rc < 0) {
+      mmt_free(tags);
+      return rc;
+    }
+  } else {
+    memset(mem->buf, 0xff, mem->size);
+  }
+  for(int i = 0; i < mem->size; i++) // Device holds the same as v where the CRCs matched
+    if((vmem->tags[i] & TAG_ALLOCATED) && !(tags[i] & TAG_ALLOCATED))
+      mem->buf[i] = vmem->buf[i];
+  mmt_free(tags);
+
+  return avr_mem_hiaddr(mem);
+}
+
 // Write a page data at the specified address
 int avr_write_page(const PROGRAMMER *pgm, const AVRPART *p, const AVRMEM *mem, unsigned long addr) {
 
@@ -692,8 +1057,8 @@ int avr_write_byte_default(const PROGRAMMER *pgm, const AVRPART *p, const AVRMEM
       goto error;
     }
 
-    while(avr_tpi_poll_nvmbsy(pgm))
-      continue;
+    if((rc = avr_tpi_wait_nvm(pgm, p, NULL, TPI_NVMCMD_NO_OPERATION)) < 0)
+      goto error;
 
     // Must erase fuse first
     if(mem_is_a_fuse(mem)) {    // TPI parts only have one fuse
@@ -706,8 +1071,8 @@ int avr_write_byte_default(const PROGRAMMER *pgm, const AVRPART *p, const AVRMEM
       if((rc = pgm->cmd_tpi(pgm, cmd, 2, NULL, 0)) < 0)
         goto error;
 
-      while(avr_tpi_poll_nvmbsy(pgm))
-        continue;
+      if((rc = avr_tpi_wait_nvm(pgm, p, mem, TPI_NVMCMD_SECTION_ERASE)) < 0)
+        goto error;
     }
 
     // Setup for WORD_WRITE
@@ -723,8 +1088,8 @@ int avr_write_byte_default(const PROGRAMMER *pgm, const AVRPART *p, const AVRMEM
     if((rc = pgm->cmd_tpi(pgm, cmd, 2, NULL, 0)) < 0)
       goto error;
 
-    while(avr_tpi_poll_nvmbsy(pgm))
-      continue;
+    if((rc = avr_tpi_wait_nvm(pgm, p, mem, TPI_NVMCMD_WORD_WRITE)) < 0)
+      goto error;
 
     goto success;
   }
@@ -857,6 +1222,8 @@ int avr_write_byte_default(const PROGRAMMER *pgm, const AVRPART *p, const AVRMEM
     }
 
     tries++;
+    if(!ready)
+      avr_count_retry(mem);
     if(!ready && tries > 5) {
       /*
        * We wrote the data, but after waiting for what should have been plenty
@@ -905,6 +1272,16 @@ int avr_write_byte(const PROGRAMMER *pgm, const AVRPART *p, const AVRMEM *mem,
   return pgm->write_byte(pgm, p, mem, addr, data);
 }
 
+/*
+ * Can the programmer erase individual flash pages of part p? A non-NULL
+ * page_erase() is not enough: JTAG drivers keep it for the usersig memory of
+ * classic parts but cannot page erase their flash. Only PDI/UPDI parts offer
+ * flash page erase to external programmers; bootloaders erase pages as needed.
+ */
+int avr_can_page_erase_flash(const PROGRAMMER *pgm, const AVRPART *p) {
+  return is_spm(pgm) || (pgm->page_erase && (p->prog_modes & (PM_PDI | PM_UPDI)));
+}
+
 /*
  * Write the whole memory region of the specified memory from its buffer of the
  * avrpart pointed to by p to the device.  Write up to size bytes from the
@@ -967,8 +1344,11 @@ int avr_write_mem(const PROGRAMMER *pgm, const AVRPART *p, const AVRMEM *m, int
       }
     }
 
-    while(avr_tpi_poll_nvmbsy(pgm))
-      continue;
+    if(avr_tpi_wait_nvm(pgm, p, NULL, TPI_NVMCMD_NO_OPERATION) < 0) {
+      led_set(pgm, LED_ERR);
+      led_clr(pgm, LED_PGM);
+      return LIBAVRDUDE_GENERAL_FAILURE;
+    }
 
     // Setup for WORD_WRITE
     avr_tpi_setup_rw(pgm, m, 0, TPI_NVMCMD_WORD_WRITE);
@@ -1015,7 +1395,12 @@ int avr_write_mem(const PROGRAMMER *pgm, const AVRPART *p, const AVRMEM *m, int
 
         lastaddr += chunk;
 
-        while(avr_tpi_poll_nvmbsy(pgm));
+        if(avr_tpi_wait_nvm(pgm, p, m, TPI_NVMCMD_WORD_WRITE) < 0) {
+          report_progress(1, -1, NULL);
+          led_set(pgm, LED_ERR);
+          led_clr(pgm, LED_PGM);
+          return LIBAVRDUDE_GENERAL_FAILURE;
+        }
       }
       report_progress(i, wsize, NULL);
     }
@@ -1066,6 +1451,10 @@ int avr_write_mem(const PROGRAMMER *pgm, const AVRPART *p, const AVRMEM *m, int
     // Set cwsize as rounded-up wsize
     int cwsize = (wsize + pgsize - 1)/pgsize*pgsize;
 
+    // For --incremental: 0 = page not yet compared with device, 1 = unchanged, 2 = changed
+    int incremental = cx->avr_incremental && mem_is_in_flash(cm);
+    uint8_t *pstate = incremental? mmt_malloc(cwsize/cm->page_size + 1): NULL;
+
     for(pageaddr = 0; pageaddr < (unsigned int) cwsize; pageaddr += pgsize) {
       for(i = pageaddr, nset = 0; i < pageaddr + pgsize; i++)
         if(cm->tags[i] & TAG_ALLOCATED)
@@ -1086,6 +1475,12 @@ int avr_write_mem(const PROGRAMMER *pgm, const AVRPART *p, const AVRMEM *m, int
           // Read flash contents to separate memory spc and fill in holes
           if(avr_read_page_default(pgm, p, cm, beg, spc) >= 0) {
             pmsg_debug("padding %s [0x%04x, 0x%04x]\n", cm->desc, beg, end - 1);
+            if(pstate)          // Compare with device whilst its contents are at hand
+              for(pstate[beg/cm->page_size] = 1, i = beg; i < end; i++)
+                if((cm->tags[i] & TAG_ALLOCATED) && cm->buf[i] != spc[i - beg]) {
+                  pstate[beg/cm->page_size] = 2;
+                  break;
+                }
             for(i = beg; i < end; i++)
               if(!(cm->tags[i] & TAG_ALLOCATED)) {
                 cm->tags[i] |= TAG_ALLOCATED;
@@ -1098,6 +1493,51 @@ int avr_write_mem(const PROGRAMMER *pgm, const AVRPART *p, const AVRMEM *m, int
       }
     }
 
+    if(incremental) {
+      // Do not write effective pages whose allocated bytes are the same on the device
+      for(pageaddr = 0; pageaddr < (unsigned int) cwsize; pageaddr += pgsize) {
+        int same = 1, any = 0;
+
+        for(int np = 0; same && np < pgsize/cm->page_size; np++) {
+          unsigned int beg = pageaddr + np*cm->page_size;
+          unsigned int end = beg + cm->page_size;
+          uint8_t *state = pstate + beg/cm->page_size;
+
+          for(i = beg, nset = 0; i < end; i++)
+            if(cm->tags[i] & TAG_ALLOCATED)
+              nset++;
+          if(!nset)             // Nothing to write in this page
+            continue;
+          any = 1;
+          if(!*state && nset == cm->page_size) { // Device CRC of a full page saves reading it
+            int match = avr_crc_matches(pgm, p, cm, cm->buf, beg, cm->page_size);
+
+            *state = match < 0? 0: match? 1: 2;
+          }
+          if(!*state) {         // Read page back and compare
+            if(avr_read_page_default(pgm, p, cm, beg, spc) < 0)
+              *state = 2;
+            else
+              for(*state = 1, i = beg; i < end; i++)
+                if((cm->tags[i] & TAG_ALLOCATED) && cm->buf[i] != spc[i - beg]) {
+                  *state = 2;
+                  break;
+                }
+          }
+          same = *state == 1;
+        }
+        if(!any)
+          continue;
+        cx->avr_pages_checked++;
+        if(same) {              // Turn page into a hole, so it is neither erased nor written
+          cx->avr_pages_skipped++;
+          for(i = pageaddr; i < pageaddr + pgsize; i++)
+            cm->tags[i] &= ~TAG_ALLOCATED;
+        }
+      }
+    }
+    mmt_free(pstate);
+
     // Quickly scan number of pages to be written to
     for(pageaddr = 0, npages = 0; pageaddr < (unsigned int) cwsize; pageaddr += cm->page_size) {
       for(i = pageaddr; i < pageaddr + cm->page_size; i++)
@@ -1107,8 +1547,30 @@ int avr_write_mem(const PROGRAMMER *pgm, const AVRPART *p, const AVRMEM *m, int
         }
     }
 
-    for(pageaddr = 0, failure = 0, nwritten = 0;
-      !failure && pageaddr < (unsigned int) cwsize; pageaddr += cm->page_size) {
+    // Never rely on page erase of flash that the programmer cannot page erase
+    int page_erase = auto_erase && pgm->page_erase && !mem_is_eeprom(cm) &&
+      (!mem_is_in_flash(cm) || avr_can_page_erase_flash(pgm, p));
+
+    failure = 0;
+    pageaddr = 0;
+    if(pgm->paged_write_multi && !page_erase) {
+      // No interleaved page erases: hand over pages in batches so they can be pipelined
+      Page_desc *pages = mmt_malloc((cwsize/cm->page_size + 1)*sizeof *pages);
+      int n = 0;
+
+      for(pageaddr = 0; pageaddr < (unsigned int) cwsize; pageaddr += cm->page_size)
+        for(i = pageaddr; i < pageaddr + cm->page_size; i++)
+          if(cm->tags[i] & TAG_ALLOCATED) {
+            pages[n++] = (Page_desc) { pageaddr, cm->page_size };
+            break;
+          }
+      if(avr_paged_multi(pgm, p, cm, 1, pages, n) < 0)
+        failure = 1;            // Fall back to byte-at-a-time write below
+      mmt_free(pages);
+      pageaddr = cwsize;        // Skip the page-by-page loop
+    }
+
+    for(nwritten = 0; !failure && pageaddr < (unsigned int) cwsize; pageaddr += cm->page_size) {
 
       // Check whether this page must be written to
       for(i = pageaddr, need_write = 0; i < pageaddr + cm->page_size; i++)
@@ -1120,12 +1582,15 @@ int avr_write_mem(const PROGRAMMER *pgm, const AVRPART *p, const AVRMEM *m, int
       if(need_write) {
         int rc = 0;
 
-        if(auto_erase && pgm->page_erase && !mem_is_eeprom(cm))
+        if(page_erase)
           rc = pgm->page_erase(pgm, p, cm, pageaddr);
         if(rc >= 0)
           rc = pgm->paged_write(pgm, p, cm, cm->page_size, pageaddr, cm->page_size);
-        if(rc < 0)
+        if(rc < 0) {
           failure = 1;          // Paged write failed, fall back to byte-at-a-time write below
+          avr_count_retry(cm);
+        } else
+          avr_count_io(cm, 1, 1, cm->page_size);
         nwritten++;
         report_progress(nwritten, npages, NULL);
       } else {
@@ -1186,6 +1651,8 @@ int avr_write_mem(const PROGRAMMER *pgm, const AVRPART *p, const AVRMEM *m, int
         led_set(pgm, LED_ERR);
         goto error;
       }
+      if(pgm->write_byte != avr_write_byte_cached)
+        avr_count_io(m, 1, 1, 1);
     }
 
     if(flush_page) {            // Time to flush the page with a page write
@@ -1299,6 +1766,67 @@ int avr_verify(const PROGRAMMER *pgm, const AVRPART *p, const AVRPART *v, const
   return avr_verify_mem(pgm, p, v, a, size);
 }
 
+#define VFY_BLOCK 32            // Bytes compared per step of the fast path
+
+// Return first index in [i, size) where buf1 and buf2 differ or size if there is none
+static int first_difference(const unsigned char *buf1, const unsigned char *buf2, int i, int size) {
+  // Compare VFY_BLOCK bytes at a time as 64-bit words, which compilers readily vectorise
+  for(; i + VFY_BLOCK <= size; i += VFY_BLOCK) {
+    uint64_t w1, w2, diff = 0;
+
+    for(int k = 0; k < VFY_BLOCK; k += 8) {
+      memcpy(&w1, buf1 + i + k, 8);
+      memcpy(&w2, buf2 + i + k, 8);
+      diff |= w1 ^ w2;
+    }
+    if(diff)
+      break;
+  }
+  while(i < size && buf1[i] == buf2[i])
+    i++;
+
+  return i;
+}
+
+// Add address addr of memory mem to the list of mismatch ranges
+static void add_mismatch(const AVRMEM *mem, int addr, int ro) {
+  Mismatch_range *r = cx->avr_nmismatch? cx->avr_mismatch + cx->avr_nmismatch - 1: NULL;
+
+  if(r && r->memdesc == mem->desc && r->ro == ro && r->end + 1 == addr) {
+    r->end = addr;
+    return;
+  }
+  if(cx->avr_nmismatch >= cx->avr_mismatch_cap) {
+    cx->avr_mismatch_cap = cx->avr_mismatch_cap? 2*cx->avr_mismatch_cap: 16;
+    cx->avr_mismatch = mmt_realloc(cx->avr_mismatch, cx->avr_mismatch_cap*sizeof *cx->avr_mismatch);
+  }
+  cx->avr_mismatch[cx->avr_nmismatch++] = (Mismatch_range) {
+    .memdesc = mem->desc, .beg = addr, .end = addr, .ro = ro,
+  };
+}
+
+// Return the mismatch ranges found by avr_verify_mem() since the last avr_clear_mismatches(),
+// which do_op() calls at the start of each operation
+const Mismatch_range *avr_mismatches(int *nranges) {
+  *nranges = cx->avr_nmismatch;
+  return cx->avr_mismatch;
+}
+
+void avr_clear_mismatches(void) {
+  mmt_free(cx->avr_mismatch);
+  cx->avr_mismatch = NULL;
+  cx->avr_nmismatch = cx->avr_mismatch_cap = 0;
+}
+
+/*
+ * Verify the first size bytes of memory a of part p against the
+ * corresponding memory of part v, which is normally the input file. Only
+ * bytes that differ are examined in detail, which the fast path finds
+ * comparing wide blocks. Mismatching addresses are recorded as ranges that
+ * can be retrieved with avr_mismatches().
+ *
+ * Return size on success and -1 on verification errors.
+ */
 int avr_verify_mem(const PROGRAMMER *pgm, const AVRPART *p, const AVRPART *v, const AVRMEM *a, int size) {
   int i;
   unsigned char *buf1, *buf2;
@@ -1326,50 +1854,70 @@ int avr_verify_mem(const PROGRAMMER *pgm, const AVRPART *p, const AVRPART *v, co
 
   int verror = 0, vroerror = 0, maxerrs = verbose >= MSG_DEBUG? size + 1: 10;
   int ro = mem_is_readonly(a);  // Other memories can have known protected zones such as bootloaders
+  int nrange0 = cx->avr_nmismatch;
 
-  for(i = 0; i < size; i++) {
-    if((b->tags[i] & TAG_ALLOCATED) != 0 && buf1[i] != buf2[i]) {
-      uint8_t bitmask = is_isp(p)? get_fuse_bitmask(a): avr_mem_bitmask(p, a, i);
-
-      if(ro || (pgm->readonly && pgm->readonly(pgm, p, a, i))) {
-        if(quell_progress < 2) {
-          if(vroerror < 10) {
-            if(!(verror + vroerror))
-              pmsg_warning("%s verification mismatch%s\n", a->desc,
-                mem_is_in_flash(a)? " in r/o areas, expected for vectors and/or bootloader": "");
-            imsg_warning("  device 0x%02x != input 0x%02x at addr 0x%04x "
-              "(read only location: ignored)\n", buf1[i], buf2[i], i);
-          } else if(vroerror == 10)
-            imsg_warning("  suppressing further mismatches in read-only areas\n");
-        }
-        vroerror++;
-      } else if((buf1[i] & bitmask) != (buf2[i] & bitmask)) {
-        // Mismatch is not just in unused bits
-        if(verror < maxerrs) {
+  // Only drop into the slow path for bytes that differ
+  for(i = first_difference(buf1, buf2, 0, size); i < size; i = first_difference(buf1, buf2, i + 1, size)) {
+    if(!(b->tags[i] & TAG_ALLOCATED))
+      continue;
+
+    uint8_t bitmask = is_isp(p)? get_fuse_bitmask(a): avr_mem_bitmask(p, a, i);
+
+    if(ro || (pgm->readonly && pgm->readonly(pgm, p, a, i))) {
+      // Once an error is found, only collect further mismatches unless verbose
+      if(quell_progress < 2 && (!verror || verbose >= MSG_NOTICE)) {
+        if(vroerror < 10) {
           if(!(verror + vroerror))
-            pmsg_warning("%s verification mismatch\n", a->desc);
+            pmsg_warning("%s verification mismatch%s\n", a->desc,
+              mem_is_in_flash(a)? " in r/o areas, expected for vectors and/or bootloader": "");
+          imsg_warning("  device 0x%02x != input 0x%02x at addr 0x%04x "
+            "(read only location: ignored)\n", buf1[i], buf2[i], i);
+        } else if(vroerror == 10)
+          imsg_warning("  suppressing further mismatches in read-only areas\n");
+      }
+      vroerror++;
+      add_mismatch(a, i, 1);
+    } else if((buf1[i] & bitmask) != (buf2[i] & bitmask)) {
+      // Mismatch is not just in unused bits
+      if(verror < maxerrs) {
+        if(!(verror + vroerror))
+          pmsg_warning("%s verification mismatch\n", a->desc);
+        if(verror == 0 || verbose >= MSG_NOTICE)
           imsg_error("  device 0x%02x != input 0x%02x at addr 0x%04x (error)\n", buf1[i], buf2[i], i);
-        } else if(verror == maxerrs) {
-          imsg_warning("  suppressing further verification errors\n");
-        }
-        verror++;
-        if(verbose < MSG_NOTICE)
-          return -1;
+      } else if(verror == maxerrs) {
+        imsg_warning("  suppressing further verification errors\n");
+      }
+      verror++;
+      add_mismatch(a, i, 0);
+    } else {
+      // Mismatch is only in unused bits
+      if((buf1[i] | bitmask) != 0xff) {
+        // Programmer returned unused bits as 0, must be the part/programmer
+        pmsg_debug("ignoring mismatch in unused bits of %s\n", a->desc);
+        imsg_debug("(device 0x%02x != input 0x%02x); to prevent this warning fix\n", buf1[i], buf2[i]);
+        imsg_debug("the part or programmer definition in the config file\n");
       } else {
-        // Mismatch is only in unused bits
-        if((buf1[i] | bitmask) != 0xff) {
-          // Programmer returned unused bits as 0, must be the part/programmer
-          pmsg_debug("ignoring mismatch in unused bits of %s\n", a->desc);
-          imsg_debug("(device 0x%02x != input 0x%02x); to prevent this warning fix\n", buf1[i], buf2[i]);
-          imsg_debug("the part or programmer definition in the config file\n");
-        } else {
-          // Programmer returned unused bits as 1, must be the user
-          pmsg_debug("ignoring mismatch in unused bits of %s\n", a->desc);
-          imsg_debug("(device 0x%02x != input 0x%02x); to prevent this warning set\n", buf1[i], buf2[i]);
-          imsg_debug("unused bits to 1 when writing (double check with datasheet)\n");
-        }
+        // Programmer returned unused bits as 1, must be the user
+        pmsg_debug("ignoring mismatch in unused bits of %s\n", a->desc);
+        imsg_debug("(device 0x%02x != input 0x%02x); to prevent this warning set\n", buf1[i], buf2[i]);
+        imsg_debug("unused bits to 1 when writing (double check with datasheet)\n");
+      }
+    }
+  }
+
+  if(verror && verbose >= MSG_NOTICE) { // Compact summary of the error ranges
+    int n = 0;
+
+    for(int k = nrange0; k < cx->avr_nmismatch; k++)
+      n += !cx->avr_mismatch[k].ro;
+    imsg_notice("  %d error range%s in %s:", n, str_plural(n), a->desc);
+    for(int k = nrange0, shown = 0; k < cx->avr_nmismatch && shown < 8; k++) {
+      if(!cx->avr_mismatch[k].ro) {
+        msg_notice(" %s", str_ccinterval(cx->avr_mismatch[k].beg, cx->avr_mismatch[k].end));
+        shown++;
       }
     }
+    msg_notice("%s\n", n > 8? " ...": "");
   }
 
   return verror? -1: size;
@@ -1808,3 +2356,110 @@ void trace_buffer(const char *funstr, const unsigned char *buf, size_t buflen) {
   }
   msg_trace("\n");
 }
+
+/*
+ * Session instrumentation (--timing): avr_phase_end() accumulates the time
+ * since start (an avr_timestamp() value) for a phase of the session, and
+ * avr_count_io()/avr_count_retry() count the programmer calls, bytes and
+ * retries per memory; avr_stats_json() prints all of it as one line of JSON.
+ */
+void avr_phase_end(Avr_phase ph, double start) {
+  if(ph >= 0 && ph < AVR_PH_N) {
+    cx->avr_phase_secs[ph] += avr_timestamp() - start;
+    cx->avr_phase_count[ph]++;
+  }
+}
+
+static Avr_mem_stats *avr_mem_stats(const AVRMEM *mem) {
+  if(!mem || !mem->desc)
+    return NULL;
+  for(int i = 0; i < cx->avr_nmstats; i++)
+    if(str_eq(cx->avr_mstats[i].memdesc, mem->desc))
+      return cx->avr_mstats + i;
+  if(cx->avr_nmstats == AVR_NMEM_STATS)
+    return NULL;
+
+  Avr_mem_stats *ms = cx->avr_mstats + cx->avr_nmstats++;
+
+  ms->memdesc = cache_string(mem->desc);
+  return ms;
+}
+
+void avr_count_io(const AVRMEM *mem, int write, unsigned long ntrans, unsigned long nbytes) {
+  Avr_mem_stats *ms = avr_mem_stats(mem);
+
+  if(ms) {
+    *(write? &ms->wtrans: &ms->rtrans) += ntrans;
+    *(write? &ms->wbytes: &ms->rbytes) += nbytes;
+  }
+}
+
+void avr_count_retry(const AVRMEM *mem) {
+  Avr_mem_stats *ms = avr_mem_stats(mem);
+
+  if(ms)
+    ms->retries++;
+}
+
+// Print s as JSON string
+static void json_str(FILE *fp, const char *s) {
+  fputc('"', fp);
+  for(; s && *s; s++)
+    if(*s == '"' || *s == '\\')
+      fprintf(fp, "\\%c", *s);
+    else if((unsigned char) *s < 0x20)
+      fprintf(fp, "\\u%04x", (unsigned char) *s);
+    else
+      fputc(*s, fp);
+  fputc('"', fp);
+}
+
+void avr_stats_json(FILE *fp, const PROGRAMMER *pgm, const AVRPART *p, int exitrc) {
+  const char *phases[AVR_PH_N] = {
+    [AVR_PH_OPEN] = "open", [AVR_PH_INIT] = "initialize", [AVR_PH_SIGNATURE] = "signature",
+    [AVR_PH_ERASE] = "erase", [AVR_PH_WRITE] = "write", [AVR_PH_VERIFY] = "verify",
+    [AVR_PH_READ] = "read", [AVR_PH_FILEIO] = "fileio",
+  };
+  const AVR_Cache *caches[] = { pgm->cp_flash, pgm->cp_eeprom, pgm->cp_bootrow, pgm->cp_usersig };
+  const char *cnames[] = { "flash", "eeprom", "bootrow", "usersig" };
+
+  fprintf(fp, "{\"version\":");
+  json_str(fp, AVRDUDE_FULL_VERSION);
+  fprintf(fp, ",\"programmer\":");
+  json_str(fp, pgmid);
+  fprintf(fp, ",\"part\":");
+  json_str(fp, p? p->desc: partdesc);
+  fprintf(fp, ",\"port\":");
+  json_str(fp, pgm->port);
+  fprintf(fp, ",\"baudrate\":%d,\"exitcode\":%d,\"seconds\":%.6f,\"phases\":{", pgm->baudrate, exitrc, avr_timestamp());
+  double other = avr_timestamp(); // Time outside the phases, eg, terminal and final cache flush
+  int n = 0;
+
+  for(int i = 0; i < AVR_PH_N; i++)
+    if(cx->avr_phase_count[i]) {
+      fprintf(fp, "%s\"%s\":{\"seconds\":%.6f,\"count\":%d}", n++? ",": "", phases[i],
+        cx->avr_phase_secs[i], cx->avr_phase_count[i]);
+      other -= cx->avr_phase_secs[i];
+    }
+  fprintf(fp, "%s\"other\":{\"seconds\":%.6f}", n? ",": "", other > 0? other: 0);
+  fprintf(fp, "},\"memories\":[");
+  for(int i = 0; i < cx->avr_nmstats; i++) {
+    const Avr_mem_stats *ms = cx->avr_mstats + i;
+
+    fprintf(fp, "%s{\"name\":", i? ",": "");
+    json_str(fp, ms->memdesc);
+    fprintf(fp, ",\"read_bytes\":%lu,\"read_calls\":%lu,\"write_bytes\":%lu,\"write_calls\":%lu,\"retries\":%lu}",
+      ms->rbytes, ms->rtrans, ms->wbytes, ms->wtrans, ms->retries);
+  }
+  fprintf(fp, "],\"cache\":{");
+  n = 0;
+  for(size_t i = 0; i < sizeof caches/sizeof *caches; i++) {
+    const AVR_Cache_stats *cs = caches[i]? &caches[i]->stats: NULL;
+
+    if(cs && cs->hits + cs->misses + cs->flushed)
+      fprintf(fp, "%s\"%s\":{\"hits\":%lu,\"misses\":%lu,\"prefetched\":%lu,\"flushed\":%lu,\"combined\":%lu}",
+        n++? ",": "", cnames[i], cs->hits, cs->misses, cs->prefetched, cs->flushed, cs->combined);
+  }
+  fprintf(fp, "}}\n");
+  fflush(fp);
+}
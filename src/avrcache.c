@@ -37,6 +37,12 @@
  * int avr_write_byte_cached(const PROGRAMMER *pgm, const AVRPART *p, const
  *  AVRMEM *mem, unsigned long addr, unsigned char data);
  *
+ * int avr_read_range_cached(const PROGRAMMER *pgm, const AVRPART *p, const
+ *  AVRMEM *mem, unsigned long addr, unsigned char *buf, unsigned long len);
+ *
+ * int avr_write_range_cached(const PROGRAMMER *pgm, const AVRPART *p, const
+ *  AVRMEM *mem, unsigned long addr, const unsigned char *buf, unsigned long len);
+ *
  * int avr_flush_cache(const PROGRAMMER *pgm, const AVRPART *p);
  *
  * int avr_chip_erase_cached(const PROGRAMMER *pgm, const AVRPART *p);
@@ -59,8 +65,18 @@
  * avr_flush_cache() or when attempting to read or write from a location
  * outside the address range of the device memory.
  *
+ * avr_read_range_cached() and avr_write_range_cached() do the same for len
+ * bytes from addr onwards: missing pages of the range are loaded with as few
+ * pgm->paged_load_multi() calls as possible and data are copied to or from
+ * the cache page by page. The range must lie within the device memory.
+ *
  * avr_flush_cache() synchronises pending writes to flash, EEPROM, bootrow
- * and usersig with the device. With some programmer and part combinations,
+ * and usersig with the device. Pages modified by bytewise writes are marked
+ * in a dirty bitmap, so that the flush only visits these pages; runs of
+ * adjacent dirty pages are written with one pgm->paged_write_multi() call
+ * if the programmer provides it. Cached reads that walk through memory page
+ * by page trigger read-ahead of a growing number of pages with
+ * pgm->paged_load_multi(), if available. With some programmer and part combinations,
  * flash (and sometimes EEPROM, too) looks like a NOR memory, ie, a write can
  * only clear bits, never set them. For NOR memories a page erase or, if not
  * available, a chip erase needs to be issued before writing arbitrary data.
@@ -156,17 +172,21 @@ int avr_read_page_default(const PROGRAMMER *pgm, const AVRPART *p, const AVRMEM
   unsigned char *pagecopy = mmt_malloc(pgsize);
 
   memcpy(pagecopy, mem->buf + base, pgsize);
-  if((rc = pgm->paged_load(pgm, p, mem, pgsize, base, pgsize)) >= 0)
+  if((rc = pgm->paged_load(pgm, p, mem, pgsize, base, pgsize)) >= 0) {
     memcpy(buf, mem->buf + base, pgsize);
+    avr_count_io(mem, 0, 1, pgsize);
+  }
   memcpy(mem->buf + base, pagecopy, pgsize);
 
   if(rc < 0 && pgm->read_byte != avr_read_byte_cached) {
+    avr_count_retry(mem);
     rc = LIBAVRDUDE_SUCCESS;
     for(int i = 0; i < pgsize; i++) {
       if(pgm->read_byte(pgm, p, mem, base + i, pagecopy + i) < 0) {
         rc = LIBAVRDUDE_GENERAL_FAILURE;
         break;
       }
+      avr_count_io(mem, 0, 1, 1);
     }
     if(rc == LIBAVRDUDE_SUCCESS)
       memcpy(buf, pagecopy, pgsize);
@@ -202,6 +222,8 @@ int avr_write_page_default(const PROGRAMMER *pgm, const AVRPART *p, const AVRMEM
   rc = pgm->paged_write(pgm, p, mem, pgsize, base, pgsize);
   memcpy(mem->buf + base, pagecopy, pgsize);
   mmt_free(pagecopy);
+  if(rc >= 0)
+    avr_count_io(mem, 1, 1, pgsize);
 
   return rc;
 }
@@ -231,12 +253,69 @@ static int cacheAddress(int addr, const AVR_Cache *cp, const AVRMEM *mem) {
   return cacheaddr;
 }
 
+#define CACHE_RUN_MAX 32        // Max number of adjacent dirty pages written in one go
+#define CACHE_READAHEAD_MAX 16  // Max number of pages loaded by read-ahead
+
+static void setDirty(AVR_Cache *cp, int pgno) {
+  uint64_t bit = 1ULL << (pgno%64);
+
+  if(!(cp->isdirty[pgno/64] & bit)) {
+    cp->isdirty[pgno/64] |= bit;
+    cp->ndirty++;
+  }
+}
+
+static void clearDirty(AVR_Cache *cp, int pgno) {
+  uint64_t bit = 1ULL << (pgno%64);
+
+  if(cp->isdirty[pgno/64] & bit) {
+    cp->isdirty[pgno/64] &= ~bit;
+    cp->ndirty--;
+  }
+}
+
+static void clearAllDirty(AVR_Cache *cp) {
+  memset(cp->isdirty, 0, (cp->size/cp->page_size + 63)/64*sizeof *cp->isdirty);
+  cp->ndirty = 0;
+}
+
+// Mark all cached pages dirty whose contents differ from the device copy
+static void markChangedDirty(AVR_Cache *cp) {
+  for(int pgno = 0, n = 0; n < cp->size; pgno++, n += cp->page_size)
+    if(cp->iscached[pgno] && memcmp(cp->copy + n, cp->cont + n, cp->page_size))
+      setDirty(cp, pgno);
+}
+
+// Return the first dirty page number from pgno onwards or -1 if there is none
+static int nextDirty(const AVR_Cache *cp, int pgno) {
+  int npages = cp->size/cp->page_size;
+
+  if(!cp->ndirty)
+    return -1;
+  while(pgno < npages) {
+    uint64_t word = cp->isdirty[pgno/64] >> (pgno%64);
+
+    if(!word) {                 // Skip 64 clean pages at a time
+      pgno = (pgno/64 + 1)*64;
+      continue;
+    }
+    for(; !(word & 1); word >>= 1)
+      pgno++;
+    return pgno < npages? pgno: -1;
+  }
+
+  return -1;
+}
+
 static int loadCachePage(AVR_Cache *cp, const PROGRAMMER *pgm, const AVRPART *p, const AVRMEM *mem,
   int addr, int cacheaddr, int nlOnErr) {
 
   int pgno = cacheaddr/cp->page_size;
 
-  if(!cp->iscached[pgno]) {
+  if(cp->iscached[pgno]) {
+    cp->stats.hits++;
+  } else {
+    cp->stats.misses++;
     // Read cached section from device
     int cachebase = cacheaddr & ~(cp->page_size - 1);
 
@@ -250,11 +329,90 @@ static int loadCachePage(AVR_Cache *cp, const PROGRAMMER *pgm, const AVRPART *p,
     // Copy last read device page, so we can later check for changes
     memcpy(cp->copy + cachebase, cp->cont + cachebase, cp->page_size);
     cp->iscached[pgno] = 1;
+    clearDirty(cp, pgno);
   }
 
   return LIBAVRDUDE_SUCCESS;
 }
 
+/*
+ * Load npg uncached pages starting at page-aligned memory address base, which
+ * corresponds to cache page pgno, with one pgm->paged_load_multi() call.
+ * Return 0 on success and -1 on failure, in which case the pages are not
+ * marked as cached.
+ */
+static int loadCachePages(AVR_Cache *cp, const PROGRAMMER *pgm, const AVRPART *p, const AVRMEM *mem,
+  int base, int pgno, int npg) {
+
+  int pgsize = cp->page_size, ret = -1;
+  Page_desc *pages = mmt_malloc(npg*sizeof *pages);
+  unsigned char *save = mmt_malloc(npg*pgsize);
+
+  for(int k = 0; k < npg; k++)
+    pages[k] = (Page_desc) { base + k*pgsize, pgsize };
+
+  led_clr(pgm, LED_ERR);
+  led_set(pgm, LED_PGM);
+  // Part memory buffer mem is unaffected by this (though temporarily changed)
+  memcpy(save, mem->buf + base, npg*pgsize);
+  if(pgm->paged_load_multi(pgm, p, mem, pgsize, pages, npg) >= 0) {
+    int cachebase = pgno*pgsize;
+
+    avr_count_io(mem, 0, 1, npg*pgsize);
+
+    memcpy(cp->cont + cachebase, mem->buf + base, npg*pgsize);
+    memcpy(cp->copy + cachebase, mem->buf + base, npg*pgsize);
+    for(int k = 0; k < npg; k++) {
+      cp->iscached[pgno + k] = 1;
+      clearDirty(cp, pgno + k);
+    }
+    ret = 0;
+  }
+  memcpy(mem->buf + base, save, npg*pgsize);
+  led_clr(pgm, LED_PGM);
+
+  mmt_free(save);
+  mmt_free(pages);
+
+  return ret;
+}
+
+/*
+ * Detect reads of consecutive pages and, when such a read misses the cache,
+ * load the missing page and the following ones with one multi-page call. The
+ * read-ahead window doubles with each further consecutive page up to
+ * CACHE_READAHEAD_MAX and collapses on any other access pattern. Failure is
+ * silently ignored as loadCachePage() subsequently reads the page normally.
+ */
+static void readAhead(AVR_Cache *cp, const PROGRAMMER *pgm, const AVRPART *p, const AVRMEM *mem,
+  int addr, int cacheaddr) {
+
+  int pgsize = cp->page_size, pgno = cacheaddr/pgsize;
+
+  if(pgno == cp->lastpg)
+    return;
+  if(pgno == cp->lastpg + 1)
+    cp->window = cp->window? (cp->window < CACHE_READAHEAD_MAX? 2*cp->window: cp->window): 2;
+  else
+    cp->window = 0;
+  cp->lastpg = pgno;
+
+  if(cp->window < 2 || cp->iscached[pgno] || !pgm->paged_load_multi || pgsize < 2)
+    return;
+
+  // Missing pages from pgno onwards that are still within both cache and memory
+  int base = addr & ~(pgsize - 1), npg = 0;
+
+  while(npg < cp->window && (pgno + npg + 1)*pgsize <= cp->size &&
+    base + (npg + 1)*pgsize <= mem->size && !cp->iscached[pgno + npg])
+    npg++;
+  if(npg < 2)
+    return;
+
+  if(loadCachePages(cp, pgm, p, mem, base, pgno, npg) == 0)
+    cp->stats.prefetched += npg;
+}
+
 static int initCache(AVR_Cache *cp, const PROGRAMMER *pgm, const AVRPART *p) {
   AVRMEM *basemem = cp == pgm->cp_flash? avr_locate_flash(p): cp == pgm->cp_eeprom? avr_locate_eeprom(p):
     cp == pgm->cp_bootrow? avr_locate_bootrow(p): avr_locate_usersig(p);
@@ -268,6 +426,10 @@ static int initCache(AVR_Cache *cp, const PROGRAMMER *pgm, const AVRPART *p) {
   cp->cont = mmt_malloc(cp->size);
   cp->copy = mmt_malloc(cp->size);
   cp->iscached = mmt_malloc(cp->size/cp->page_size);
+  cp->isdirty = mmt_malloc((cp->size/cp->page_size + 63)/64*sizeof *cp->isdirty);
+  cp->ndirty = 0;
+  cp->lastpg = -2;              // No sequential access yet
+  cp->window = 0;
 
   if(is_spm(pgm) && mem_is_in_flash(basemem)) {  // Could be vector bootloader
     // Caching the vector page hands over to the progammer that then can patch the reset vector
@@ -285,9 +447,10 @@ static int writeCachePage(AVR_Cache *cp, const PROGRAMMER *pgm, const AVRPART *p
   led_set(pgm, LED_PGM);
   // Write modified page cont to device; if unsuccessful try bytewise access
   if(avr_write_page_default(pgm, p, mem, base, cp->cont + base) < 0) {
+    avr_count_retry(mem);
     if(pgm->read_byte != avr_read_byte_cached && pgm->write_byte != avr_write_byte_cached) {
       for(int i = 0; i < cp->page_size; i++)
-        if(cp->cont[base + i] != cp->copy[base + i])
+        if(cp->cont[base + i] != cp->copy[base + i]) {
           if(pgm->write_byte(pgm, p, mem, base + i, cp->cont[base + i]) < 0 ||
             pgm->read_byte(pgm, p, mem, base + i, cp->copy + base + i) < 0) {
             report_progress(1, -1, NULL);
@@ -296,6 +459,9 @@ static int writeCachePage(AVR_Cache *cp, const PROGRAMMER *pgm, const AVRPART *p
             pmsg_error("%s access error at addr 0x%04x\n", mem->desc, base + i);
             goto error;
           }
+          avr_count_io(mem, 1, 1, 1);
+          avr_count_io(mem, 0, 1, 1);
+        }
 
       goto success;             // Bytewise writes & reads successful
     }
@@ -324,6 +490,44 @@ error:
   return LIBAVRDUDE_GENERAL_FAILURE;
 }
 
+/*
+ * Write run adjacent cache pages starting at page pgno with one multi-page
+ * call and read them back into the device copy; the caller falls back to
+ * writeCachePage() for each page should this fail
+ */
+static int writeCacheRun(AVR_Cache *cp, const PROGRAMMER *pgm, const AVRPART *p,
+  const AVRMEM *mem, int pgno, int run) {
+
+  int rc, pgsize = cp->page_size, base = pgno*pgsize, len = run*pgsize;
+  Page_desc *pages = mmt_malloc(run*sizeof *pages);
+  unsigned char *save = mmt_malloc(len);
+
+  for(int k = 0; k < run; k++)
+    pages[k] = (Page_desc) { base + k*pgsize, pgsize };
+
+  led_clr(pgm, LED_ERR);
+  led_set(pgm, LED_PGM);
+  // Part memory buffer mem is unaffected by this (though temporarily changed)
+  memcpy(save, mem->buf + base, len);
+  memcpy(mem->buf + base, cp->cont + base, len);
+  rc = pgm->paged_write_multi(pgm, p, mem, pgsize, pages, run);
+  memcpy(mem->buf + base, save, len);
+  if(rc >= 0)
+    avr_count_io(mem, 1, 1, len);
+  mmt_free(save);
+  mmt_free(pages);
+
+  for(int k = 0; rc >= 0 && k < run; k++)
+    if(avr_read_page_default(pgm, p, mem, base + k*pgsize, cp->copy + base + k*pgsize) < 0)
+      rc = LIBAVRDUDE_GENERAL_FAILURE;
+
+  if(rc < 0)
+    led_set(pgm, LED_ERR);
+  led_clr(pgm, LED_PGM);
+
+  return rc < 0? LIBAVRDUDE_GENERAL_FAILURE: LIBAVRDUDE_SUCCESS;
+}
+
 // A coarse guess where any bootloader might start (prob underestimates the start)
 static int guessBootStart(const PROGRAMMER *pgm, const AVRPART *p) {
   int bootstart = 0;
@@ -382,13 +586,17 @@ int avr_flush_cache(const PROGRAMMER *pgm, const AVRPART *p) {
     if(!mem || !cp->cont)
       continue;
 
-    for(int pgno = 0, n = 0; n < cp->size; pgno++, n += cp->page_size) {
-      if(cp->iscached[pgno])
-        if(memcmp(cp->copy + n, cp->cont + n, cp->page_size)) {
-          chpages++;
-          if(mems[i].zopaddr == -1 && !avr_is_and(cp->cont + n, cp->copy + n, cp->cont + n, cp->page_size))
-            mems[i].zopaddr = n;
-        }
+    // Only visit pages marked dirty
+    for(int pgno = nextDirty(cp, 0); pgno >= 0; pgno = nextDirty(cp, pgno + 1)) {
+      int n = pgno*cp->page_size;
+
+      if(!memcmp(cp->copy + n, cp->cont + n, cp->page_size)) {
+        clearDirty(cp, pgno);   // Changed back to what it was
+        continue;
+      }
+      chpages++;
+      if(mems[i].zopaddr == -1 && !avr_is_and(cp->cont + n, cp->copy + n, cp->cont + n, cp->page_size))
+        mems[i].zopaddr = n;
     }
   }
 
@@ -421,8 +629,10 @@ int avr_flush_cache(const PROGRAMMER *pgm, const AVRPART *p) {
 
     if(writeCachePage(cp, pgm, p, mem, n, 1) < 0)
       return LIBAVRDUDE_GENERAL_FAILURE;
+    cp->stats.flushed++;
     // Same? OK, can set cleared bit to one, "normal" memory
     if(!memcmp(cp->copy + n, cp->cont + n, cp->page_size)) {
+      clearDirty(cp, n/cp->page_size);
       chpages--;
       continue;
     }
@@ -430,8 +640,10 @@ int avr_flush_cache(const PROGRAMMER *pgm, const AVRPART *p) {
     if(silent_page_erase(pgm, p, mem, n) >= 0) {
       if(writeCachePage(cp, pgm, p, mem, n, 1) < 0)
         return LIBAVRDUDE_GENERAL_FAILURE;
+      cp->stats.flushed++;
       // Worked OK? Can use page erase on this memory
       if(!memcmp(cp->copy + n, cp->cont + n, cp->page_size)) {
+        clearDirty(cp, n/cp->page_size);
         mems[i].pgerase = 1;
         chpages--;
         continue;
@@ -547,6 +759,7 @@ int avr_flush_cache(const PROGRAMMER *pgm, const AVRPART *p) {
           }
         }
       }
+      markChangedDirty(cp);     // Device copy changed wholesale
     }
     report_progress(1, 0, NULL);
   }
@@ -561,9 +774,14 @@ int avr_flush_cache(const PROGRAMMER *pgm, const AVRPART *p) {
     if(!mem)
       continue;
 
-    for(int pgno = 0, n = 0; n < cp->size; pgno++, n += cp->page_size)
-      if(cp->iscached[pgno] && memcmp(cp->copy + n, cp->cont + n, cp->page_size))
+    for(int pgno = nextDirty(cp, 0); pgno >= 0; pgno = nextDirty(cp, pgno + 1)) {
+      int n = pgno*cp->page_size;
+
+      if(memcmp(cp->copy + n, cp->cont + n, cp->page_size))
         nwr++;
+      else
+        clearDirty(cp, pgno);
+    }
   }
 
   report_progress(0, 1, "Writing");
@@ -576,12 +794,28 @@ int avr_flush_cache(const PROGRAMMER *pgm, const AVRPART *p) {
       if(!mem || !cp->cont)
         continue;
 
-      for(int iwr = 0, pgno = 0, n = 0; n < cp->size; pgno++, n += cp->page_size) {
-        if(cp->iscached[pgno] && memcmp(cp->copy + n, cp->cont + n, cp->page_size)) {
-          if(!chiperase && mems[i].pgerase && pgm->page_erase)
-            led_page_erase(pgm, p, mem, n);
-          if(writeCachePage(cp, pgm, p, mem, n, 1) < 0)
-            return LIBAVRDUDE_GENERAL_FAILURE;
+      int pgerase = !chiperase && mems[i].pgerase && pgm->page_erase;
+
+      for(int iwr = 0, pgno = nextDirty(cp, 0); pgno >= 0; pgno = nextDirty(cp, pgno + 1)) {
+        int n = pgno*cp->page_size, run = 1;
+
+        // Combine adjacent dirty pages unless each page needs erasing first
+        if(pgm->paged_write_multi && cp->page_size > 1 && !pgerase) {
+          while(run < CACHE_RUN_MAX && nextDirty(cp, pgno + run) == pgno + run &&
+            memcmp(cp->copy + n + run*cp->page_size, cp->cont + n + run*cp->page_size, cp->page_size))
+            run++;
+          if(run > 1 && writeCacheRun(cp, pgm, p, mem, pgno, run) == LIBAVRDUDE_SUCCESS)
+            cp->stats.combined++;
+          else
+            run = 1;            // Fall back to writing page by page
+        }
+        for(int k = 0; k < run; k++, n += cp->page_size) {
+          if(run == 1) {
+            if(pgerase)
+              led_page_erase(pgm, p, mem, n);
+            if(writeCachePage(cp, pgm, p, mem, n, 1) < 0)
+              return LIBAVRDUDE_GENERAL_FAILURE;
+          }
           if(memcmp(cp->copy + n, cp->cont + n, cp->page_size)) {
             report_progress(1, -1, NULL);
             if(quell_progress)
@@ -589,8 +823,11 @@ int avr_flush_cache(const PROGRAMMER *pgm, const AVRPART *p) {
             pmsg_error("verification mismatch at %s page addr 0x%04x\n", mem->desc, n);
             return LIBAVRDUDE_GENERAL_FAILURE;
           }
+          clearDirty(cp, pgno + k);
+          cp->stats.flushed++;
           report_progress(iwr++, nwr, NULL);
         }
+        pgno += run - 1;
       }
     }
   }
@@ -634,6 +871,8 @@ int avr_read_byte_cached(const PROGRAMMER *pgm, const AVRPART *p, const AVRMEM *
   if(cacheaddr < 0)
     return LIBAVRDUDE_GENERAL_FAILURE;
 
+  readAhead(cp, pgm, p, mem, (int) addr, cacheaddr);
+
   // Ensure cache page is there
   if(loadCachePage(cp, pgm, p, mem, addr, cacheaddr, 0) < 0)
     return LIBAVRDUDE_GENERAL_FAILURE;
@@ -685,10 +924,165 @@ int avr_write_byte_cached(const PROGRAMMER *pgm, const AVRPART *p, const AVRMEM
     return LIBAVRDUDE_SOFTFAIL;
 
   cp->cont[cacheaddr] = data;
+  setDirty(cp, cacheaddr/cp->page_size);
 
   return LIBAVRDUDE_SUCCESS;
 }
 
+/*
+ * Set up the cache for the range [addr, addr + len) of mem and ensure all its
+ * pages are cached: runs of missing pages are loaded in batches of up to
+ * CACHE_RUN_MAX pages, remaining ones page by page. On success return the
+ * cache and set *cacheaddrp to the cache address of addr; otherwise return
+ * NULL. Progress is reported unless cx->avr_range_noprogress is set, which
+ * the terminal does as its commands show their own progress bar.
+ */
+static AVR_Cache *rangeCache(const PROGRAMMER *pgm, const AVRPART *p, const AVRMEM *mem,
+  unsigned long addr, unsigned long len, int *cacheaddrp) {
+
+  AVR_Cache *cp = mem_is_eeprom(mem)? pgm->cp_eeprom: mem_is_in_flash(mem)? pgm->cp_flash:
+    mem_is_bootrow(mem)? pgm->cp_bootrow: pgm->cp_usersig;
+
+  if(!cp->cont)                 // Init cache if needed
+    if(initCache(cp, pgm, p) < 0)
+      return NULL;
+
+  int cacheaddr = cacheAddress((int) addr, cp, mem);
+
+  if(cacheaddr < 0 || cacheAddress((int) (addr + len - 1), cp, mem) < 0)
+    return NULL;
+
+  int pgsize = cp->page_size, first = cacheaddr/pgsize, last = (cacheaddr + len - 1)/pgsize;
+  int base = addr & ~(pgsize - 1);
+
+  for(int pg = first, npg; pg <= last; pg += npg) {
+    npg = 1;
+    if(!cp->iscached[pg] && pgm->paged_load_multi) {
+      while(npg < CACHE_RUN_MAX && pg + npg <= last && !cp->iscached[pg + npg])
+        npg++;
+      if(npg > 1 && loadCachePages(cp, pgm, p, mem, base + (pg - first)*pgsize, pg, npg) == 0)
+        cp->stats.misses += npg;
+      else
+        npg = 1;
+    }
+    if(npg == 1 && loadCachePage(cp, pgm, p, mem, base + (pg - first)*pgsize, pg*pgsize, 1) < 0)
+      return NULL;
+    if(!cx->avr_range_noprogress)
+      report_progress(pg + npg - first, last - first + 1, NULL);
+  }
+  *cacheaddrp = cacheaddr;
+
+  return cp;
+}
+
+/*
+ * Read len bytes from addr onwards via the read/write cache into buf
+ *  - Used if paged routines available and if memory is flash, EEPROM, bootrow or usersig
+ *  - Otherwise fall back to pgm->read_byte() for each byte
+ *  - The range must lie within the memory
+ *  - Cache is automagically created and initialised if needed
+ */
+int avr_read_range_cached(const PROGRAMMER *pgm, const AVRPART *p, const AVRMEM *mem,
+  unsigned long addr, unsigned char *buf, unsigned long len) {
+
+  if(!len)
+    return LIBAVRDUDE_SUCCESS;
+  if(addr >= (unsigned long) mem->size || len > (unsigned long) mem->size - addr) {
+    pmsg_error("%s range [0x%04lx, 0x%04lx] out of range\n", mem->desc, addr, addr + len - 1);
+    return LIBAVRDUDE_GENERAL_FAILURE;
+  }
+
+  if(!avr_has_paged_access(pgm, p, mem)) {
+    for(unsigned long i = 0; i < len; i++) {
+      int rc = fallback_read_byte(pgm, p, mem, addr + i, buf + i);
+
+      if(rc < 0)
+        return rc;
+      if(!cx->avr_range_noprogress)
+        report_progress(i + 1, len, NULL);
+    }
+    return LIBAVRDUDE_SUCCESS;
+  }
+
+  int cacheaddr;
+  AVR_Cache *cp = rangeCache(pgm, p, mem, addr, len, &cacheaddr);
+
+  if(!cp)
+    return LIBAVRDUDE_GENERAL_FAILURE;
+  memcpy(buf, cp->cont + cacheaddr, len);
+
+  return LIBAVRDUDE_SUCCESS;
+}
+
+/*
+ * Write len bytes from buf to addr onwards via the read/write cache
+ *  - Used if paged routines available and if memory is flash, EEPROM, bootrow or usersig
+ *  - Otherwise fall back to pgm->write_byte() for each byte
+ *  - The range must lie within the memory
+ *  - Bytes at spots the programmer indicates as readonly are left unchanged;
+ *    if any differ from buf, LIBAVRDUDE_SOFTFAIL is returned
+ *  - Cache is automagically created and initialised if needed
+ */
+int avr_write_range_cached(const PROGRAMMER *pgm, const AVRPART *p, const AVRMEM *mem,
+  unsigned long addr, const unsigned char *buf, unsigned long len) {
+
+  int ret = LIBAVRDUDE_SUCCESS;
+
+  if(!len)
+    return LIBAVRDUDE_SUCCESS;
+  if(addr >= (unsigned long) mem->size || len > (unsigned long) mem->size - addr) {
+    pmsg_error("%s range [0x%04lx, 0x%04lx] out of range\n", mem->desc, addr, addr + len - 1);
+    return LIBAVRDUDE_GENERAL_FAILURE;
+  }
+
+  if(!avr_has_paged_access(pgm, p, mem)) {
+    for(unsigned long i = 0; i < len; i++) {
+      int rc = fallback_write_byte(pgm, p, mem, addr + i, buf[i]);
+
+      if(rc == LIBAVRDUDE_SOFTFAIL)
+        ret = rc;
+      else if(rc < 0)
+        return rc;
+      if(!cx->avr_range_noprogress)
+        report_progress(i + 1, len, NULL);
+    }
+    return ret;
+  }
+
+  int cacheaddr;
+  AVR_Cache *cp = rangeCache(pgm, p, mem, addr, len, &cacheaddr);
+
+  if(!cp)
+    return LIBAVRDUDE_GENERAL_FAILURE;
+
+  // Copy page-sized chunks, byte by byte only where the programmer has readonly spots
+  for(unsigned long i = 0, n; i < len; i += n) {
+    int ca = cacheaddr + i, pgno = ca/cp->page_size;
+
+    n = cp->page_size - ca%cp->page_size;
+    if(n > len - i)
+      n = len - i;
+    if(!memcmp(cp->cont + ca, buf + i, n))
+      continue;
+    if(!pgm->readonly) {
+      memcpy(cp->cont + ca, buf + i, n);
+      setDirty(cp, pgno);
+      continue;
+    }
+    for(unsigned long k = 0; k < n; k++)
+      if(cp->cont[ca + k] != buf[i + k]) {
+        if(pgm->readonly(pgm, p, mem, addr + i + k)) {
+          ret = LIBAVRDUDE_SOFTFAIL;
+        } else {
+          cp->cont[ca + k] = buf[i + k];
+          setDirty(cp, pgno);
+        }
+      }
+  }
+
+  return ret;
+}
+
 // Erase the chip and set the cache accordingly
 int avr_chip_erase_cached(const PROGRAMMER *pgm, const AVRPART *p) {
   Cache_desc mems[] = {
@@ -721,6 +1115,7 @@ int avr_chip_erase_cached(const PROGRAMMER *pgm, const AVRPART *p) {
         memset(cp->cont, 0xff, cp->size);
         memset(cp->iscached, 1, cp->size/cp->page_size);
       }
+      clearAllDirty(cp);
     } else {                    // Test whether cached EEPROM/bootrow pages were zapped
       bool erased = 0;
 
@@ -739,10 +1134,10 @@ int avr_chip_erase_cached(const PROGRAMMER *pgm, const AVRPART *p) {
         memset(cp->cont, 0xff, cp->size);
         memset(cp->iscached, 1, cp->size/cp->page_size);
       } else {                  // Discard previous writes but leave cache
-        for(int pgno = 0, n = 0; n < cp->size; pgno++, n += cp->page_size)
-          if(cp->iscached[pgno])
-            memcpy(cp->cont + n, cp->copy + n, cp->page_size);
+        for(int pgno = nextDirty(cp, 0); pgno >= 0; pgno = nextDirty(cp, pgno + 1))
+          memcpy(cp->cont + pgno*cp->page_size, cp->copy + pgno*cp->page_size, cp->page_size);
       }
+      clearAllDirty(cp);
     }
   }
 
@@ -803,7 +1198,17 @@ int avr_reset_cache(const PROGRAMMER *pgm, const AVRPART *p_unused) {
       mmt_free(cp->copy);
     if(cp->iscached)
       mmt_free(cp->iscached);
+    if(cp->isdirty)
+      mmt_free(cp->isdirty);
+    if(cp->stats.hits + cp->stats.misses)
+      pmsg_debug("%s cache: %lu hits, %lu misses, %lu prefetched, %lu pages flushed, %lu multi-page writes\n",
+        i == 0? "flash": i == 1? "eeprom": i == 2? "bootrow": "usersig", cp->stats.hits,
+        cp->stats.misses, cp->stats.prefetched, cp->stats.flushed, cp->stats.combined);
+
+    AVR_Cache_stats stats = cp->stats;
+
     memset(cp, 0, sizeof *cp);
+    cp->stats = stats;          // Statistics accumulate over the session
   }
 
   return LIBAVRDUDE_SUCCESS;
@@ -22,6 +22,8 @@
 #include <stdio.h>
 #include <stdlib.h>
 
+#include "libavrdude.h"         // AVRDUDE_TLS
+
 #define SYSTEM_CONF_FILE "avrdude.conf"
 
 #if defined(WIN32)
@@ -29,14 +31,15 @@
 #else
 #define USER_CONF_FILE ".avrduderc"
 #define XDG_USER_CONF_FILE "avrdude/avrdude.rc"
+#define XDG_CONF_CACHE_FILE "avrdude/avrdude.conf.cache"
 #endif
 
 extern char *progname;          // Name of program, for messages
-extern int ovsigck;             // Override signature check (-F)
-extern int verbose;             // Verbosity level (-v, -vv, ...)
-extern int quell_progress;      // Quell progress report -q, reduce effective verbosity level (-qq, -qqq)
-extern const char *partdesc;    // Part -p string
-extern const char *pgmid;       // Programmer -c string
+extern AVRDUDE_TLS int ovsigck;          // Override signature check (-F)
+extern AVRDUDE_TLS int verbose;          // Verbosity level (-v, -vv, ...)
+extern AVRDUDE_TLS int quell_progress;   // Quell progress report -q, reduce effective verbosity level (-qq, -qqq)
+extern AVRDUDE_TLS const char *partdesc; // Part -p string
+extern AVRDUDE_TLS const char *pgmid;    // Programmer -c string
 
 // Magic memory tree: these functions succeed or exit()
 #define mmt_strdup(s) cfg_strdup(__func__, s)
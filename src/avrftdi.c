@@ -824,6 +824,11 @@ static int avrftdi_cmd(const PROGRAMMER *pgm, const unsigned char *cmd, unsigned
   return avrftdi_transmit(pgm, MPSSE_DO_READ | MPSSE_DO_WRITE, cmd, res, 4);
 }
 
+// ISP commands need no framing: clock n 4-byte commands out in one stream
+static int avrftdi_cmd_multi(const PROGRAMMER *pgm, const unsigned char *cmds, unsigned char *res, int n) {
+  return avrftdi_transmit(pgm, MPSSE_DO_READ | MPSSE_DO_WRITE, cmds, res, 4*n);
+}
+
 static int avrftdi_program_enable(const PROGRAMMER *pgm, const AVRPART *p) {
   int i;
   unsigned char buf[4];
@@ -1697,6 +1702,7 @@ void avrftdi_initpgm(PROGRAMMER *pgm) {
   pgm->program_enable = avrftdi_program_enable;
   pgm->chip_erase = avrftdi_chip_erase;
   pgm->cmd = avrftdi_cmd;
+  pgm->cmd_multi = avrftdi_cmd_multi;
   pgm->open = avrftdi_open;
   pgm->close = avrftdi_close;
   pgm->read_byte = avr_read_byte_default;
@@ -1027,6 +1027,9 @@ AVRPART *locate_part(const LISTID parts, const char *partdesc) {
   if(!parts || !partdesc)
     return NULL;
 
+  if(cfg_index_valid(&cx->cfg_partidx, parts))
+    return cfg_index_lookup(&cx->cfg_partidx, partdesc, NULL);
+
   for(LNODEID ln1 = lfirst(parts); ln1 && !found; ln1 = lnext(ln1)) {
     p = ldata(ln1);
     if(part_eq(p, partdesc, str_caseeq))
@@ -1037,6 +1040,9 @@ AVRPART *locate_part(const LISTID parts, const char *partdesc) {
 }
 
 AVRPART *locate_part_by_avr910_devcode(const LISTID parts, int devcode) {
+  if(cfg_index_valid(&cx->cfg_partidx, parts))
+    return cfg_index_number(&cx->cfg_partidx, 0, devcode, 0);
+
   if(parts)
     for(LNODEID ln1 = lfirst(parts); ln1; ln1 = lnext(ln1)) {
       AVRPART *p = ldata(ln1);
@@ -1051,6 +1057,9 @@ AVRPART *locate_part_by_avr910_devcode(const LISTID parts, int devcode) {
 // Return pointer to first part that has signature sig (unless all 0xff or all 0x00); NULL if no match
 AVRPART *locate_part_by_signature_pm(const LISTID parts, unsigned char *sig, int sigsize, int prog_modes) {
   if(parts && sigsize == 3) {
+    if(cfg_index_valid(&cx->cfg_partidx, parts))
+      return cfg_index_number(&cx->cfg_partidx, 1, sig[0]<<16 | sig[1]<<8 | sig[2], prog_modes);
+
     for(LNODEID ln = lfirst(parts); ln; ln = lnext(ln)) {
       AVRPART *p = ldata(ln);
 
@@ -1142,6 +1151,8 @@ static int sort_avrparts_compare(const AVRPART *p1, const AVRPART *p2) {
 // Sort the list avrparts of parts
 void sort_avrparts(LISTID avrparts) {
   lsort(avrparts, (int (*)(void *, void *)) sort_avrparts_compare);
+  if(cfg_index_valid(&cx->cfg_partidx, avrparts))       // First match in list order may have changed
+    cfg_index_parts(avrparts);
 }
 
 void avr_display(FILE *f, const PROGRAMMER *pgm, const AVRPART *p, const char *prefix, int verbose) {
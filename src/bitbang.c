@@ -31,8 +31,7 @@
 #define WIN32_LEAN_AND_MEAN
 #include <windows.h>
 #else
-#include <signal.h>
-#include <sys/time.h>
+#include <time.h>
 #endif
 
 #include "avrdude.h"
@@ -43,16 +42,53 @@
 #include "tpi.h"
 #include "bitbang.h"
 
+#define BB_YIELD_NS 50000       // Sleep rather than spin for delays this much above the sleep slack
+
 #if defined(WIN32)
 #define freq (*(LARGE_INTEGER *)&cx->bb_freq)
+#endif
+
+// Monotonic time in ns; 0 if no suitable clock is available
+static uint64_t bb_now_ns(void) {
+#if defined(WIN32)
+  LARGE_INTEGER count;
+
+  if(!cx->bb_has_perfcount)
+    return 0;
+  QueryPerformanceCounter(&count);
+  return count.QuadPart/freq.QuadPart*1000000000ULL + count.QuadPart%freq.QuadPart*1000000000ULL/freq.QuadPart;
 #else
-static void alarmhandler(int signo) {
-  *(volatile int *) &cx->bb_done = 1;
-  signal(SIGALRM, cx->bb_saved_alarmf);
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);  // Served by the vDSO on Linux: no system call
+  return ts.tv_sec*1000000000ULL + ts.tv_nsec;
+#endif
 }
-#endif                          // WIN32
 
-// Calibrate the microsecond delay loop below
+#if !defined(WIN32)
+// Sleep until the monotonic time end_ns or for ns, whichever the system supports
+static void bb_sleep(uint64_t end_ns, uint64_t ns) {
+  struct timespec ts;
+
+#if defined(TIMER_ABSTIME)
+  ts.tv_sec = end_ns/1000000000ULL;
+  ts.tv_nsec = end_ns%1000000000ULL;
+  while(clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR)
+    continue;
+#else
+  ts.tv_sec = ns/1000000000ULL;
+  ts.tv_nsec = ns%1000000000ULL;
+  nanosleep(&ts, NULL);
+#endif
+}
+#endif
+
+/*
+ * Calibrate the delay engine: measure the cost of reading the clock and how
+ * much the system oversleeps short sleeps. Delays that exceed the oversleep
+ * by BB_YIELD_NS sleep for most of the time and spin for the rest, so
+ * long -i delays no longer keep a core busy.
+ */
 static void bitbang_calibrate_delay(void) {
 
 #if defined(WIN32)
@@ -77,63 +113,92 @@ static void bitbang_calibrate_delay(void) {
     cx->bb_delay_decrement = 100;
   }
 #else                           // !WIN32
-  struct itimerval itv;
-  volatile int i;
-
-  pmsg_notice2("calibrating delay loop ...");
-  i = 0;
-  *(volatile int *) &cx->bb_done = 0;
-  cx->bb_saved_alarmf = signal(SIGALRM, alarmhandler);
-  /*
-   * Set ITIMER_REAL to 100 ms.  All known systems have a timer granularity of
-   * 10 ms or better, so counting the delay cycles accumulating over 100 ms
-   * should give us a rather realistic picture, without annoying the user by a
-   * lengthy startup time (as an alarm(1) would do).  Of course, if heavy
-   * system activity happens just during calibration but stops before the
-   * remaining part of AVRDUDE runs, this will yield wrong values.  There's not
-   * much we can do about this.
-   */
-  itv.it_value.tv_sec = 0;
-  itv.it_value.tv_usec = 100000;
-  itv.it_interval.tv_sec = itv.it_interval.tv_usec = 0;
-  setitimer(ITIMER_REAL, &itv, 0);
-  while(!*(volatile int *) &cx->bb_done)
-    i--;
-  itv.it_value.tv_sec = itv.it_value.tv_usec = 0;
-  setitimer(ITIMER_REAL, &itv, 0);
-  // Calculate back from 100 ms to 1 us
-  cx->bb_delay_decrement = -i/100000;
-  msg_notice2(" calibrated to %d cycles per us\n", cx->bb_delay_decrement);
+  uint64_t t0, t1, slack = 0;
+
+  pmsg_notice2("calibrating delay engine ...");
+  t0 = bb_now_ns();
+  for(int i = 0; i < 1000; i++)
+    (void) bb_now_ns();
+  t1 = bb_now_ns();
+  cx->bb_clock_ns = (t1 - t0)/1000;
+
+  for(int i = 0; i < 5; i++) {  // Largest oversleep of a 50 us sleep
+    t0 = bb_now_ns();
+    bb_sleep(t0 + 50000, 50000);
+    t1 = bb_now_ns();
+    if(t1 - t0 > 50000 && t1 - t0 - 50000 > slack)
+      slack = t1 - t0 - 50000;
+  }
+  cx->bb_slack_ns = slack;
+  msg_notice2(" clock read %lu ns, sleep slack %lu us\n", (unsigned long) cx->bb_clock_ns,
+    (unsigned long) (slack/1000));
 #endif                          // WIN32
 }
 
+// Wait for ns nanoseconds; sleep for the bulk of long delays and spin for short ones
+static void bitbang_delay_ns(uint64_t ns) {
+  uint64_t now = bb_now_ns(), end = now + ns;
+
+  if(!now) {                    // No clock: run normal uncalibrated delay
+    volatile unsigned int del = (ns + 999)/1000*cx->bb_delay_decrement;
+
+    while(del > 0)
+      del--;
+    return;
+  }
+
+#if !defined(WIN32)
+  if(ns > cx->bb_slack_ns + BB_YIELD_NS)
+    bb_sleep(end - cx->bb_slack_ns, ns - cx->bb_slack_ns);
+#endif
+
+  while(bb_now_ns() + cx->bb_clock_ns/2 < end)
+    continue;
+}
+
 /*
  * Delay for approximately the number of microseconds specified. usleep()'s
  * granularity is usually like 1 ms or 10 ms, so it's not really suitable for
  * short delays in bit-bang algorithms.
  */
 void bitbang_delay(unsigned int us) {
+  bitbang_delay_ns(us*1000ULL);
+}
 
-#if defined(WIN32)
-  LARGE_INTEGER countNow, countEnd;
-
-  if(cx->bb_has_perfcount) {
-    QueryPerformanceCounter(&countNow);
-    countEnd.QuadPart = countNow.QuadPart + freq.QuadPart*us/1000000ll;
+/*
+ * Delay after changing a pin: the -i ISP delay if given, otherwise the delay
+ * that bitbang_txrx() found to meet the -B bit clock period
+ */
+void bitbang_pin_delay(const PROGRAMMER *pgm) {
+  if(pgm->ispdelay > 1)
+    bitbang_delay(pgm->ispdelay);
+  else if(cx->bb_pin_delay_ns)
+    bitbang_delay_ns(cx->bb_pin_delay_ns);
+}
 
-    while(countNow.QuadPart < countEnd.QuadPart)
-      QueryPerformanceCounter(&countNow);
-  } else {                      // No performance counters -- run normal uncalibrated delay
-#endif
+// Start timing an SPI transfer for bitbang_adapt_end(); 0 if the delay is not adaptive
+uint64_t bitbang_adapt_start(const PROGRAMMER *pgm) {
+  return pgm->bitclock > 0 && pgm->ispdelay <= 1? bb_now_ns(): 0;
+}
 
-    volatile unsigned int del = us*cx->bb_delay_decrement;
+/*
+ * Adapt the pin delay to the measured speed of the pin operations, eg, in
+ * bitbang_txrx() a bit takes three setpin() and one getpin() calls, three of
+ * which are followed by the pin delay. Given the time elapsed for nbytes
+ * bytes with ndelay pin delays per bit work out how long the pin operations
+ * took and spread the rest of the -B period over the delays. A running
+ * average smoothes out scheduling noise.
+ */
+void bitbang_adapt_end(const PROGRAMMER *pgm, uint64_t start, int nbytes, int ndelay) {
+  if(!start || nbytes <= 0 || ndelay <= 0)
+    return;
 
-    while(del > 0)
-      del--;
+  uint64_t elapsed = bb_now_ns() - start, period = pgm->bitclock*1e9;
+  uint64_t delays = 8ULL*nbytes*ndelay*cx->bb_pin_delay_ns, bitcost;
 
-#if defined(WIN32)
-  }
-#endif
+  bitcost = elapsed > delays? (elapsed - delays)/(8ULL*nbytes): 0;
+  cx->bb_bit_ns = cx->bb_bit_ns? (3*cx->bb_bit_ns + bitcost)/4: bitcost;
+  cx->bb_pin_delay_ns = period > cx->bb_bit_ns? (period - cx->bb_bit_ns)/ndelay: 0;
 }
 
 // Transmit and receive a byte of data to/from the AVR device
@@ -141,6 +206,8 @@ static unsigned char bitbang_txrx(const PROGRAMMER *pgm, unsigned char byte) {
   int i;
   unsigned char r, b, rbyte;
 
+  uint64_t start = bitbang_adapt_start(pgm);
+
   rbyte = 0;
   for(i = 7; i >= 0; i--) {
     /*
@@ -175,6 +242,8 @@ static unsigned char bitbang_txrx(const PROGRAMMER *pgm, unsigned char byte) {
     rbyte |= r << i;
   }
 
+  bitbang_adapt_end(pgm, start, 1, 3);
+
   return rbyte;
 }
 
@@ -373,8 +442,8 @@ int bitbang_chip_erase(const PROGRAMMER *pgm, const AVRPART *p) {
   AVRMEM *mem;
 
   if(is_tpi(p)) {
-
-    while(avr_tpi_poll_nvmbsy(pgm));
+    if(avr_tpi_wait_nvm(pgm, p, NULL, TPI_NVMCMD_NO_OPERATION) < 0)
+      return -1;
 
     // NVMCMD <- CHIP_ERASE
     bitbang_tpi_tx(pgm, TPI_CMD_SOUT | TPI_SIO_ADDR(TPI_IOREG_NVMCMD));
@@ -395,9 +464,7 @@ int bitbang_chip_erase(const PROGRAMMER *pgm, const AVRPART *p) {
     bitbang_tpi_tx(pgm, TPI_CMD_SST);
     bitbang_tpi_tx(pgm, 0xFF);
 
-    while(avr_tpi_poll_nvmbsy(pgm));
-
-    return 0;
+    return avr_tpi_wait_nvm(pgm, p, mem, TPI_NVMCMD_CHIP_ERASE) < 0? -1: 0;
   }
 
   if(p->op[AVR_OP_CHIP_ERASE] == NULL) {
@@ -455,6 +522,14 @@ int bitbang_initialize(const PROGRAMMER *pgm, const AVRPART *p) {
   int i;
 
   bitbang_calibrate_delay();
+  cx->bb_bit_ns = 0;
+  cx->bb_pin_delay_ns = 0;
+  if(pgm->bitclock > 0) {
+    if(pgm->ispdelay > 1)
+      pmsg_warning("-i %d overrides -B for -c %s\n", pgm->ispdelay, pgmid);
+    else                        // Start slow, bitbang_txrx() adapts the delay to the pin speed
+      cx->bb_pin_delay_ns = pgm->bitclock*1e9/3;
+  }
 
   pgm->powerup(pgm);
   usleep(20000);
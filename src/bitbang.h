@@ -29,6 +29,9 @@ extern "C" {
   int bitbang_getpin(int fd, int pin);
   int bitbang_highpulsepin(int fd, int pin);
   void bitbang_delay(unsigned int us);
+  void bitbang_pin_delay(const PROGRAMMER *pgm);
+  uint64_t bitbang_adapt_start(const PROGRAMMER *pgm);
+  void bitbang_adapt_end(const PROGRAMMER *pgm, uint64_t start, int nbytes, int ndelay);
 
   int bitbang_check_prerequisites(const PROGRAMMER *pgm);
 
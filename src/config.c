@@ -27,6 +27,7 @@
 #include <string.h>
 #include <ctype.h>
 #include <wchar.h>
+#include <sys/stat.h>
 
 #include "avrdude.h"
 #include "libavrdude.h"
@@ -161,6 +162,7 @@ Component avr_comp[] = {
 #define DEBUG 0
 
 void cleanup_config(void) {
+  cfg_free_indices();
   ldestroy_cb(part_list, (void (*)(void *)) avr_free_part);
   ldestroy_cb(programmers, (void (*)(void *)) pgm_free);
   ldestroy_cb(string_list, (void (*)(void *)) free_token);
@@ -425,6 +427,8 @@ int read_config(const char *file) {
   FILE *f;
   int r;
 
+  cfg_free_indices();           // Lists change while parsing
+
   if(!(cfg_infile = realpath(file, NULL))) {
     pmsg_ext_error("cannot determine realpath() of config file %s: %s\n", file, strerror(errno));
     return -1;
@@ -455,6 +459,11 @@ int read_config(const char *file) {
     cfg_infile = NULL;
   }
 
+  if(r == 0) {
+    cfg_index_parts(part_list);
+    cfg_index_programmers(programmers);
+  }
+
   return r;
 }
 
@@ -492,6 +501,187 @@ const char *cache_string(const char *p) {
   return cx->cfg_hstrings[h][k] = mmt_strdup(p);
 }
 
+/*
+ * Indices of part_list and programmers
+ *
+ * locate_part(), locate_programmer() and friends are called many times per
+ * run, each time walking the list and comparing every id, desc and variant.
+ * After a config file has been read, the lists are indexed in a
+ * case-insensitive hash table of all names that part_eq() or
+ * locate_programmer_set() would match and in tables of parts sorted by
+ * signature and avr910 devcode. The locate functions use an index only if it
+ * was made for the list they are given and the list has not changed size
+ * since; otherwise they fall back to the linear search. As those functions
+ * return the first match in list order, only the first entry for each name
+ * is kept and the number tables are sorted by list position within a key.
+ */
+
+// FNV-1a hash of a lower-case key
+static unsigned cfg_keyhash(const char *key) {
+  unsigned hash = 2166136261U;
+
+  while(*key)
+    hash = (hash ^ (unsigned char) *key++)*16777619U;
+
+  return hash;
+}
+
+static void cfg_free_index(Cfg_index *ix) {
+  if(ix->tab)
+    for(unsigned i = 0; i <= ix->mask; i++)
+      mmt_free(ix->tab[i].key);
+  mmt_free(ix->tab);
+  mmt_free(ix->sig);
+  mmt_free(ix->dev);
+  memset(ix, 0, sizeof *ix);
+}
+
+// Allocate an empty hash table with room for at least n names
+static void cfg_init_index(Cfg_index *ix, LISTID list, int n) {
+  unsigned size = 64;
+
+  cfg_free_index(ix);
+  while(size < 2U*n)
+    size *= 2;
+  ix->list = list;
+  ix->nlist = lsize(list);
+  ix->mask = size - 1;
+  ix->tab = mmt_malloc(size*sizeof *ix->tab);
+}
+
+// Add name unless already present: the first in list order wins
+static void cfg_index_add(Cfg_index *ix, const char *name, size_t len, void *data) {
+  char *key = mmt_malloc(len + 1);
+
+  memcpy(key, name, len);
+  str_lc(key);
+
+  for(unsigned h = cfg_keyhash(key) & ix->mask; ; h = (h + 1) & ix->mask) {
+    if(!ix->tab[h].key) {
+      ix->tab[h].key = key;
+      ix->tab[h].data = data;
+      ix->tab[h].name = name;
+      return;
+    }
+    if(str_eq(ix->tab[h].key, key))
+      break;
+  }
+  mmt_free(key);
+}
+
+static int cfg_cmp_nument(const void *v1, const void *v2) {
+  const Cfg_nument *n1 = v1, *n2 = v2;
+
+  return n1->key != n2->key? (n1->key < n2->key? -1: 1): n1->pos - n2->pos;
+}
+
+// Index all names that part_eq() matches and the signatures and avr910 devcodes of parts
+void cfg_index_parts(LISTID parts) {
+  Cfg_index *ix = &cx->cfg_partidx;
+  int n = 0, pos = 0;
+
+  for(LNODEID ln = lfirst(parts); ln; ln = lnext(ln))
+    n += 2 + 2*lsize(((AVRPART *) ldata(ln))->variants);
+  cfg_init_index(ix, parts, n);
+  ix->sig = mmt_malloc((lsize(parts) + 1)*sizeof *ix->sig);
+  ix->dev = mmt_malloc((lsize(parts) + 1)*sizeof *ix->dev);
+
+  for(LNODEID ln = lfirst(parts); ln; ln = lnext(ln), pos++) {
+    AVRPART *p = ldata(ln);
+    size_t desclen = strlen(p->desc), variantlen, dashlen;
+
+    cfg_index_add(ix, p->id, strlen(p->id), p);
+    cfg_index_add(ix, p->desc, desclen, p);
+    for(LNODEID lv = lfirst(p->variants); lv; lv = lnext(lv)) {
+      const char *q = (const char *) ldata(lv), *qdash = strchr(q, '-'), *qcolon = strchr(q, ':');
+
+      variantlen = qcolon? (size_t) (qcolon - q): strlen(q);
+      dashlen = qdash? (size_t) (qdash - q): variantlen;
+      if(variantlen < 1024) {   // Same restrictions as in part_eq()
+        cfg_index_add(ix, q, variantlen, p);
+        if(dashlen > desclen && dashlen < variantlen)
+          cfg_index_add(ix, q, dashlen, p);
+      }
+    }
+
+    // Stump entries and unset signatures are never returned by locate_part_by_signature_pm()
+    if(*p->id && *p->id != '.' && !is_memset(p->signature, 0xff, 3) && !is_memset(p->signature, 0, 3))
+      ix->sig[ix->nsig++] = (Cfg_nument) {
+        .key = p->signature[0]<<16 | p->signature[1]<<8 | p->signature[2], .pos = pos, .data = p,
+      };
+    ix->dev[ix->ndev++] = (Cfg_nument) { .key = p->avr910_devcode, .pos = pos, .data = p };
+  }
+  qsort(ix->sig, ix->nsig, sizeof *ix->sig, cfg_cmp_nument);
+  qsort(ix->dev, ix->ndev, sizeof *ix->dev, cfg_cmp_nument);
+}
+
+// Index all ids of programmers
+void cfg_index_programmers(LISTID pgms) {
+  Cfg_index *ix = &cx->cfg_pgmidx;
+  int n = 0;
+
+  for(LNODEID ln = lfirst(pgms); ln; ln = lnext(ln))
+    n += lsize(((PROGRAMMER *) ldata(ln))->id);
+  cfg_init_index(ix, pgms, n);
+
+  for(LNODEID ln = lfirst(pgms); ln; ln = lnext(ln)) {
+    PROGRAMMER *pgm = ldata(ln);
+
+    for(LNODEID li = lfirst(pgm->id); li; li = lnext(li)) {
+      const char *id = ldata(li);
+
+      cfg_index_add(ix, id, strlen(id), pgm);
+    }
+  }
+}
+
+void cfg_free_indices(void) {
+  cfg_free_index(&cx->cfg_partidx);
+  cfg_free_index(&cx->cfg_pgmidx);
+}
+
+// Can index ix be used for lookups in list?
+int cfg_index_valid(const Cfg_index *ix, LISTID list) {
+  return list && ix->tab && ix->list == list && ix->nlist == lsize(list);
+}
+
+// Return first list element matching name (case-insensitive) and set *setid to the matched name
+void *cfg_index_lookup(const Cfg_index *ix, const char *name, const char **setid) {
+  char *key = str_lc(mmt_strdup(name));
+  void *ret = NULL;
+
+  for(unsigned h = cfg_keyhash(key) & ix->mask; ix->tab[h].key; h = (h + 1) & ix->mask)
+    if(str_eq(ix->tab[h].key, key)) {
+      if(setid)
+        *setid = ix->tab[h].name;
+      ret = ix->tab[h].data;
+      break;
+    }
+  mmt_free(key);
+
+  return ret;
+}
+
+// Return first part in list order with given signature (sig = 1) or avr910 devcode (sig = 0)
+void *cfg_index_number(const Cfg_index *ix, int sig, int key, int prog_modes) {
+  const Cfg_nument *tab = sig? ix->sig: ix->dev;
+  int lo = 0, hi = sig? ix->nsig: ix->ndev;
+
+  while(lo < hi) {              // Binary search for the first entry >= key
+    int mid = (lo + hi)/2;
+
+    if(tab[mid].key < key)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+  for(; lo < (sig? ix->nsig: ix->ndev) && tab[lo].key == key; lo++)
+    if(!sig || (((AVRPART *) tab[lo].data)->prog_modes & prog_modes))
+      return tab[lo].data;
+
+  return NULL;
+}
+
 COMMENT *locate_comment(const LISTID comments, const char *where, int rhs) {
   if(comments)
     for(LNODEID ln = lfirst(comments); ln; ln = lnext(ln)) {
@@ -1081,3 +1271,493 @@ void cfg_update_mcuid(AVRPART *part) {
     yywarning("mcuid %d for %s is out of range [0..%d], use a free number >= %d",
       part->mcuid, part->desc, UB_N_MCU - 1, sizeof uP_table/sizeof *uP_table);
 }
+
+/*
+ * Binary cache of the parsed configuration
+ *
+ * Parsing avrdude.conf with flex/bison is the single largest contributor to
+ * start-up time. write_config_cache() dumps the resolved part_list, the
+ * programmers list and the global config settings into a flat binary file
+ * that read_config_cache() can restore without any parsing. The file records
+ * the avrdude version, the sizes of the structures that are copied verbatim,
+ * and the path, size, mtime and a FNV-1a hash of every config file that went
+ * into it; any mismatch invalidates the cache and the caller falls back to
+ * read_config(). The file only contains offsets, no pointers, and strings
+ * are nul-terminated in place, so the whole file is read in one go and
+ * decoded directly from that buffer. Comments are not cached: developer
+ * options that print config entries need to parse the files.
+ */
+
+#define CC_MAGIC "AVRDUDE config cache"
+#define CC_VERSION 1
+
+typedef struct {                // Growing output buffer
+  unsigned char *buf;
+  size_t len, cap;
+} Ccout;
+
+typedef struct {                // Bounds-checked input cursor
+  const unsigned char *p, *end;
+  int err;
+} Ccin;
+
+static void cc_put(Ccout *o, const void *d, size_t n) {
+  if(o->len + n > o->cap) {
+    o->cap = 2*(o->len + n) + 4096;
+    o->buf = mmt_realloc(o->buf, o->cap);
+  }
+  memcpy(o->buf + o->len, d, n);
+  o->len += n;
+}
+
+static void cc_put_int(Ccout *o, int64_t v) {
+  cc_put(o, &v, sizeof v);
+}
+
+// Strings are stored with their length and trailing nul; NULL is length -1
+static void cc_put_str(Ccout *o, const char *s) {
+  size_t n = s? strlen(s): 0;
+
+  cc_put_int(o, s? (int64_t) n: -1);
+  if(s)
+    cc_put(o, s, n + 1);
+}
+
+static void cc_put_opcodes(Ccout *o, OPCODE *const *op) {
+  for(int i = 0; i < AVR_OP_MAX; i++) {
+    cc_put_int(o, !!op[i]);
+    if(op[i])
+      cc_put(o, op[i], sizeof *op[i]);
+  }
+}
+
+static void cc_put_intlist(Ccout *o, LISTID list) {
+  cc_put_int(o, lsize(list));
+  for(LNODEID ln = lfirst(list); ln; ln = lnext(ln))
+    cc_put_int(o, *(int *) ldata(ln));
+}
+
+static void cc_put_strlist(Ccout *o, LISTID list) {
+  cc_put_int(o, lsize(list));
+  for(LNODEID ln = lfirst(list); ln; ln = lnext(ln))
+    cc_put_str(o, ldata(ln));
+}
+
+static int cc_get(Ccin *in, void *d, size_t n) {
+  if(in->err || (size_t) (in->end - in->p) < n) {
+    in->err = 1;
+    memset(d, 0, n);
+    return -1;
+  }
+  memcpy(d, in->p, n);
+  in->p += n;
+  return 0;
+}
+
+static int64_t cc_get_int(Ccin *in) {
+  int64_t v;
+
+  cc_get(in, &v, sizeof v);
+  return v;
+}
+
+// Return pointer to the nul-terminated string in the input buffer (or NULL)
+static const char *cc_get_str(Ccin *in) {
+  int64_t n = cc_get_int(in);
+  const char *s;
+
+  if(in->err || n < 0)
+    return NULL;
+  if(in->end - in->p < n + 1 || in->p[n]) {
+    in->err = 1;
+    return NULL;
+  }
+  s = (const char *) in->p;
+  in->p += n + 1;
+  return s;
+}
+
+static const char *cc_get_cached_str(Ccin *in) {
+  const char *s = cc_get_str(in);
+
+  return s? cache_string(s): cache_string("");
+}
+
+static void cc_get_opcodes(Ccin *in, OPCODE **op) {
+  for(int i = 0; i < AVR_OP_MAX; i++) {
+    op[i] = NULL;
+    if(cc_get_int(in) && !in->err) {
+      op[i] = avr_new_opcode();
+      cc_get(in, op[i], sizeof *op[i]);
+    }
+  }
+}
+
+static void cc_get_intlist(Ccin *in, LISTID list) {
+  for(int64_t n = cc_get_int(in); n > 0 && !in->err; n--) {
+    int *ip = mmt_malloc(sizeof(int));
+
+    *ip = cc_get_int(in);
+    ladd(list, ip);
+  }
+}
+
+static void cc_get_strlist(Ccin *in, LISTID list) {
+  for(int64_t n = cc_get_int(in); n > 0 && !in->err; n--) {
+    const char *s = cc_get_str(in);
+
+    if(s)
+      ladd(list, mmt_strdup(s));
+  }
+}
+
+// Size and modification time of a file
+static int cc_file_stat(const char *file, int64_t *sizep, int64_t *mtimep) {
+  struct stat sb;
+
+  if(stat(file, &sb) < 0)
+    return -1;
+  *sizep = sb.st_size;
+  *mtimep = sb.st_mtime;
+  return 0;
+}
+
+// FNV-1a hash of the contents of a file
+static int cc_file_hash(const char *file, uint64_t *hashp) {
+  unsigned char buf[8192];
+  uint64_t hash = 0xcbf29ce484222325ULL;
+  size_t n;
+  FILE *f;
+
+  if(!(f = fopen(file, "rb")))
+    return -1;
+  while((n = fread(buf, 1, sizeof buf, f)) > 0)
+    for(size_t i = 0; i < n; i++)
+      hash = (hash ^ buf[i])*0x100000001b3ULL;
+  fclose(f);
+
+  *hashp = hash;
+  return 0;
+}
+
+// Header identifying the avrdude build and the config files the cache was made from
+static int cc_put_header(Ccout *o, LISTID cfgfiles) {
+  cc_put_str(o, CC_MAGIC);
+  cc_put_int(o, CC_VERSION);
+  cc_put_str(o, AVRDUDE_FULL_VERSION);
+  cc_put_int(o, sizeof(AVRPART));
+  cc_put_int(o, sizeof(AVRMEM));
+  cc_put_int(o, sizeof(OPCODE));
+  cc_put_int(o, sizeof(struct pindef));
+
+  cc_put_int(o, lsize(cfgfiles));
+  for(LNODEID ln = lfirst(cfgfiles); ln; ln = lnext(ln)) {
+    const char *file = ldata(ln);
+    int64_t size, mtime;
+    uint64_t hash;
+
+    if(cc_file_stat(file, &size, &mtime) < 0 || cc_file_hash(file, &hash) < 0)
+      return -1;
+    cc_put_str(o, file);
+    cc_put_int(o, size);
+    cc_put_int(o, mtime);
+    cc_put_int(o, (int64_t) hash);
+  }
+  return 0;
+}
+
+static int cc_check_header(Ccin *in, LISTID cfgfiles) {
+  const char *s;
+
+  if(!(s = cc_get_str(in)) || !str_eq(s, CC_MAGIC) || cc_get_int(in) != CC_VERSION)
+    return -1;
+  if(!(s = cc_get_str(in)) || !str_eq(s, AVRDUDE_FULL_VERSION))
+    return -1;
+  if(cc_get_int(in) != sizeof(AVRPART) || cc_get_int(in) != sizeof(AVRMEM) ||
+    cc_get_int(in) != sizeof(OPCODE) || cc_get_int(in) != sizeof(struct pindef))
+    return -1;
+
+  if(cc_get_int(in) != lsize(cfgfiles))
+    return -1;
+  for(LNODEID ln = lfirst(cfgfiles); ln; ln = lnext(ln)) {
+    const char *file = ldata(ln);
+    int64_t size, mtime;
+    uint64_t hash;
+
+    if(!(s = cc_get_str(in)) || !str_eq(s, file))
+      return -1;
+    int64_t csize = cc_get_int(in), cmtime = cc_get_int(in);
+    uint64_t chash = (uint64_t) cc_get_int(in);
+
+    // Only hash the file contents if size and mtime agree
+    if(in->err || cc_file_stat(file, &size, &mtime) < 0 || size != csize || mtime != cmtime)
+      return -1;
+    if(cc_file_hash(file, &hash) < 0 || hash != chash)
+      return -1;
+  }
+  return in->err? -1: 0;
+}
+
+static void cc_put_part(Ccout *o, const AVRPART *p) {
+  cc_put(o, p, sizeof *p);      // Scalars are copied verbatim, pointers are fixed up on reading
+  cc_put_str(o, p->desc);
+  cc_put_str(o, p->id);
+  cc_put_str(o, p->parent_id);
+  cc_put_str(o, p->family_id);
+  cc_put_str(o, p->config_file);
+  cc_put_strlist(o, p->variants);
+  cc_put_opcodes(o, p->op);
+
+  cc_put_int(o, lsize(p->mem));
+  for(LNODEID ln = lfirst(p->mem); ln; ln = lnext(ln)) {
+    const AVRMEM *m = ldata(ln);
+
+    cc_put(o, m, sizeof *m);
+    cc_put_str(o, m->desc);
+    cc_put_opcodes(o, m->op);
+  }
+
+  // Aliases refer to memories by their index in p->mem
+  cc_put_int(o, lsize(p->mem_alias));
+  for(LNODEID ln = lfirst(p->mem_alias); ln; ln = lnext(ln)) {
+    const AVRMEM_ALIAS *a = ldata(ln);
+    int idx = 0;
+    LNODEID lm;
+
+    for(lm = lfirst(p->mem); lm && ldata(lm) != a->aliased_mem; lm = lnext(lm))
+      idx++;
+    cc_put_str(o, a->desc);
+    cc_put_int(o, lm? idx: -1);
+  }
+}
+
+static AVRPART *cc_get_part(Ccin *in) {
+  AVRPART *p = avr_new_part();
+  LISTID mem = p->mem, mem_alias = p->mem_alias, variants = p->variants;
+
+  cc_get(in, p, sizeof *p);
+  p->comments = NULL;
+  p->mem = mem;
+  p->mem_alias = mem_alias;
+  p->variants = variants;
+  p->desc = cc_get_cached_str(in);
+  p->id = cc_get_cached_str(in);
+  p->parent_id = cc_get_cached_str(in);
+  p->family_id = cc_get_cached_str(in);
+  p->config_file = cc_get_cached_str(in);
+  cc_get_strlist(in, p->variants);
+  cc_get_opcodes(in, p->op);
+
+  for(int64_t n = cc_get_int(in); n > 0 && !in->err; n--) {
+    AVRMEM *m = avr_new_mem();
+
+    cc_get(in, m, sizeof *m);
+    m->comments = NULL;
+    m->buf = NULL;
+    m->tags = NULL;
+    m->desc = cc_get_cached_str(in);
+    cc_get_opcodes(in, m->op);
+    ladd(p->mem, m);
+  }
+
+  for(int64_t n = cc_get_int(in); n > 0 && !in->err; n--) {
+    AVRMEM_ALIAS *a = avr_new_memalias();
+    int64_t idx;
+
+    a->desc = cc_get_cached_str(in);
+    idx = cc_get_int(in);
+    if(idx >= 0 && !(a->aliased_mem = lget_n(p->mem, idx + 1)))
+      in->err = 1;
+    ladd(p->mem_alias, a);
+  }
+
+  return p;
+}
+
+// Only the PROGRAMMER components that config_gram.y can set are cached
+static void cc_put_pgm(Ccout *o, const PROGRAMMER *pgm) {
+  cc_put_strlist(o, pgm->id);
+  cc_put_str(o, pgm->desc);
+  cc_put_str(o, pgm->initpgm? locate_programmer_type_id(pgm->initpgm): NULL);
+  cc_put_str(o, pgm->parent_id);
+  cc_put_int(o, pgm->prog_modes);
+  cc_put_int(o, pgm->is_serialadapter);
+  cc_put_int(o, pgm->extra_features);
+  cc_put(o, pgm->pin, sizeof pgm->pin);
+  cc_put_int(o, pgm->conntype);
+  cc_put_int(o, pgm->baudrate);
+  cc_put_int(o, pgm->usbvid);
+  cc_put_intlist(o, pgm->usbpid);
+  cc_put_str(o, pgm->usbdev);
+  cc_put_str(o, pgm->usbsn);
+  cc_put_str(o, pgm->usbvendor);
+  cc_put_str(o, pgm->usbproduct);
+  cc_put_intlist(o, pgm->hvupdi_support);
+  cc_put_str(o, pgm->config_file);
+  cc_put_int(o, pgm->lineno);
+}
+
+static PROGRAMMER *cc_get_pgm(Ccin *in) {
+  PROGRAMMER *pgm = pgm_new();
+  const char *type;
+
+  cc_get_strlist(in, pgm->id);
+  pgm->desc = cc_get_cached_str(in);
+  if((type = cc_get_str(in))) {
+    const PROGRAMMER_TYPE *pt = locate_programmer_type(type);
+
+    if(!pt)
+      in->err = 1;
+    else
+      pgm->initpgm = pt->initpgm;
+  }
+  pgm->parent_id = cc_get_cached_str(in);
+  pgm->prog_modes = cc_get_int(in);
+  pgm->is_serialadapter = cc_get_int(in);
+  pgm->extra_features = cc_get_int(in);
+  cc_get(in, pgm->pin, sizeof pgm->pin);
+  pgm->conntype = cc_get_int(in);
+  pgm->baudrate = cc_get_int(in);
+  pgm->usbvid = cc_get_int(in);
+  cc_get_intlist(in, pgm->usbpid);
+  pgm->usbdev = cc_get_cached_str(in);
+  pgm->usbsn = cc_get_cached_str(in);
+  pgm->usbvendor = cc_get_cached_str(in);
+  pgm->usbproduct = cc_get_cached_str(in);
+  cc_get_intlist(in, pgm->hvupdi_support);
+  pgm->config_file = cc_get_cached_str(in);
+  pgm->lineno = cc_get_int(in);
+
+  return pgm;
+}
+
+/*
+ * Write part_list, programmers and the global config settings to the binary
+ * cache file; cfgfiles is the list of config file paths in the order they
+ * were read. The file is written under a temporary name and then renamed so
+ * that concurrent avrdude runs never see a partially written cache.
+ */
+int write_config_cache(const char *cachefile, LISTID cfgfiles) {
+  Ccout o = { NULL, 0, 0 };
+  char *tmp;
+  FILE *f;
+  int ret = -1;
+
+  if(cc_put_header(&o, cfgfiles) < 0)
+    goto done;
+
+  cc_put_str(&o, avrdude_conf_version);
+  cc_put_str(&o, default_programmer);
+  cc_put_str(&o, default_parallel);
+  cc_put_str(&o, default_serial);
+  cc_put_str(&o, default_spi);
+  cc_put_int(&o, default_baudrate);
+  cc_put(&o, &default_bitclock, sizeof default_bitclock);
+  cc_put_str(&o, default_linuxgpio);
+  cc_put_int(&o, allow_subshells);
+
+  cc_put_int(&o, lsize(part_list));
+  for(LNODEID ln = lfirst(part_list); ln; ln = lnext(ln))
+    cc_put_part(&o, ldata(ln));
+  cc_put_int(&o, lsize(programmers));
+  for(LNODEID ln = lfirst(programmers); ln; ln = lnext(ln))
+    cc_put_pgm(&o, ldata(ln));
+
+  tmp = str_sprintf("%s.%llu", cachefile, (unsigned long long) avr_ustimestamp());
+  if(!(f = fopen(tmp, "wb"))) {
+    pmsg_notice2("cannot create config cache %s: %s\n", tmp, strerror(errno));
+    mmt_free(tmp);
+    goto done;
+  }
+  ret = fwrite(o.buf, 1, o.len, f) == o.len? 0: -1;
+  if(fclose(f) || ret < 0 || rename(tmp, cachefile) < 0) {
+    pmsg_notice2("cannot write config cache %s: %s\n", cachefile, strerror(errno));
+    remove(tmp);
+    ret = -1;
+  }
+  mmt_free(tmp);
+
+done:
+  mmt_free(o.buf);
+  return ret;
+}
+
+/*
+ * Populate part_list, programmers and the global config settings from the
+ * cache file provided it was generated by this avrdude version from the
+ * unchanged config files cfgfiles; return 0 on success and -1 otherwise, in
+ * which case nothing has been changed and the caller should use read_config()
+ */
+int read_config_cache(const char *cachefile, LISTID cfgfiles) {
+  unsigned char *buf = NULL;
+  struct stat sb;
+  FILE *f;
+  Ccin in;
+
+  if(stat(cachefile, &sb) < 0 || !(sb.st_mode & S_IFREG) || !(f = fopen(cachefile, "rb")))
+    return -1;
+  buf = mmt_malloc(sb.st_size + 1);
+  if(fread(buf, 1, sb.st_size, f) != (size_t) sb.st_size) {
+    fclose(f);
+    mmt_free(buf);
+    return -1;
+  }
+  fclose(f);
+
+  in.p = buf;
+  in.end = buf + sb.st_size;
+  in.err = 0;
+  if(cc_check_header(&in, cfgfiles) < 0) {
+    pmsg_notice2("config cache %s is stale\n", cachefile);
+    mmt_free(buf);
+    return -1;
+  }
+
+  const char *conf_version = cc_get_cached_str(&in);
+  const char *dprogrammer = cc_get_cached_str(&in);
+  const char *dparallel = cc_get_cached_str(&in);
+  const char *dserial = cc_get_cached_str(&in);
+  const char *dspi = cc_get_cached_str(&in);
+  int dbaudrate = cc_get_int(&in);
+  double dbitclock;
+
+  cc_get(&in, &dbitclock, sizeof dbitclock);
+  const char *dlinuxgpio = cc_get_cached_str(&in);
+  int subshells = cc_get_int(&in);
+
+  LISTID parts = lcreat(NULL, 0), pgms = lcreat(NULL, 0);
+
+  for(int64_t n = cc_get_int(&in); n > 0 && !in.err; n--)
+    ladd(parts, cc_get_part(&in));
+  for(int64_t n = cc_get_int(&in); n > 0 && !in.err; n--)
+    ladd(pgms, cc_get_pgm(&in));
+  mmt_free(buf);
+
+  if(in.err || in.p != in.end) {
+    pmsg_notice2("config cache %s is corrupt\n", cachefile);
+    ldestroy_cb(parts, (void (*)(void *)) avr_free_part);
+    ldestroy_cb(pgms, (void (*)(void *)) pgm_free);
+    return -1;
+  }
+
+  cfg_free_indices();
+  ldestroy_cb(part_list, (void (*)(void *)) avr_free_part);
+  ldestroy_cb(programmers, (void (*)(void *)) pgm_free);
+  part_list = parts;
+  programmers = pgms;
+  cfg_index_parts(part_list);
+  cfg_index_programmers(programmers);
+
+  avrdude_conf_version = conf_version;
+  default_programmer = dprogrammer;
+  default_parallel = dparallel;
+  default_serial = dserial;
+  default_spi = dspi;
+  default_baudrate = dbaudrate;
+  default_bitclock = dbitclock;
+  default_linuxgpio = dlinuxgpio;
+  allow_subshells = subshells;
+
+  pmsg_debug("read config from cache %s\n", cachefile);
+  return 0;
+}
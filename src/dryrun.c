@@ -50,6 +50,33 @@ typedef enum {
   DRY_BOTTOM,                   // Bootloader sits at bottom of flash (UPDI parts)
 } Dry_prog;
 
+// Memory classes with their own busy times in the link model
+typedef enum {
+  DRY_FLASH,
+  DRY_EEPROM,
+  DRY_OTHER,                    // Fuses, lock bits, user rows etc
+  DRY_N_MCLASS,
+} Dry_mclass;
+
+static const char *dry_mclass_name[DRY_N_MCLASS] = {"flash", "eeprom", "other"};
+
+// Model of the link between host and programmer/part
+typedef struct {
+  int latency;                  // Round-trip latency per transaction in us
+  int throughput;               // Link throughput in bytes/s, 0 for infinite
+  int jitter;                   // Max additional random latency per transaction in us
+  int wbusy[DRY_N_MCLASS];      // Busy time of a page (or byte) write in us
+  int ebusy[DRY_N_MCLASS];      // Busy time of a page erase in us
+  int active;                   // Any of the above were set
+  int realtime;                 // Actually wait the modelled time
+  unsigned int rstate;          // State of the jitter pseudo-random number generator
+  uint64_t ready_at;            // With realtime: avr_ustimestamp() when the part is no longer busy
+  // Statistics
+  unsigned long ntrans, nbytes, nwrites, nerases;
+  unsigned long nwaits, npolls; // With realtime: avr_nvm_wait() calls and their polls
+  double us;                    // Modelled time spent on the link
+} Dry_link;
+
 typedef struct {
   AVRPART *dp;
   Dry_prog bl;                  // Bootloader and, if so, at top/bottom of flash?
@@ -61,6 +88,10 @@ typedef struct {
   int datastart, datasize;      // Start and size of application data section (if any)
   int bootstart, bootsize;      // Start and size of boot section (if any)
   int initialised;              // 1 once the part memories are initialised
+  int nobatch;                  // Transfer multi-page requests page by page (for comparison)
+  int inbatch;                  // Set while serving a multi-page request
+  int nochecksum;               // Refuse to checksum memories so verify reads everything back
+  Dry_link link;                // Link model
 } Dryrun_data;
 
 // Use private programmer data as if they were a global structure dry
@@ -72,6 +103,61 @@ typedef struct {
 
 static int dryrun_readonly(const PROGRAMMER *pgm, const AVRPART *p, const AVRMEM *mem, unsigned int addr);
 
+static Dry_mclass dry_mclass(const AVRMEM *m) {
+  return mem_is_in_flash(m)? DRY_FLASH: mem_is_eeprom(m)? DRY_EEPROM: DRY_OTHER;
+}
+
+/*
+ * Account for one exchange with the programmer that carries nbytes over the
+ * link and keeps the part busy for busy us. Within a multi-page request only
+ * the first exchange counts as transaction and incurs latency and jitter.
+ */
+static void dryrun_link(const PROGRAMMER *pgm, unsigned int nbytes, int busy) {
+  Dry_link *lk = &dry.link;
+  double us = busy;
+
+  if(!dry.inbatch) {
+    lk->ntrans++;
+    us += lk->latency;
+    if(lk->jitter > 0) {        // Deterministic LCG so runs are reproducible
+      if(!lk->rstate)
+        lk->rstate = dry.seed? dry.seed: 1;
+      lk->rstate = lk->rstate*1103515245u + 12345u;
+      us += (lk->rstate >> 16)%(lk->jitter + 1u);
+    }
+  }
+  lk->nbytes += nbytes;
+  if(lk->throughput > 0)
+    us += nbytes*1e6/lk->throughput;
+  lk->us += us;
+
+  if(lk->realtime && us - busy >= 1) // Busy time is waited out by dryrun_busy()
+    usleep((unsigned int) (us - busy));
+}
+
+// Key of avr_nvm_wait() for writes or erases of memory class mc; never AVR_NVM_NOCMD
+static int dry_nvm_key(int erase, Dry_mclass mc) {
+  return 1 + 2*mc + !!erase;
+}
+
+static int dryrun_nvm_poll(const PROGRAMMER *pgm, const AVRPART *p) {
+  dry.link.npolls++;
+  return avr_ustimestamp() < dry.link.ready_at;
+}
+
+/*
+ * With -x realtime let the part be busy for busy us and wait for it the way
+ * programmers wait for an NVM controller, ie, via avr_nvm_wait() polling a
+ * ready flag, so the adaptive wait can be observed with a known busy time
+ */
+static void dryrun_busy(const PROGRAMMER *pgm, int key, int busy) {
+  if(!dry.link.realtime || busy <= 0)
+    return;
+  dry.link.nwaits++;
+  dry.link.ready_at = avr_ustimestamp() + busy;
+  (void) avr_nvm_wait(pgm, NULL, dryrun_nvm_poll, key, NULL, AVR_NVM_TIMEOUT_US);
+}
+
 // Read expected signature bytes from part description
 static int dryrun_read_sig_bytes(const PROGRAMMER *pgm, const AVRPART *p, const AVRMEM *sigmem) {
   pmsg_debug("%s()", __func__);
@@ -91,6 +177,9 @@ static int dryrun_chip_erase(const PROGRAMMER *pgm, const AVRPART *punused) {
   pmsg_debug("%s()\n", __func__);
   if(!dry.dp)
     Return("no dryrun device?");
+  dry.link.nerases++;
+  dryrun_link(pgm, 4, dry.link.ebusy[DRY_FLASH]);
+  dryrun_busy(pgm, dry_nvm_key(1, DRY_FLASH), dry.link.ebusy[DRY_FLASH]);
   if(!(mem = avr_locate_flash(dry.dp)))
     Return("cannot locate %s flash memory for chip erase", dry.dp->desc);
   if(mem->size < 1)
@@ -133,7 +222,8 @@ static int dryrun_cmd(const PROGRAMMER *pgm, const unsigned char *cmd, unsigned
     (cmd[0] == (Subc_STK_UNIVERSAL_CE >> 24) && cmd[1] == (uint8_t) (Subc_STK_UNIVERSAL_CE >> 16))) {
 
     ret = dryrun_chip_erase(pgm, NULL);
-  }
+  } else
+    dryrun_link(pgm, 8, 0);
   // Pretend call happened and all is good, returning 0xff each time
   memcpy(res, cmd + 1, 3);
   res[3] = 0xff;
@@ -149,6 +239,9 @@ static int dryrun_page_erase(const PROGRAMMER *pgm, const AVRPART *p, const AVRM
 
   AVRMEM *dmem;
 
+  dry.link.nerases++;
+  dryrun_link(pgm, 4, dry.link.ebusy[dry_mclass(m)]);
+  dryrun_busy(pgm, dry_nvm_key(1, dry_mclass(m)), dry.link.ebusy[dry_mclass(m)]);
   if(!(dmem = avr_locate_mem(dry.dp, m->desc)))
     Return("cannot locate %s %s memory for paged write", dry.dp->desc, m->desc);
 
@@ -738,6 +831,17 @@ static int dryrun_open(PROGRAMMER *pgm, const char *port) {
 
 static void dryrun_close(PROGRAMMER *pgm) {
   pmsg_debug("%s()\n", __func__);
+
+  Dry_link *lk = &dry.link;
+
+  if(lk->active)
+    pmsg_info("link model: %lu transaction%s, %lu byte%s, %lu write%s, %lu erase%s, %.3f s\n",
+      lk->ntrans, str_plural(lk->ntrans), lk->nbytes, str_plural(lk->nbytes),
+      lk->nwrites, str_plural(lk->nwrites), lk->nerases, str_plural(lk->nerases), lk->us/1e6);
+  if(lk->nwaits)
+    pmsg_info("NVM waits: %lu wait%s, %lu poll%s, flash writes now expected to take %lu us\n",
+      lk->nwaits, str_plural(lk->nwaits), lk->npolls, str_plural(lk->npolls),
+      cx->avr_nvm_wait_us[dry_nvm_key(0, DRY_FLASH)]);
 }
 
 // Emulate flash NOR-memory
@@ -753,6 +857,14 @@ static int dryrun_paged_write(const PROGRAMMER *pgm, const AVRPART *p, const AVR
   pmsg_debug("%s(%s, %u, 0x%04x, %u)\n", __func__, m->desc, page_size, addr, n_bytes);
   if(!dry.dp)
     Return("no dryrun device?");
+  if(page_size) {
+    int npg = (n_bytes + page_size - 1)/page_size;
+
+    dry.link.nwrites += npg;
+    dryrun_link(pgm, n_bytes, npg*dry.link.wbusy[dry_mclass(m)]);
+    for(int i = 0; i < npg; i++)
+      dryrun_busy(pgm, dry_nvm_key(0, dry_mclass(m)), dry.link.wbusy[dry_mclass(m)]);
+  }
 
   if(n_bytes) {
     AVRMEM *dmem;
@@ -799,6 +911,7 @@ static int dryrun_paged_load(const PROGRAMMER *pgm, const AVRPART *p, const AVRM
   pmsg_debug("%s(%s, %u, 0x%04x, %u)\n", __func__, m->desc, page_size, addr, n_bytes);
   if(!dry.dp)
     Return("no dryrun device?");
+  dryrun_link(pgm, n_bytes, 0);
 
   if(n_bytes) {
     AVRMEM *dmem;
@@ -832,6 +945,68 @@ static int dryrun_paged_load(const PROGRAMMER *pgm, const AVRPART *p, const AVRM
   return n_bytes;
 }
 
+/*
+ * Multi-page transfers pretend all pages of the batch are in flight at the same
+ * time, so the simulated latency is incurred once per batch rather than per page
+ */
+static int dryrun_paged_multi(const PROGRAMMER *pgm, const AVRPART *p, const AVRMEM *m,
+  unsigned int page_size, const Page_desc *pages, int npages, int write) {
+
+  pmsg_debug("%s(%s, %u, %d pages)\n", __func__, m->desc, page_size, npages);
+  if(!dry.nobatch) {
+    dryrun_link(pgm, 0, 0);
+    dry.inbatch = 1;
+  }
+  for(int k = 0; k < npages; k++) {
+    int rc = write?
+      dryrun_paged_write(pgm, p, m, page_size, pages[k].addr, pages[k].n):
+      dryrun_paged_load(pgm, p, m, page_size, pages[k].addr, pages[k].n);
+
+    if(rc < 0) {
+      dry.inbatch = 0;
+      return rc;
+    }
+  }
+  dry.inbatch = 0;
+
+  return npages;
+}
+
+static int dryrun_paged_write_multi(const PROGRAMMER *pgm, const AVRPART *p, const AVRMEM *m,
+  unsigned int page_size, const Page_desc *pages, int npages) {
+
+  return dryrun_paged_multi(pgm, p, m, page_size, pages, npages, 1);
+}
+
+static int dryrun_paged_load_multi(const PROGRAMMER *pgm, const AVRPART *p, const AVRMEM *m,
+  unsigned int page_size, const Page_desc *pages, int npages) {
+
+  return dryrun_paged_multi(pgm, p, m, page_size, pages, npages, 0);
+}
+
+// Compute the CRC-32 of the device memory so only a few bytes need to cross the link
+static int dryrun_checksum(const PROGRAMMER *pgm, const AVRPART *p, const AVRMEM *m,
+  unsigned int addr, unsigned int n, uint32_t *crcp) {
+
+  AVRMEM *dmem;
+
+  pmsg_debug("%s(%s, 0x%04x, %u)\n", __func__, m->desc, addr, n);
+  if(!dry.dp)
+    Return("no dryrun device?");
+  if(dry.nochecksum || !(mem_is_in_flash(m) || mem_is_eeprom(m) || mem_is_user_type(m)))
+    return LIBAVRDUDE_NOTSUPPORTED;
+  if(!(dmem = avr_locate_mem(dry.dp, m->desc)))
+    Return("cannot locate %s %s memory for checksum", dry.dp->desc, m->desc);
+  if(addr >= (unsigned int) dmem->size || n > dmem->size - addr)
+    Return("cannot checksum [0x%04x, 0x%04x] of %s %s as it is incompatible with memory [0, 0x%04x]",
+      addr, addr + n - 1, dry.dp->desc, dmem->desc, dmem->size - 1);
+  dryrun_link(pgm, 12, 0);      // Address and length out, CRC back
+
+  *crcp = avr_crc32(0, dmem->buf + addr, n);
+
+  return 0;
+}
+
 int dryrun_write_byte(const PROGRAMMER *pgm, const AVRPART *p, const AVRMEM *m,
   unsigned long addr, unsigned char data) {
 
@@ -840,6 +1015,11 @@ int dryrun_write_byte(const PROGRAMMER *pgm, const AVRPART *p, const AVRMEM *m,
   pmsg_debug("%s(%s, 0x%04lx, 0x%02x)\n", __func__, m->desc, addr, data);
   if(!dry.dp)
     Return("no dryrun device?");
+  if(!mem_is_in_flash(m))       // Flash bytes only fill the page buffer
+    dry.link.nwrites++;
+  dryrun_link(pgm, 1, mem_is_in_flash(m)? 0: dry.link.wbusy[dry_mclass(m)]);
+  if(!mem_is_in_flash(m))
+    dryrun_busy(pgm, dry_nvm_key(0, dry_mclass(m)), dry.link.wbusy[dry_mclass(m)]);
   if(!(dmem = avr_locate_mem(dry.dp, m->desc)))
     Return("cannot locate %s %s memory for bytewise write", dry.dp->desc, m->desc);
   if(dmem->size < 1)
@@ -896,6 +1076,7 @@ int dryrun_read_byte(const PROGRAMMER *pgm, const AVRPART *p, const AVRMEM *m,
   pmsg_debug("%s(%s, 0x%04lx)", __func__, m->desc, addr);
   if(!dry.dp)
     Return("no dryrun device?");
+  dryrun_link(pgm, 1, 0);
   if(!(dmem = avr_locate_mem(dry.dp, m->desc)))
     Return("cannot locate %s %s memory for bytewise read", dry.dp->desc, m->desc);
   if(dmem->size < 1)
@@ -1014,6 +1195,48 @@ static int dryrun_parseextparams(const PROGRAMMER *pgm, const LISTID extparms) {
         dry.random = 1;
       continue;
     }
+    int *lkp = NULL;
+
+    if(str_starts(xpara, "latency="))
+      lkp = &dry.link.latency;
+    else if(str_starts(xpara, "throughput="))
+      lkp = &dry.link.throughput;
+    else if(str_starts(xpara, "jitter="))
+      lkp = &dry.link.jitter;
+    else
+      for(int mc = 0; mc < DRY_N_MCLASS; mc++) {
+        const char *rest = str_starts(xpara, dry_mclass_name[mc])? xpara + strlen(dry_mclass_name[mc]): "";
+
+        if(str_starts(rest, "-write="))
+          lkp = dry.link.wbusy + mc;
+        else if(str_starts(rest, "-erase="))
+          lkp = dry.link.ebusy + mc;
+      }
+    if(lkp) {
+      const char *errptr;
+      int val = str_int(strchr(xpara, '=') + 1, STR_INT32, &errptr);
+
+      if(errptr || val < 0) {
+        pmsg_error("cannot parse %s value: %s\n", xpara, errptr? errptr: "negative value");
+        rc = -1;
+        break;
+      }
+      *lkp = val;
+      dry.link.active = 1;
+      continue;
+    }
+    if(str_eq(xpara, "realtime")) {
+      dry.link.realtime = 1;
+      continue;
+    }
+    if(str_eq(xpara, "nobatch")) {
+      dry.nobatch = 1;
+      continue;
+    }
+    if(str_eq(xpara, "nochecksum")) {
+      dry.nochecksum = 1;
+      continue;
+    }
     if(str_eq(xpara, "help")) {
       help = true;
       rc = LIBAVRDUDE_EXIT;
@@ -1024,16 +1247,25 @@ static int dryrun_parseextparams(const PROGRAMMER *pgm, const LISTID extparms) {
       rc = -1;
     }
     msg_error("%s -c %s extended options:\n", progname, pgmid);
-    msg_error("  -x init       Initialise memories with human-readable patterns (1, 2, 3)\n");
-    msg_error("  -x init=<n>   Shortcut for -x init -x seed=<n>\n");
-    msg_error("  -x random     Initialise memories with random code/values (1, 3)\n");
-    msg_error("  -x random=<n> Shortcut for -x random -x seed=<n>\n");
-    msg_error("  -x seed=<n>   Seed random number generator with <n>, n>0, default time(NULL)\n");
-    msg_error("  -x help       Show this help menu and exit\n");
+    msg_error("  -x init              Initialise memories with human-readable patterns (1, 2, 3)\n");
+    msg_error("  -x init=<n>          Shortcut for -x init -x seed=<n>\n");
+    msg_error("  -x random            Initialise memories with random code/values (1, 3)\n");
+    msg_error("  -x random=<n>        Shortcut for -x random -x seed=<n>\n");
+    msg_error("  -x seed=<n>          Seed random number generator with <n>, n>0, default time(NULL)\n");
+    msg_error("  -x latency=<us>      Model a round-trip latency of <us> per transaction (4)\n");
+    msg_error("  -x throughput=<n>    Model a link throughput of <n> bytes/s (4)\n");
+    msg_error("  -x jitter=<us>       Add up to <us> reproducible random latency per transaction\n");
+    msg_error("  -x <m>-write=<us>    Busy time of a page write, <m> is flash, eeprom or other\n");
+    msg_error("  -x <m>-erase=<us>    Busy time of a page erase (flash-erase also for chip erase)\n");
+    msg_error("  -x realtime          Actually wait the modelled time; busy times via NVM polling (4)\n");
+    msg_error("  -x nobatch           Treat each page of a multi-page transfer as its own transaction\n");
+    msg_error("  -x nochecksum        Do not checksum memories on the device; verify reads them back\n");
+    msg_error("  -x help              Show this help menu and exit\n");
     msg_error("Notes:\n");
     msg_error("  (1) -x init and -x random randomly configure flash wrt boot/data/code length\n");
     msg_error("  (2) Patterns can best be seen with fixed-width font on -U flash:r:-:I\n");
     msg_error("  (3) Choose, eg, -x seed=1 for reproducible flash configuration and output\n");
+    msg_error("  (4) Transactions, bytes and modelled time of the link (and NVM waits) are reported at exit\n");
     return rc;
   }
 
@@ -1069,6 +1301,9 @@ void dryrun_initpgm(PROGRAMMER *pgm) {
   // Optional functions
   pgm->paged_write = dryrun_paged_write;
   pgm->paged_load = dryrun_paged_load;
+  pgm->paged_write_multi = dryrun_paged_write_multi;
+  pgm->paged_load_multi = dryrun_paged_load_multi;
+  pgm->checksum = dryrun_checksum;
   pgm->setup = dryrun_setup;
   pgm->teardown = dryrun_teardown;
   pgm->term_keep_alive = dryrun_term_keep_alive;
@@ -377,71 +377,146 @@ static int b2ihex(const AVRPART *p, const AVRMEM *mem, const Segment *segp, Sego
   return hiaddr;
 }
 
+#define LR_BLOCK 65536          // Initial buffer size of the line reader
+#define LR_SLACK 16             // Bytes beyond the buffer that record decoders may peek into
+
+// Reads lines block-wise into one buffer instead of allocating memory per line
+typedef struct {
+  FILE *fp;
+  char *buf;                    // Buffer with LR_SLACK zeroed bytes beyond its size
+  size_t size, beg, end;        // Buffer size, start of next line and end of data read so far
+  int eof;                      // Set once fread() returned no more data
+  const char *err;              // Error message if reading failed
+} Linereader;
+
+static void lr_init(Linereader *lr, FILE *fp) {
+  rewind(fp);
+  *lr = (Linereader) { .fp = fp, .size = LR_BLOCK };
+  lr->buf = mmt_malloc(lr->size + LR_SLACK);
+}
+
+/*
+ * Return the next line without its trailing newline; it is nul-terminated in
+ * place and valid until the next call. Return NULL at end of file or on read
+ * error, in which case lr->err is set.
+ */
+static char *lr_getline(Linereader *lr) {
+  while(1) {
+    char *line = lr->buf + lr->beg, *nl = memchr(line, '\n', lr->end - lr->beg);
+
+    if(nl) {
+      *nl = 0;
+      lr->beg = nl - lr->buf + 1;
+      return line;
+    }
+    if(lr->eof) {               // Last line without newline
+      if(lr->beg >= lr->end)
+        return NULL;
+      lr->buf[lr->end] = 0;
+      lr->beg = lr->end;
+      return line;
+    }
+
+    // Move the partial line to the front and read the next block
+    memmove(lr->buf, line, lr->end - lr->beg);
+    lr->end -= lr->beg;
+    lr->beg = 0;
+    if(lr->end == lr->size) {
+      if(lr->size >= INT_MAX/2) {
+        lr->err = "cannot cope with lines longer than INT_MAX/2 bytes";
+        return NULL;
+      }
+      lr->size *= 2;
+      lr->buf = mmt_realloc(lr->buf, lr->size + LR_SLACK);
+    }
+    size_t got = fread(lr->buf + lr->end, 1, lr->size - lr->end, lr->fp);
+
+    if(got == 0) {
+      if(ferror(lr->fp)) {
+        lr->err = "I/O error";
+        return NULL;
+      }
+      lr->eof = 1;
+    }
+    lr->end += got;
+    memset(lr->buf + lr->end, 0, LR_SLACK);
+  }
+}
+
+// Values of hex digits plus one, so that 0 marks a non-hex character
+static const unsigned char hexval[256] = {
+  ['0'] = 1, ['1'] = 2, ['2'] = 3, ['3'] = 4, ['4'] = 5, ['5'] = 6, ['6'] = 7, ['7'] = 8,
+  ['8'] = 9, ['9'] = 10, ['A'] = 11, ['B'] = 12, ['C'] = 13, ['D'] = 14, ['E'] = 15, ['F'] = 16,
+  ['a'] = 11, ['b'] = 12, ['c'] = 13, ['d'] = 14, ['e'] = 15, ['f'] = 16,
+};
+
+/*
+ * Decode n <= 8 hex digits at s into *valp using the table above; anything
+ * unusual is handed to strtoull() exactly as the parser always did so that
+ * odd input is treated the same. Return 0 on success and -1 otherwise.
+ */
+static int hexdecode(const char *s, int n, unsigned long long *valp) {
+  unsigned long long v = 0;
+
+  for(int i = 0; i < n; i++) {
+    int d = hexval[(unsigned char) s[i]];
+
+    if(!d) {
+      char buf[9], *e;
+
+      memcpy(buf, s, n);
+      buf[n] = 0;
+      *valp = strtoull(buf, &e, 16);
+      return e == buf || *e != 0? -1: 0;
+    }
+    v = v << 4 | (d - 1);
+  }
+  *valp = v;
+
+  return 0;
+}
+
 static int ihex_readrec(struct ihexsrec *ihex, char *rec) {
-  int i, j;
-  char buf[8];
   int offset, len;
-  char *e;
+  unsigned long long v;
   unsigned char cksum;
 
   len = strlen(rec);
   offset = 1;
-  cksum = 0;
 
   // Reclen
-  if(offset + 2 > len)
-    return -1;
-  for(i = 0; i < 2; i++)
-    buf[i] = rec[offset++];
-  buf[i] = 0;
-  ihex->reclen = strtoul(buf, &e, 16);
-  if(e == buf || *e != 0)
+  if(offset + 2 > len || hexdecode(rec + offset, 2, &v) < 0)
     return -1;
+  ihex->reclen = v;
+  offset += 2;
 
   // Load offset
-  if(offset + 4 > len)
-    return -1;
-  for(i = 0; i < 4; i++)
-    buf[i] = rec[offset++];
-  buf[i] = 0;
-  ihex->loadofs = strtoul(buf, &e, 16);
-  if(e == buf || *e != 0)
+  if(offset + 4 > len || hexdecode(rec + offset, 4, &v) < 0)
     return -1;
+  ihex->loadofs = v;
+  offset += 4;
 
   // Record type
-  if(offset + 2 > len)
-    return -1;
-  for(i = 0; i < 2; i++)
-    buf[i] = rec[offset++];
-  buf[i] = 0;
-  ihex->rectyp = strtoul(buf, &e, 16);
-  if(e == buf || *e != 0)
+  if(offset + 2 > len || hexdecode(rec + offset, 2, &v) < 0)
     return -1;
+  ihex->rectyp = v;
+  offset += 2;
 
   cksum = ihex->reclen + ((ihex->loadofs >> 8) & 0x0ff) + (ihex->loadofs & 0x0ff) + ihex->rectyp;
 
   // Data
-  for(j = 0; j < ihex->reclen; j++) {
-    if(offset + 2 > len)
-      return -1;
-    for(i = 0; i < 2; i++)
-      buf[i] = rec[offset++];
-    buf[i] = 0;
-    ihex->data[j] = strtoul(buf, &e, 16);
-    if(e == buf || *e != 0)
+  for(int j = 0; j < ihex->reclen; j++) {
+    if(offset + 2 > len || hexdecode(rec + offset, 2, &v) < 0)
       return -1;
+    ihex->data[j] = v;
+    offset += 2;
     cksum += ihex->data[j];
   }
 
   // Cksum
-  if(offset + 2 > len)
-    return -1;
-  for(i = 0; i < 2; i++)
-    buf[i] = rec[offset++];
-  buf[i] = 0;
-  ihex->cksum = strtoul(buf, &e, 16);
-  if(e == buf || *e != 0)
+  if(offset + 2 > len || hexdecode(rec + offset, 2, &v) < 0)
     return -1;
+  ihex->cksum = v;
 
   pmsg_debug("read ihex record type 0x%02x at 0x%04x with %2d bytes and chksum 0x%02x (0x%02x)\n",
     ihex->rectyp, ihex->loadofs, ihex->reclen, ihex->cksum, -cksum & 0xff);
@@ -486,7 +561,7 @@ static int any2mem(const AVRPART *p, const AVRMEM *mem, const Segment *segp, con
 static int ihex2b(const char *infile, FILE *inf, const AVRPART *p, const AVRMEM *mem,
   const Segment *segp, unsigned int fileoffset, FILEFMT ffmt) {
 
-  const char *errstr;
+  Linereader lr;
   unsigned int nextaddr, baseaddr, maxaddr;
   int lineno, rc;
   struct ihexsrec ihex;
@@ -495,29 +570,25 @@ static int ihex2b(const char *infile, FILE *inf, const AVRPART *p, const AVRMEM
   baseaddr = 0;
   maxaddr = 0;
   nextaddr = 0;
-  rewind(inf);
+  lr_init(&lr, inf);
 
   AVRMEM *any = fileio_any_memory("any");
 
-  for(char *buffer; (buffer = str_fgets(inf, &errstr)); mmt_free(buffer)) {
+  for(char *buffer; (buffer = lr_getline(&lr)); ) {
     lineno++;
     int len = strlen(buffer);
 
-    if(len > 0 && buffer[len - 1] == '\n')
-      buffer[--len] = 0;
     if(len == 0 || buffer[0] != ':')
       continue;
     rc = ihex_readrec(&ihex, buffer);
     if(rc < 0) {
       pmsg_error("invalid record at line %d of %s\n", lineno, infile);
-      mmt_free(buffer);
       goto error;
     }
     if(rc != ihex.cksum) {
       if(ffmt == FMT_IHEX) {
         pmsg_error("checksum mismatch at line %d of %s\n", lineno, infile);
         imsg_error("checksum=0x%02x, computed checksum=0x%02x\n", ihex.cksum, rc);
-        mmt_free(buffer);
         goto error;
       }
       // Just warn with more permissive format FMT_IHXC
@@ -534,7 +605,6 @@ static int ihex2b(const char *infile, FILE *inf, const AVRPART *p, const AVRMEM
           pmsg_error("address 0x%06x below memory offset 0x%x at line %d of %s;\n",
             ihex.loadofs + baseaddr, fileoffset, lineno, infile);
           imsg_error("use -F to skip this check\n");
-          mmt_free(buffer);
           goto error;
         }
         pmsg_warning("address 0x%06x below memory offset 0x%x at line %d of %s: ",
@@ -554,7 +624,6 @@ static int ihex2b(const char *infile, FILE *inf, const AVRPART *p, const AVRMEM
           pmsg_error("Intel Hex record [0x%06x, 0x%06x] out of range [0, 0x%06x]\n",
             nextaddr, nextaddr + ihex.reclen - 1, anysize - 1);
           imsg_error("at line %d of %s; use -F to skip this check\n", lineno, infile);
-          mmt_free(buffer);
           goto error;
         }
         pmsg_warning("Intel Hex record [0x%06x, 0x%06x] out of range [0, 0x%06x]: ",
@@ -575,7 +644,6 @@ static int ihex2b(const char *infile, FILE *inf, const AVRPART *p, const AVRMEM
           pmsg_error("signature of %s incompatible with file's (%s);\n", p->desc,
             str_ccmcunames_signature(any->buf + nextaddr, PM_ALL));
           imsg_error("use -F to override this check\n");
-          mmt_free(buffer);
           goto error;
         }
       if(ihex.reclen && nextaddr + ihex.reclen > maxaddr)
@@ -583,7 +651,6 @@ static int ihex2b(const char *infile, FILE *inf, const AVRPART *p, const AVRMEM
       break;
 
     case 1:                    // End of file record
-      mmt_free(buffer);
       goto done;
 
     case 2:                    // Extended segment address record
@@ -604,13 +671,12 @@ static int ihex2b(const char *infile, FILE *inf, const AVRPART *p, const AVRMEM
 
     default:
       pmsg_error("do not know how to deal with rectype=%d " "at line %d of %s\n", ihex.rectyp, lineno, infile);
-      mmt_free(buffer);
       goto error;
     }
   }
 
-  if(errstr) {
-    pmsg_error("read error in Intel Hex file %s: %s\n", infile, errstr);
+  if(lr.err) {
+    pmsg_error("read error in Intel Hex file %s: %s\n", infile, lr.err);
     goto error;
   }
 
@@ -622,6 +688,7 @@ static int ihex2b(const char *infile, FILE *inf, const AVRPART *p, const AVRMEM
   pmsg_warning("no end of file record found for Intel Hex file %s\n", infile);
 
 done:
+  mmt_free(lr.buf);
   rc = any2mem(p, mem, segp, any, maxaddr);
   avr_free_mem(any);
   if(!rc)
@@ -629,6 +696,7 @@ done:
   return rc;
 
 error:
+  mmt_free(lr.buf);
   avr_free_mem(any);
   return -1;
 }
@@ -724,10 +792,9 @@ static int b2srec(const AVRMEM *mem, const Segment *segp, Segorder where,
 }
 
 static int srec_readrec(struct ihexsrec *srec, char *rec) {
-  int i, j;
-  char buf[8];
+  int i;
   int offset, len, addr_width;
-  char *e;
+  unsigned long long v;
   unsigned char cksum;
   int rc;
 
@@ -746,52 +813,35 @@ static int srec_readrec(struct ihexsrec *srec, char *rec) {
     addr_width = 4;             // S3 or S7-record
 
   // Reclen
-  if(offset + 2 > len)
+  if(offset + 2 > len || hexdecode(rec + offset, 2, &v) < 0)
     return -1;
-  for(i = 0; i < 2; i++)
-    buf[i] = rec[offset++];
-  buf[i] = 0;
-  srec->reclen = strtoul(buf, &e, 16);
+  srec->reclen = v;
+  offset += 2;
   cksum += srec->reclen;
   srec->reclen -= (addr_width + 1);
-  if(e == buf || *e != 0)
-    return -1;
 
   // Load offset
-  if(offset + addr_width > len)
-    return -1;
-  for(i = 0; i < addr_width*2; i++)
-    buf[i] = rec[offset++];
-  buf[i] = 0;
-  srec->loadofs = strtoull(buf, &e, 16);
-  if(e == buf || *e != 0)
+  if(offset + addr_width > len || hexdecode(rec + offset, addr_width*2, &v) < 0)
     return -1;
+  srec->loadofs = v;
+  offset += addr_width*2;
 
   for(i = addr_width; i > 0; i--)
     cksum += (srec->loadofs >> (i - 1)*8) & 0xff;
 
   // Data
-  for(j = 0; j < srec->reclen; j++) {
-    if(offset + 2 > len)
-      return -1;
-    for(i = 0; i < 2; i++)
-      buf[i] = rec[offset++];
-    buf[i] = 0;
-    srec->data[j] = strtoul(buf, &e, 16);
-    if(e == buf || *e != 0)
+  for(int j = 0; j < srec->reclen; j++) {
+    if(offset + 2 > len || hexdecode(rec + offset, 2, &v) < 0)
       return -1;
+    srec->data[j] = v;
+    offset += 2;
     cksum += srec->data[j];
   }
 
   // Cksum
-  if(offset + 2 > len)
-    return -1;
-  for(i = 0; i < 2; i++)
-    buf[i] = rec[offset++];
-  buf[i] = 0;
-  srec->cksum = strtoul(buf, &e, 16);
-  if(e == buf || *e != 0)
+  if(offset + 2 > len || hexdecode(rec + offset, 2, &v) < 0)
     return -1;
+  srec->cksum = v;
 
   rc = 0xff - cksum;
   return rc;
@@ -801,7 +851,7 @@ static int srec_readrec(struct ihexsrec *srec, char *rec) {
 static int srec2b(const char *infile, FILE *inf, const AVRPART *p,
   const AVRMEM *mem, const Segment *segp, unsigned int fileoffset) {
 
-  const char *errstr;
+  Linereader lr;
   unsigned int nextaddr, maxaddr;
   struct ihexsrec srec;
   int lineno, rc, hexdigs;
@@ -811,28 +861,24 @@ static int srec2b(const char *infile, FILE *inf, const AVRPART *p,
   lineno = 0;
   maxaddr = 0;
   reccount = 0;
-  rewind(inf);
+  lr_init(&lr, inf);
 
   AVRMEM *any = fileio_any_memory("any");
 
-  for(char *buffer; (buffer = str_fgets(inf, &errstr)); mmt_free(buffer)) {
+  for(char *buffer; (buffer = lr_getline(&lr)); ) {
     lineno++;
     int len = strlen(buffer);
 
-    if(len > 0 && buffer[len - 1] == '\n')
-      buffer[--len] = 0;
     if(len == 0 || buffer[0] != 'S')
       continue;
     rc = srec_readrec(&srec, buffer);
     if(rc < 0) {
       pmsg_error("invalid record at line %d of %s\n", lineno, infile);
-      mmt_free(buffer);
       goto error;
     }
     if(rc != srec.cksum) {
       pmsg_error("checksum mismatch at line %d of %s\n", lineno, infile);
       imsg_error("checksum=0x%02x, computed checksum=0x%02x\n", srec.cksum, rc);
-      mmt_free(buffer);
       goto error;
     }
 
@@ -858,14 +904,12 @@ static int srec2b(const char *infile, FILE *inf, const AVRPART *p,
 
     case '4':                  // S4: symbol record (LSI extension)
       pmsg_error("not supported record at line %d of %s\n", lineno, infile);
-      mmt_free(buffer);
       goto error;
 
     case '5':                  // S5: count of S1, S2 and S3 records previously tx'd
       if(srec.loadofs != reccount) {
         pmsg_error("count of transmitted data records mismatch at line %d of %s\n", lineno, infile);
         imsg_error("transmitted data records= %d, expected value= %d\n", reccount, srec.loadofs);
-        mmt_free(buffer);
         goto error;
       }
       break;
@@ -873,13 +917,11 @@ static int srec2b(const char *infile, FILE *inf, const AVRPART *p,
     case '7':                  // S7: end record for 32 bit addresses
     case '8':                  // S8: end record for 24 bit addresses
     case '9':                  // S9: end record for 16 bit addresses
-      mmt_free(buffer);
       goto done;
 
     default:
       pmsg_error("do not know how to deal with rectype S%d at line %d of %s\n",
         srec.rectyp, lineno, infile);
-      mmt_free(buffer);
       goto error;
     }
 
@@ -892,7 +934,6 @@ static int srec2b(const char *infile, FILE *inf, const AVRPART *p,
           pmsg_error("address 0x%0*x below memory offset 0x%x at line %d of %s\n",
             hexdigs, nextaddr, fileoffset, lineno, infile);
           imsg_error("use -F to skip this check\n");
-          mmt_free(buffer);
           goto error;
         }
         pmsg_warning("address 0x%0*x below memory offset 0x%x at line %d of %s: ",
@@ -912,7 +953,6 @@ static int srec2b(const char *infile, FILE *inf, const AVRPART *p,
           pmsg_error("Motorola S-Record [0x%06x, 0x%06x] out of range [0, 0x%06x]\n",
             nextaddr, nextaddr + srec.reclen - 1, anysize - 1);
           imsg_error("at line %d of %s; use -F to skip this check\n", lineno, infile);
-          mmt_free(buffer);
           goto error;
         }
         pmsg_warning("Motorola S-Record [0x%06x, 0x%06x] out of range [0, 0x%06x]: ",
@@ -933,7 +973,6 @@ static int srec2b(const char *infile, FILE *inf, const AVRPART *p,
           pmsg_error("signature of %s incompatible with file's (%s);\n", p->desc,
             str_ccmcunames_signature(any->buf + nextaddr, PM_ALL));
           imsg_error("use -F to override this check\n");
-          mmt_free(buffer);
           goto error;
         }
 
@@ -943,13 +982,14 @@ static int srec2b(const char *infile, FILE *inf, const AVRPART *p,
     }
   }
 
-  if(errstr) {
-    pmsg_error("read error in Motorola S-Record file %s: %s\n", infile, errstr);
+  if(lr.err) {
+    pmsg_error("read error in Motorola S-Record file %s: %s\n", infile, lr.err);
     goto error;
   }
 
   pmsg_warning("no end of file record found for Motorola S-Records file %s\n", infile);
 done:
+  mmt_free(lr.buf);
   rc = any2mem(p, mem, segp, any, maxaddr);
   avr_free_mem(any);
   if(!rc)
@@ -957,6 +997,7 @@ done:
   return rc;
 
 error:
+  mmt_free(lr.buf);
   avr_free_mem(any);
   return -1;
 }
@@ -1650,10 +1691,94 @@ int fileio_fmt_autodetect(const char *fname) {
   return format;
 }
 
+/*
+ * Input files decoded once and shared between programming sessions that run
+ * concurrently on different threads. Images are only added by fileio_share()
+ * before the threads start and are read-only thereafter; that is why they
+ * are not part of the thread-local context.
+ */
+typedef struct {
+  int op, format, rc, size;
+  char *filename, *partdesc, *memdesc;
+  unsigned char *buf, *tags;
+} Fileio_image;
+
+static Fileio_image *fio_images;
+static int fio_nimages;
+
+static const Fileio_image *fileio_shared(int op, const char *filename, FILEFMT format,
+  const AVRPART *p, const AVRMEM *mem) {
+
+  for(int i = 0; i < fio_nimages; i++) {
+    const Fileio_image *im = fio_images + i;
+
+    if(im->op == op && im->format == (int) format && im->size == mem->size &&
+      str_eq(im->filename, filename) && str_eq(im->partdesc, p->desc) && str_eq(im->memdesc, mem->desc))
+      return im;
+  }
+
+  return NULL;
+}
+
+/*
+ * Decode a file for reading into mem of part p and keep a copy of the result;
+ * subsequent fileio_mem() calls with the same parameters copy the image
+ * instead of reading and decoding the file again. Not thread-safe: call only
+ * before sessions start that might read the same file.
+ *
+ * Return the same as fileio_mem()
+ */
+int fileio_share(int op, const char *filename, FILEFMT format, const AVRPART *p, const AVRMEM *mem) {
+  const Fileio_image *im = fileio_shared(op, filename, format, p, mem);
+
+  if(im)
+    return im->rc;
+
+  int rc = fileio_mem(op, filename, format, p, mem, -1);
+
+  if(rc < 0)
+    return rc;
+
+  fio_images = mmt_realloc(fio_images, (fio_nimages + 1)*sizeof *fio_images);
+  fio_images[fio_nimages++] = (Fileio_image) {
+    .op = op, .format = format, .rc = rc, .size = mem->size,
+    .filename = mmt_strdup(filename), .partdesc = mmt_strdup(p->desc), .memdesc = mmt_strdup(mem->desc),
+    .buf = mmt_malloc(mem->size), .tags = mmt_malloc(mem->size),
+  };
+  memcpy(fio_images[fio_nimages - 1].buf, mem->buf, mem->size);
+  memcpy(fio_images[fio_nimages - 1].tags, mem->tags, mem->size);
+
+  return rc;
+}
+
+// Forget all shared images; only call once no session uses them any longer
+void fileio_unshare(void) {
+  for(int i = 0; i < fio_nimages; i++) {
+    mmt_free(fio_images[i].filename);
+    mmt_free(fio_images[i].partdesc);
+    mmt_free(fio_images[i].memdesc);
+    mmt_free(fio_images[i].buf);
+    mmt_free(fio_images[i].tags);
+  }
+  mmt_free(fio_images);
+  fio_images = NULL;
+  fio_nimages = 0;
+}
+
 int fileio_mem(int op, const char *filename, FILEFMT format, const AVRPART *p, const AVRMEM *mem, int msize) {
   if(msize < 0 || op == FIO_READ || op == FIO_READ_FOR_VERIFY)
     msize = mem->size;
 
+  if(fio_nimages && (op == FIO_READ || op == FIO_READ_FOR_VERIFY)) {
+    const Fileio_image *im = fileio_shared(op, filename, format, p, mem);
+
+    if(im) {
+      memcpy(mem->buf, im->buf, mem->size);
+      memcpy(mem->tags, im->tags, mem->size);
+      return im->rc;
+    }
+  }
+
   if(str_starts(filename, "urboot:") && (op == FIO_READ || op == FIO_READ_FOR_VERIFY))
     return urbootautogen(p, mem, filename);
 
@@ -1852,11 +1977,13 @@ int fileio_segments(int oprwv, const char *filename, FILEFMT format,
   const AVRPART *p, const AVRMEM *mem, int n, const Segment *list) {
 
   Segment *seglist = mmt_malloc(n*sizeof *seglist);
+  double start = avr_timestamp();
 
   memcpy(seglist, list, n*sizeof *seglist);
   int ret = fileio_segments_normalise(oprwv, filename, format, p, mem, n, seglist);
 
   mmt_free(seglist);
+  avr_phase_end(AVR_PH_FILEIO, start);
 
   return ret;
 }
@@ -685,6 +685,29 @@ static int ft245r_cmd(const PROGRAMMER *pgm, const unsigned char *cmd, unsigned
   return 0;
 }
 
+// Send n 4-byte commands in fragments of up to 8 commands per FTDI buffer
+static int ft245r_cmd_multi(const PROGRAMMER *pgm, const unsigned char *cmds, unsigned char *res, int n) {
+  unsigned char buf[FT245R_FRAGMENT_SIZE + 1];
+
+  for(int i = 0; i < n;) {
+    int k = n - i < FT245R_FRAGMENT_SIZE/FT245R_CMD_SIZE? n - i: FT245R_FRAGMENT_SIZE/FT245R_CMD_SIZE;
+    int buf_pos = 0;
+
+    for(int j = 0; j < 4*k; j++)
+      buf_pos += set_data(pgm, buf + buf_pos, cmds[4*i + j]);
+    buf[buf_pos] = 0;
+    buf_pos++;
+
+    ft245r_send(pgm, buf, buf_pos);
+    ft245r_recv(pgm, buf, buf_pos);
+    for(int j = 0; j < 4*k; j++)
+      res[4*i + j] = extract_data(pgm, buf, j);
+    i += k;
+  }
+
+  return 0;
+}
+
 static inline uint8_t extract_tpi_data(const PROGRAMMER *pgm, unsigned char *buf, int *buf_pos) {
   uint8_t bit = 0x1, byte = 0;
   int j;
@@ -1216,6 +1239,7 @@ void ft245r_initpgm(PROGRAMMER *pgm) {
   pgm->program_enable = ft245r_program_enable;
   pgm->chip_erase = ft245r_chip_erase;
   pgm->cmd = ft245r_cmd;
+  pgm->cmd_multi = ft245r_cmd_multi;
   pgm->cmd_tpi = ft245r_cmd_tpi;
   pgm->open = ft245r_open;
   pgm->close = ft245r_close;
@@ -131,6 +131,8 @@ struct pdata {
   int (*set_sck)(const PROGRAMMER *, unsigned char *);
 
   unsigned char signature_cache[2];     // Used in jtag3_read_byte()
+
+  int edbg_npackets;            // CMSIS-DAP packets the tool can buffer, see jtag3_edbg_prepare()
 };
 
 #define my (*(struct pdata *) (pgm->cookie))
@@ -477,6 +479,69 @@ int jtag3_send(const PROGRAMMER *pgm, unsigned char *data, size_t len) {
   return 0;
 }
 
+// Send fragment frag of nfragments from *datap, advancing *datap and decreasing *lenp
+static int jtag3_edbg_send_fragment(const PROGRAMMER *pgm, unsigned char *buf, int frag, int nfragments,
+  unsigned char **datap, size_t *lenp) {
+
+  int this_len, max_xfer = pgm->fd.usb.max_xfer;
+  unsigned char *data = *datap;
+  size_t len = *lenp;
+
+  // All fragments have the (CMSIS-DAP layer) CMD, the fragment identifier, and the length field
+  buf[0] = EDBG_VENDOR_AVR_CMD;
+  buf[1] = ((frag + 1) << 4) | nfragments;
+
+  if(frag == 0) {
+    // Only first fragment has TOKEN and seq#
+    this_len = (int) len < max_xfer - 8? (int) len: max_xfer - 8;
+    buf[2] = (this_len + 4) >> 8;
+    buf[3] = (this_len + 4) & 0xff;
+    buf[4] = TOKEN;
+    buf[5] = 0;                 // Dummy
+    u16_to_b2(buf + 6, my.command_sequence);
+    if(this_len < 0) {
+      pmsg_error("unexpected this_len = %d\n", this_len);
+      return -1;
+    }
+    memcpy(buf + 8, data, this_len);
+  } else {
+    this_len = (int) len < max_xfer - 4? (int) len: max_xfer - 4;
+    buf[2] = (this_len) >> 8;
+    buf[3] = (this_len) & 0xff;
+    if(this_len < 0) {
+      pmsg_error("unexpected this_len = %d\n", this_len);
+      return -1;
+    }
+    memcpy(buf + 4, data, this_len);
+  }
+
+  if(serial_send(&pgm->fd, buf, max_xfer) != 0) {
+    pmsg_notice("%s(): unable to send command to serial port\n", __func__);
+    return -1;
+  }
+
+  *datap += this_len;
+  *lenp -= this_len;
+
+  return 0;
+}
+
+/*
+ * Collect and discard n responses still outstanding when a streamed exchange
+ * fails, so they are not taken for answers to the next request; if they do
+ * not arrive, stop streaming and exchange fragments one at a time from now on
+ */
+static void jtag3_edbg_drain(const PROGRAMMER *pgm, int n) {
+  unsigned char buf[USBDEV_MAX_XFER_3];
+
+  for(int i = 0; i < n; i++)
+    if(serial_recv(&pgm->fd, buf, pgm->fd.usb.max_xfer) < 0) {
+      pmsg_notice2("%s(): lost %d outstanding response%s\n", __func__, n - i, str_plural(n - i));
+      my.edbg_npackets = 1;
+      return;
+    }
+}
+
 static int jtag3_edbg_send(const PROGRAMMER *pgm, unsigned char *data, size_t len) {
   unsigned char buf[USBDEV_MAX_XFER_3];
   unsigned char status[USBDEV_MAX_XFER_3];
@@ -490,64 +555,39 @@ static int jtag3_edbg_send(const PROGRAMMER *pgm, unsigned char *data, size_t le
   msg_debug("\n");
   pmsg_debug("%s(): sending %lu bytes\n", __func__, (unsigned long) len);
 
-  // 4 bytes overhead for CMD, fragment #, and length info
+  // 4 bytes overhead for CMD, fragment #, and length info; the first fragment also carries TOKEN and seq#
   int max_xfer = pgm->fd.usb.max_xfer;
 
-  int nfragments = (len + max_xfer - 1)/max_xfer;
+  int nfragments = (int) len <= max_xfer - 8? 1: 1 + ((int) len - (max_xfer - 8) + max_xfer - 5)/(max_xfer - 4);
 
   if(nfragments > 1) {
     pmsg_debug("%s(): fragmenting into %d packets\n", __func__, nfragments);
   }
-  int frag;
+
+  // Stream as many fragments as the tool can buffer before collecting their statuses
+  int window = my.edbg_npackets > 1? my.edbg_npackets: 1;
+  int frag, sent = 0;
 
   for(frag = 0; frag < nfragments; frag++) {
-    int this_len;
-
-    // All fragments have the (CMSIS-DAP layer) CMD, the fragment identifier, and the length field
-    buf[0] = EDBG_VENDOR_AVR_CMD;
-    buf[1] = ((frag + 1) << 4) | nfragments;
-
-    if(frag == 0) {
-      // Only first fragment has TOKEN and seq#
-      this_len = (int) len < max_xfer - 8? (int) len: max_xfer - 8;
-      buf[2] = (this_len + 4) >> 8;
-      buf[3] = (this_len + 4) & 0xff;
-      buf[4] = TOKEN;
-      buf[5] = 0;               // Dummy
-      u16_to_b2(buf + 6, my.command_sequence);
-      if(this_len < 0) {
-        pmsg_error("unexpected this_len = %d\n", this_len);
-        return -1;
-      }
-      memcpy(buf + 8, data, this_len);
-    } else {
-      this_len = (int) len < max_xfer - 4? (int) len: max_xfer - 4;
-      buf[2] = (this_len) >> 8;
-      buf[3] = (this_len) & 0xff;
-      if(this_len < 0) {
-        pmsg_error("unexpected this_len = %d\n", this_len);
+    for(; sent < nfragments && sent - frag < window; sent++) {
+      if(jtag3_edbg_send_fragment(pgm, buf, sent, nfragments, &data, &len) < 0) {
+        jtag3_edbg_drain(pgm, sent - frag);
         return -1;
       }
-      memcpy(buf + 4, data, this_len);
     }
 
-    if(serial_send(&pgm->fd, buf, max_xfer) != 0) {
-      pmsg_notice("%s(): unable to send command to serial port\n", __func__);
-      return -1;
-    }
     rv = serial_recv(&pgm->fd, status, max_xfer);
-
     if(rv < 0) {
       // Timeout in receive
       pmsg_notice2("%s(): timeout receiving packet\n", __func__);
+      if(sent - frag > 1)       // Later statuses may still arrive: no more streaming
+        my.edbg_npackets = 1;
       return -1;
     }
     if(status[0] != EDBG_VENDOR_AVR_CMD || (frag == nfragments - 1 && status[1] != 0x01)) {
       // What to do in this case?
       pmsg_notice("%s(): unexpected response 0x%02x, 0x%02x\n", __func__, status[0], status[1]);
     }
-    data += this_len;
-    len -= this_len;
   }
 
   return 0;
@@ -595,6 +635,22 @@ static int jtag3_edbg_prepare(const PROGRAMMER *pgm) {
   if(status[0] != CMSISDAP_CMD_LED || status[1] != 0)
     pmsg_error("unexpected response 0x%02x, 0x%02x\n", status[0], status[1]);
 
+  // Ask how many packets the tool can buffer so fragments can be streamed, see jtag3_edbg_send()
+  my.edbg_npackets = 1;
+  buf[0] = CMSISDAP_CMD_INFO;
+  buf[1] = CMSISDAP_INFO_PACKET_COUNT;
+  if(serial_send(&pgm->fd, buf, pgm->fd.usb.max_xfer) != 0) {
+    pmsg_error("unable to send command to serial port\n");
+    return -1;
+  }
+  rv = serial_recv(&pgm->fd, status, pgm->fd.usb.max_xfer);
+  if(rv != pgm->fd.usb.max_xfer) // Not fatal: exchange fragments one at a time
+    pmsg_notice("%s(): no packet count from tool (%d)\n", __func__, rv);
+  else if(status[0] == CMSISDAP_CMD_INFO && status[1] == 1 && status[2] > 0)
+    my.edbg_npackets = status[2] < 15? status[2]: 15; // At most 15 fragments per message
+  pmsg_notice2("%s(): tool buffers %d packet%s of %d bytes\n", __func__,
+    my.edbg_npackets, str_plural(my.edbg_npackets), pgm->fd.usb.max_xfer);
+
   return 0;
 }
 
@@ -683,22 +739,32 @@ static int jtag3_edbg_recv_frame(const PROGRAMMER *pgm, unsigned char **msg) {
 
   pmsg_trace("jtag3_edbg_recv():\n");
 
-  buf = mmt_malloc(USBDEV_MAX_XFER_3);
+  // Each fragment is received in full at the current end of the message
+  buf = mmt_malloc(USBDEV_MAX_XFER_3 + pgm->fd.usb.max_xfer);
   request = mmt_malloc(pgm->fd.usb.max_xfer);
 
   *msg = buf;
 
   int nfrags = 0;
   int thisfrag = 0;
+  int nreq = 0, nrecv = 0, window = my.edbg_npackets > 1? my.edbg_npackets: 1;
 
+  request[0] = EDBG_VENDOR_AVR_RSP;
   do {
-    request[0] = EDBG_VENDOR_AVR_RSP;
+    /*
+     * The first response tells the number of fragments; from then on keep
+     * up to window requests for the remaining fragments outstanding
+     */
+    int got = thisfrag? thisfrag - 1: 0;
 
-    if(serial_send(&pgm->fd, request, pgm->fd.usb.max_xfer) != 0) {
-      pmsg_notice("%s(): unable to send CMSIS-DAP vendor command\n", __func__);
-      mmt_free(request);
-      mmt_free(*msg);
-      return -1;
+    for(; nreq < (got? nfrags: 1) && nreq - got < window; nreq++) {
+      if(serial_send(&pgm->fd, request, pgm->fd.usb.max_xfer) != 0) {
+        pmsg_notice("%s(): unable to send CMSIS-DAP vendor command\n", __func__);
+        jtag3_edbg_drain(pgm, nreq - nrecv);
+        mmt_free(request);
+        mmt_free(*msg);
+        return -1;
+      }
     }
 
     rv = serial_recv(&pgm->fd, buf, pgm->fd.usb.max_xfer);
@@ -706,13 +772,17 @@ static int jtag3_edbg_recv_frame(const PROGRAMMER *pgm, unsigned char **msg) {
     if(rv < 0) {
       // Timeout in receive
       pmsg_notice2("%s(): timeout receiving packet\n", __func__);
+      if(nreq - nrecv > 1)      // Later responses may still arrive: no more streaming
+        my.edbg_npackets = 1;
       mmt_free(*msg);
       mmt_free(request);
       return -1;
     }
+    nrecv++;
 
     if(buf[0] != EDBG_VENDOR_AVR_RSP) {
       pmsg_notice("%s(): unexpected response 0x%02x\n", __func__, buf[0]);
+      jtag3_edbg_drain(pgm, nreq - nrecv);
       mmt_free(*msg);
       mmt_free(request);
       return -1;
@@ -725,6 +795,7 @@ static int jtag3_edbg_recv_frame(const PROGRAMMER *pgm, unsigned char **msg) {
        */
       cx->usb_access_error = 1; // Also end up here on wrong USB permissions
       pmsg_notice("%s(): no response available\n", __func__);
+      jtag3_edbg_drain(pgm, nreq - nrecv);
       mmt_free(*msg);
       mmt_free(request);
       return -1;
@@ -738,6 +809,7 @@ static int jtag3_edbg_recv_frame(const PROGRAMMER *pgm, unsigned char **msg) {
     } else {
       if(nfrags != (buf[1] & 0x0F)) {
         pmsg_notice("%s(): inconsistent # of fragments; had %d, now %d\n", __func__, nfrags, (buf[1] & 0x0F));
+        jtag3_edbg_drain(pgm, nreq - nrecv);
         mmt_free(*msg);
         mmt_free(request);
         return -1;
@@ -746,6 +818,7 @@ static int jtag3_edbg_recv_frame(const PROGRAMMER *pgm, unsigned char **msg) {
     if(thisfrag != ((buf[1] >> 4) & 0x0F)) {
       pmsg_notice("%s(): inconsistent fragment number; expect %d, got %d\n",
         __func__, thisfrag, ((buf[1] >> 4) & 0x0F));
+      jtag3_edbg_drain(pgm, nreq - nrecv);
       mmt_free(*msg);
       mmt_free(request);
       return -1;
@@ -32,6 +32,17 @@
 #include <termios.h>
 #endif
 
+// Per-session state is thread-local so independent sessions can run on separate threads
+#ifndef AVRDUDE_TLS
+#if defined(__cplusplus)
+#define AVRDUDE_TLS thread_local
+#elif defined(_MSC_VER)
+#define AVRDUDE_TLS __declspec(thread)
+#else
+#define AVRDUDE_TLS _Thread_local
+#endif
+#endif
+
 #ifdef LIBAVRDUDE_INCLUDE_INTERNAL_HEADERS
 #error LIBAVRDUDE_INCLUDE_INTERNAL_HEADERS is defined. Do not do that.
 #endif
@@ -590,6 +601,39 @@ typedef struct avrmem_alias {
 
 typedef struct programmer PROGRAMMER;   // Forward declaration
 
+typedef struct {                // Scatter/gather list entry for multi-page transfers
+  unsigned int addr;            // Start address of the page within the memory
+  unsigned int n;               // Number of bytes to transfer
+} Page_desc;
+
+typedef struct {                // Contiguous mismatches found by avr_verify_mem()
+  const char *memdesc;          // Memory name
+  int beg, end;                 // First and last address of the range
+  int ro;                       // Mismatches are in read-only locations and were ignored
+} Mismatch_range;
+
+typedef enum {                  // Session phases timed by avr_phase_end()
+  AVR_PH_OPEN, AVR_PH_INIT, AVR_PH_SIGNATURE, AVR_PH_ERASE,
+  AVR_PH_WRITE, AVR_PH_VERIFY, AVR_PH_READ, AVR_PH_FILEIO,
+  AVR_PH_N
+} Avr_phase;
+
+typedef struct {                // Per-memory I/O counters of a session
+  const char *memdesc;          // Memory name
+  unsigned long rbytes, wbytes; // Bytes read from and written to the device
+  unsigned long rtrans, wtrans; // Programmer read/write calls (paged, multi-page or byte)
+  unsigned long retries;        // Fallbacks and repeated attempts after failures or polling
+} Avr_mem_stats;
+
+#define AVR_NMEM_STATS 24       // Max number of memories with I/O counters per session
+
+// Adaptive NVM busy waiting, see avr_nvm_wait()
+#define AVR_NVM_TIMEOUT_US  10000000 // Default time out for NVM operations
+#define AVR_NVM_MIN_SLEEP_US     100 // Expected busy times below this are polled right away
+#define AVR_NVM_MIN_BACKOFF_US    50 // Shortest pause between polls
+#define AVR_NVM_MAX_BACKOFF_US  5000 // Longest pause between polls
+#define AVR_NVM_NOCMD              0 // Key for no pending NVM command (TPI and UPDI no-operation)
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -828,8 +872,8 @@ const char *pinmask_to_str(const Pinmask *const pinmask);
  * The target file will be selected at configure time.
  */
 
-extern long serial_recv_timeout;        // ms
-extern long serial_drain_timeout;       // ms
+extern AVRDUDE_TLS long serial_recv_timeout;  // ms
+extern AVRDUDE_TLS long serial_drain_timeout; // ms
 
 union filedescriptor {
   int ifd;
@@ -900,28 +944,95 @@ struct serial_device {
 #define SERDEV_FL_CANSETSPEED 1 // Device can change speed
 };
 
-extern struct serial_device *serdev;
+extern AVRDUDE_TLS struct serial_device *serdev;
 extern struct serial_device serial_serdev;
 extern struct serial_device usb_serdev;
 extern struct serial_device usb_serdev_frame;
 extern struct serial_device avrdoper_serdev;
 extern struct serial_device usbhid_serdev;
 
-#define serial_open (serdev->open)
-#define serial_setparams (serdev->setparams)
-#define serial_close (serdev->close)
-#define serial_rawclose (serdev->rawclose)
-#define serial_send (serdev->send)
-#define serial_recv (serdev->recv)
-#define serial_drain (serdev->drain)
-#define serial_set_dtr_rts (serdev->set_dtr_rts)
+// Recording or replaying the serdev exchange, see ser_trace.c
+#define serial_traced (cx->trace_fp || cx->replay_buf)
+
+#define serial_open (serial_traced? serial_trace_open: serdev->open)
+#define serial_setparams (serial_traced? serial_trace_setparams: serdev->setparams)
+#define serial_close (serial_traced? serial_trace_close: serdev->close)
+#define serial_rawclose (serial_traced? serial_trace_rawclose: serdev->rawclose)
+#define serial_send (serial_traced? serial_trace_send: serdev->send)
+#define serial_recv (serial_traced? serial_trace_recv: serdev->recv)
+#define serial_drain (serial_traced? serial_trace_drain: serdev->drain)
+#define serial_set_dtr_rts (serial_traced? serial_trace_set_dtr_rts: serdev->set_dtr_rts)
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+  int serial_record(const char *fname);
+  int serial_replay(const char *fname);
+  int serial_trace_end(void);
+  int serial_trace_open(const char *port, union pinfo pinfo, union filedescriptor *fd);
+  int serial_trace_setparams(const union filedescriptor *fd, long baud, unsigned long cflags);
+  void serial_trace_close(union filedescriptor *fd);
+  void serial_trace_rawclose(union filedescriptor *fd);
+  int serial_trace_send(const union filedescriptor *fd, const unsigned char *buf, size_t buflen);
+  int serial_trace_recv(const union filedescriptor *fd, unsigned char *buf, size_t buflen);
+  int serial_trace_drain(const union filedescriptor *fd, int display);
+  int serial_trace_set_dtr_rts(const union filedescriptor *fd, int is_on);
+
+#ifdef __cplusplus
+}
+#endif
+
+#if !defined(WIN32)
+/*
+ * Asynchronous serial I/O (ser_posix.c) built on epoll (Linux) or poll().
+ * Requests on the same fd and direction complete in submission order; the
+ * callback receives 0 on success, SERIAL_ASYNC_TIMEOUT when no byte arrived
+ * (or could be written) within timeout ms, or -errno, and the number of
+ * bytes transferred. The blocking serial_serdev functions are a shim over it.
+ */
+#define SERIAL_ASYNC_TIMEOUT (-1000)
+
+// Max time ser_send() waits for the port to accept more bytes; independent of serial_recv_timeout
+extern AVRDUDE_TLS long serial_send_timeout; // ms
+
+typedef struct serial_loop Serial_loop;
+typedef void (*Serial_cb)(void *arg, int status, unsigned char *buf, size_t len);
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+  Serial_loop *serial_loop_new(void);
+  void serial_loop_free(Serial_loop *loop);
+  int serial_async_recv(Serial_loop *loop, const union filedescriptor *fd, unsigned char *buf, size_t len,
+    long timeout, Serial_cb cb, void *arg);
+  int serial_async_send(Serial_loop *loop, const union filedescriptor *fd, const unsigned char *buf, size_t len,
+    long timeout, Serial_cb cb, void *arg);
+  int serial_loop_run(Serial_loop *loop, long timeout);
+
+#ifdef __cplusplus
+}
+#endif
+#endif
 
 // See avrcache.c
+typedef struct {                // Cache statistics, kept when the cache is reset
+  unsigned long hits, misses;   // Cached accesses served from the cache or needing a page load
+  unsigned long flushed;        // Pages written to the device when synchronising the cache
+  unsigned long combined;       // Multi-page writes used for runs of adjacent dirty pages
+  unsigned long prefetched;     // Pages loaded by read-ahead
+} AVR_Cache_stats;
+
 typedef struct {                // Memory cache for a subset of cached pages
   int size, page_size;          // Size of cache (flash or eeprom size) and page size
   unsigned int offset;          // Offset of flash/eeprom memory
   unsigned char *cont, *copy;   // Current memory contens and device copy of it
   unsigned char *iscached;      // iscached[i] set when page i has been loaded
+  uint64_t *isdirty;            // Bit i set when page i may have been changed since loading
+  int ndirty;                   // Number of set bits in isdirty[]
+  int lastpg, window;           // Last page read and current read-ahead window in pages
+  AVR_Cache_stats stats;
 } AVR_Cache;
 
 // Formerly pgm.h
@@ -1034,6 +1145,7 @@ typedef struct programmer {
   int (*cmd_tpi)(const PROGRAMMER *pgm, const unsigned char *cmd, int cmd_len,
     unsigned char *res, int res_len);
   int (*spi)(const PROGRAMMER *pgm, const unsigned char *cmd, unsigned char *res, int count);
+  int (*cmd_multi)(const PROGRAMMER *pgm, const unsigned char *cmds, unsigned char *res, int n);
   int (*open)(PROGRAMMER *pgm, const char *port);
   void (*close)(PROGRAMMER *pgm);
   int (*paged_write)(const PROGRAMMER *pgm, const AVRPART *p, const AVRMEM *m,
@@ -1041,6 +1153,12 @@ typedef struct programmer {
   int (*paged_load)(const PROGRAMMER *pgm, const AVRPART *p, const AVRMEM *m,
     unsigned int pg_size, unsigned int addr, unsigned int n);
   int (*page_erase)(const PROGRAMMER *pgm, const AVRPART *p, const AVRMEM *m, unsigned int addr);
+  int (*paged_write_multi)(const PROGRAMMER *pgm, const AVRPART *p, const AVRMEM *m,
+    unsigned int pg_size, const Page_desc *pages, int npages);
+  int (*paged_load_multi)(const PROGRAMMER *pgm, const AVRPART *p, const AVRMEM *m,
+    unsigned int pg_size, const Page_desc *pages, int npages);
+  int (*checksum)(const PROGRAMMER *pgm, const AVRPART *p, const AVRMEM *m,
+    unsigned int addr, unsigned int n, uint32_t *crcp);
   void (*write_setup)(const PROGRAMMER *pgm, const AVRPART *p, const AVRMEM *m);
   int (*write_byte)(const PROGRAMMER *pgm, const AVRPART *p, const AVRMEM *m,
     unsigned long addr, unsigned char value);
@@ -1077,6 +1195,10 @@ typedef struct programmer {
     unsigned long addr, unsigned char value);
   int (*read_byte_cached)(const PROGRAMMER *pgm, const AVRPART *p, const AVRMEM *m,
     unsigned long addr, unsigned char *value);
+  int (*write_range_cached)(const PROGRAMMER *pgm, const AVRPART *p, const AVRMEM *m,
+    unsigned long addr, const unsigned char *buf, unsigned long len);
+  int (*read_range_cached)(const PROGRAMMER *pgm, const AVRPART *p, const AVRMEM *m,
+    unsigned long addr, unsigned char *buf, unsigned long len);
   int (*chip_erase_cached)(const PROGRAMMER *pgm, const AVRPART *p);
   int (*page_erase_cached)(const PROGRAMMER *pgm, const AVRPART *p, const AVRMEM *m,
     unsigned int addr);
@@ -1141,20 +1263,30 @@ typedef void (*FP_UpdateProgress)(int percent, double etime, const char *hdr, in
 extern struct avrpart parts[];
 extern Memtable avr_mem_order[100];
 
-extern FP_UpdateProgress update_progress;
+extern AVRDUDE_TLS FP_UpdateProgress update_progress;
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
   int avr_tpi_poll_nvmbsy(const PROGRAMMER *pgm);
+  int avr_nvm_wait(const PROGRAMMER *pgm, const AVRPART *p, int (*poll)(const PROGRAMMER *pgm, const AVRPART *p),
+    int key, const AVRMEM *mem, unsigned long timeout_us);
+  int avr_tpi_wait_nvm(const PROGRAMMER *pgm, const AVRPART *p, const AVRMEM *mem, int cmd);
   int avr_tpi_chip_erase(const PROGRAMMER *pgm, const AVRPART *p);
   int avr_tpi_program_enable(const PROGRAMMER *pgm, const AVRPART *p, unsigned char guard_time);
   int avr_sigrow_offset(const AVRPART *p, const AVRMEM *mem, int addr);
   int avr_flash_offset(const AVRPART *p, const AVRMEM *mem, int addr);
+  int avr_cmd_multi(const PROGRAMMER *pgm, const unsigned char *cmds, unsigned char *res, int n);
   int avr_read_byte_default(const PROGRAMMER *pgm, const AVRPART *p, const AVRMEM *mem,
     unsigned long addr, unsigned char *value);
   int avr_read_mem(const PROGRAMMER *pgm, const AVRPART *p, const AVRMEM *mem, const AVRPART *v);
+  int avr_read_mem_verify(const PROGRAMMER *pgm, const AVRPART *p, const AVRMEM *mem, const AVRPART *v);
+  uint32_t avr_crc32(uint32_t crc, const unsigned char *buf, size_t n);
+  void avr_phase_end(Avr_phase ph, double start);
+  void avr_count_io(const AVRMEM *mem, int write, unsigned long ntrans, unsigned long nbytes);
+  void avr_count_retry(const AVRMEM *mem);
+  void avr_stats_json(FILE *fp, const PROGRAMMER *pgm, const AVRPART *p, int exitrc);
   int avr_read(const PROGRAMMER *pgm, const AVRPART *p, const char *memstr, const AVRPART *v);
   int avr_write_page(const PROGRAMMER *pgm, const AVRPART *p, const AVRMEM *mem, unsigned long addr);
 
@@ -1171,11 +1303,14 @@ extern "C" {
   int avr_write_byte_default(const PROGRAMMER *pgm, const AVRPART *p, const AVRMEM *mem,
     unsigned long addr, unsigned char data);
   int avr_write_mem(const PROGRAMMER *pgm, const AVRPART *p, const AVRMEM *mem, int size, int auto_erase);
+  int avr_can_page_erase_flash(const PROGRAMMER *pgm, const AVRPART *p);
   int avr_write(const PROGRAMMER *pgm, const AVRPART *p, const char *memstr, int size, int auto_erase);
   int avr_signature(const PROGRAMMER *pgm, const AVRPART *p);
   int avr_mem_bitmask(const AVRPART *p, const AVRMEM *mem, int addr);
   int avr_verify(const PROGRAMMER *pgm, const AVRPART *p, const AVRPART *v, const char *m, int size);
   int avr_verify_mem(const PROGRAMMER *pgm, const AVRPART *p, const AVRPART *v, const AVRMEM *a, int size);
+  const Mismatch_range *avr_mismatches(int *nranges);
+  void avr_clear_mismatches(void);
   int avr_get_cycle_count(const PROGRAMMER *pgm, const AVRPART *p, int *cycles);
   int avr_put_cycle_count(const PROGRAMMER *pgm, const AVRPART *p, int cycles);
 
@@ -1202,11 +1337,15 @@ extern "C" {
     int addr, unsigned char *data);
   int avr_is_and(const unsigned char *s1, const unsigned char *s2, const unsigned char *s3, size_t n);
 
-  // Bytewise cached read/write API
+  // Cached read/write API
   int avr_read_byte_cached(const PROGRAMMER *pgm, const AVRPART *p, const AVRMEM *mem,
     unsigned long addr, unsigned char *value);
   int avr_write_byte_cached(const PROGRAMMER *pgm, const AVRPART *p, const AVRMEM *mem,
     unsigned long addr, unsigned char data);
+  int avr_read_range_cached(const PROGRAMMER *pgm, const AVRPART *p, const AVRMEM *mem,
+    unsigned long addr, unsigned char *buf, unsigned long len);
+  int avr_write_range_cached(const PROGRAMMER *pgm, const AVRPART *p, const AVRMEM *mem,
+    unsigned long addr, const unsigned char *buf, unsigned long len);
   int avr_chip_erase_cached(const PROGRAMMER *pgm, const AVRPART *p);
   int avr_page_erase_cached(const PROGRAMMER *pgm, const AVRPART *p, const AVRMEM *mem,
     unsigned int addr);
@@ -1270,6 +1409,8 @@ extern "C" {
   int fileio_fmt_autodetect(const char *fname);
   int fileio_mem(int oprwv, const char *filename, FILEFMT format, const AVRPART *p, const AVRMEM *mem, int size);
   int fileio(int oprwv, const char *filename, FILEFMT format, const AVRPART *p, const char *memstr, int size);
+  int fileio_share(int oprwv, const char *filename, FILEFMT format, const AVRPART *p, const AVRMEM *mem);
+  void fileio_unshare(void);
   int segment_normalise(const AVRMEM *mem, Segment *segp);
   int fileio_segments(int oprwv, const char *filename, FILEFMT format,
     const AVRPART *p, const AVRMEM *mem, int n, const Segment *seglist);
@@ -1333,6 +1474,7 @@ extern "C" {
   int update_is_readable(const char *fn);
 
   int update_dryrun(const AVRPART *p, UPDATE *upd);
+  int update_share_input(const AVRPART *p, const UPDATE *upd);
 
   AVRMEM **memory_list(const char *mstr, const PROGRAMMER *pgm, const AVRPART *p,
     int *np, int *rwvsoftp, int *dry);
@@ -1380,6 +1522,27 @@ extern int allow_subshells;
 // This name is fixed, it's only here for symmetry with default_parallel and default_serial
 #define DEFAULT_USB       "usb"
 
+// Index of part_list or programmers for fast locate_part(), locate_programmer() etc
+typedef struct {
+  char *key;                    // Lower-case name, eg, part id, desc or variant; programmer id
+  void *data;                   // The part or programmer
+  const char *name;             // Original name string (programmer id in its id list)
+} Cfg_hashent;
+
+typedef struct {
+  int key, pos;                 // Signature/devcode and position in list
+  void *data;                   // The part
+} Cfg_nument;
+
+typedef struct {
+  LISTID list;                  // Indexed list
+  int nlist;                    // Number of list elements when indexed
+  unsigned mask;                // Size of hash table minus 1 (size is a power of 2)
+  Cfg_hashent *tab;             // Open-addressing hash table of names
+  int nsig, ndev;               // Number of entries in sig[] and dev[]
+  Cfg_nument *sig, *dev;        // Parts sorted by signature or avr910 devcode, then list position
+} Cfg_index;
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -1391,7 +1554,15 @@ extern "C" {
   int init_config(void);
   void cleanup_config(void);
   int read_config(const char *file);
+  int read_config_cache(const char *cachefile, LISTID cfgfiles);
+  int write_config_cache(const char *cachefile, LISTID cfgfiles);
   const char *cache_string(const char *file);
+  void cfg_index_parts(LISTID parts);
+  void cfg_index_programmers(LISTID pgms);
+  void cfg_free_indices(void);
+  int cfg_index_valid(const Cfg_index *ix, LISTID list);
+  void *cfg_index_lookup(const Cfg_index *ix, const char *name, const char **setid);
+  void *cfg_index_number(const Cfg_index *ix, int sig, int key, int prog_modes);
   size_t cfg_unescapen(unsigned char *d, const unsigned char *s);
   unsigned char *cfg_unescapeu(unsigned char *d, const unsigned char *s);
   char *cfg_unescape(char *d, const char *s);
@@ -1796,6 +1967,13 @@ extern "C" {
  * pointer libavrdude_context *cx; applications using libavrdude ought to
  * allocate cx = mmt_malloc(sizeof *cx) for each instantiation (and set initial
  * values if needed) and deallocate with mmt_free(cx).
+ *
+ * The pointer cx, serdev, the serial timeouts, update_progress as well as
+ * verbose, quell_progress, ovsigck, partdesc and pgmid are thread-local. A
+ * thread that runs its own session calls init_cx() and sets these as needed;
+ * it can then drive its own PROGRAMMER and AVRPART independently of other
+ * threads. The part and programmer lists from the configuration files are
+ * shared and must be read before threads are started.
  */
 
 typedef struct {
@@ -1805,20 +1983,40 @@ typedef struct {
 
   // Static variables from avr.c
   int avr_disableffopt;         // Disables trailing 0xff flash optimisation
+  int avr_incremental;          // Only write flash pages that differ from the device
+  int avr_pages_checked;        // Flash pages compared with the device in last incremental write
+  int avr_pages_skipped;        // Of which were unchanged and not written
   uint64_t avr_epoch;           // Epoch for avr_ustimestamp()
   int avr_epoch_init;           // Whether above epoch is initialised
   int avr_last_percent;         // Last valid percentage for report_progress()
   double avr_start_time;        // Start time in s of report_progress() activity
+  int avr_range_noprogress;     // Range cache calls leave progress reports to their caller
+  Mismatch_range *avr_mismatch; // Mismatch ranges of avr_verify_mem() since avr_clear_mismatches()
+  int avr_nmismatch, avr_mismatch_cap;
+  double avr_phase_secs[AVR_PH_N]; // Time spent in each phase, see avr_phase_end()
+  int avr_phase_count[AVR_PH_N];   // Number of times a phase was entered
+  Avr_mem_stats avr_mstats[AVR_NMEM_STATS]; // I/O counters, see avr_count_io()
+  int avr_nmstats;
+  unsigned long avr_nvm_wait_us[256]; // Observed NVM busy time per command, see avr_nvm_wait()
+
+  // Static variables from ser_trace.c
+  FILE *trace_fp;               // Recording of the serdev exchange (--record)
+  uint64_t trace_start;         // Time stamp of the start of the recording or replay
+  unsigned char *replay_buf;    // Contents of the trace file served by --replay
+  size_t replay_len, replay_pos;
+  int replay_nrec;              // Number of replayed records
+  int replay_diverged;          // Driver deviated from the recording
 
   // Static variables from bitbang.c
-  int bb_delay_decrement;
+  int bb_delay_decrement;       // Loop count per us when there is no usable clock
+  uint64_t bb_clock_ns;         // Cost of reading the monotonic clock
+  uint64_t bb_slack_ns;         // Oversleep of short sleeps
+  uint64_t bb_bit_ns;           // Measured time of one bit without delays
+  uint64_t bb_pin_delay_ns;     // Pin delay meeting the -B bit clock
 
 #if defined(WIN32)
   int bb_has_perfcount;
   uint64_t bb_freq;             // Should be LARGE_INTEGER but what to include?
-#else
-  int bb_done;                  // Handshake variable in alarm handler
-  void (*bb_saved_alarmf)(int); // Saved alarm handler
 #endif
 
   // Static variables from config.c
@@ -1831,6 +2029,8 @@ typedef struct {
   LISTID cfg_pushedcomms;       // Temporarily pushed main comments
   int cfg_pushed;               // ... for memory sections
   int cfg_init_search;          // Used in cfg_comp_search()
+  Cfg_index cfg_partidx;        // Index of part_list for locate_part() etc
+  Cfg_index cfg_pgmidx;         // Index of programmers for locate_programmer() etc
 
   // Static variable from dfu.c
   uint16_t dfu_wIndex;          // A running number for USB messages
@@ -1853,6 +2053,7 @@ typedef struct {
 #else
   struct termios ser_original_termios;
   int ser_saved_original_termios;
+  struct serial_loop *ser_loop; // Event loop for the blocking serial functions
 #endif
 
   // Static variables from term.c
@@ -1897,7 +2098,7 @@ typedef struct {
   int usb_access_error;
 } libavrdude_context;
 
-extern libavrdude_context *cx;
+extern AVRDUDE_TLS libavrdude_context *cx;
 
 // Formerly confwin.h
 
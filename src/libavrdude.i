@@ -40,12 +40,12 @@ The following global variables are available in `ad.cvar`:
 // global variables referenced by library
 char * version  = AVRDUDE_FULL_VERSION;
 char * progname = "avrdude";
-int verbose;
-int quell_progress;
-int ovsigck;
-const char *partdesc = "";
-const char *pgmid = "";
-libavrdude_context *cx;
+AVRDUDE_TLS int verbose;
+AVRDUDE_TLS int quell_progress;
+AVRDUDE_TLS int ovsigck;
+AVRDUDE_TLS const char *partdesc = "";
+AVRDUDE_TLS const char *pgmid = "";
+AVRDUDE_TLS libavrdude_context *cx;
 
 static PyObject *msg_cb = NULL;
 static PyObject *progress_cb = NULL;
@@ -357,7 +357,8 @@ int avr_initmem(const AVRPART *p);
 %extend avrmem {
   %typemap(in) (unsigned char *in, unsigned int len) {
     Py_ssize_t len;
-    PyBytes_AsStringAndSize($input, (char **)&$1, &len);
+    if (PyBytes_AsStringAndSize($input, (char **)&$1, &len) == -1)
+      SWIG_fail;
     $2 = len;
   }
 %feature("autodoc", "m.put(in: bytes, len: int, offset: int = 0) => return len; Copy to memory buffer, set ALLOCATED tag") put;
@@ -464,6 +465,29 @@ typedef enum {
   else
     $result = PyFloat_FromDouble(*$1);
  }
+// read_range_cached() takes the number of bytes and returns them as bytes() or None on failure
+%typemap(in) (unsigned char *rbuf, unsigned long rlen) {
+  $2 = PyLong_AsUnsignedLong($input);
+  $1 = (unsigned char *) malloc($2? $2: 1);
+ }
+%typemap(argout) (unsigned char *rbuf, unsigned long rlen) {
+  if ($result == NULL)
+    $result = Py_None;
+  else if (PyLong_Check($result) && PyLong_AsLong($result) != 0)
+    $result = Py_None;
+  else
+    $result = PyBytes_FromStringAndSize((const char *)$1, $2);
+ }
+%typemap(freearg) (unsigned char *rbuf, unsigned long rlen) {
+  free($1);
+ }
+// write_range_cached() takes the data as bytes()
+%typemap(in) (const unsigned char *wbuf, unsigned long wlen) {
+  Py_ssize_t len;
+  if (PyBytes_AsStringAndSize($input, (char **)&$1, &len) == -1)
+    SWIG_fail;
+  $2 = len;
+ }
 // abuse check typemap to check for methods not being NULL
 // it must be ensured that each argument type/name applies to just one method
 %typemap(check) (char *sib) {
@@ -573,6 +597,10 @@ typedef struct programmer {
                         unsigned long addr, unsigned char value);
   int read_byte_cached(const struct programmer *pgm, const AVRPART *p, const AVRMEM *m,
                         unsigned long addr, unsigned char *value);
+  int write_range_cached(const struct programmer *pgm, const AVRPART *p, const AVRMEM *m,
+                        unsigned long addr, const unsigned char *wbuf, unsigned long wlen);
+  int read_range_cached(const struct programmer *pgm, const AVRPART *p, const AVRMEM *m,
+                        unsigned long addr, unsigned char *rbuf, unsigned long rlen);
   int chip_erase_cached(const struct programmer *pgm, const AVRPART *p);
   int page_erase_cached(const struct programmer *pgm, const AVRPART *p, const AVRMEM *m,
                         unsigned int baseaddr);
@@ -648,7 +676,8 @@ AVRMEM_ALIAS * avr_find_memalias(const AVRPART *p, const AVRMEM *m_orig);
 // map Python bytes() to sig+sigsize
 %typemap(in) (unsigned char *sig, int sigsize) {
   Py_ssize_t len;
-  PyBytes_AsStringAndSize($input, (char **)&$1, &len);
+  if (PyBytes_AsStringAndSize($input, (char **)&$1, &len) == -1)
+    SWIG_fail;
   $2 = (int)len;
 }
 AVRPART * locate_part_by_signature(const LISTID parts, unsigned char *sig, int sigsize);
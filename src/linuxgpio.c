@@ -54,6 +54,13 @@
 
 struct pdata {
   int sysfs_fds[N_GPIO];        // Open FDs of /sys/class/gpio/gpioXX/value for needed pins
+#ifdef HAVE_LIBGPIOD
+  struct gpiod_line *libgpiod_lines[N_PINS]; // Line handles of the pins in use
+#endif
+#if defined(HAVE_LIBGPIOD) && HAVE_LIBGPIOD_V2
+  struct gpiod_chip *spi_chip;  // Chip and bulk line request of SCK, SDO and SDI
+  struct gpiod_line_request *spi_request;
+#endif
 };
 
 // Use private programmer data as if they were a global structure my
@@ -163,8 +170,7 @@ static int linuxgpio_sysfs_setpin(const PROGRAMMER *pgm, int pinfunc, int value)
   if(write(my.sysfs_fds[pin], value? "1": "0", 1) != 1)
     return -1;
 
-  if(pgm->ispdelay > 1)
-    bitbang_delay(pgm->ispdelay);
+  bitbang_pin_delay(pgm);
 
   return 0;
 }
@@ -388,6 +394,7 @@ struct gpiod_line {
   struct gpiod_chip *chip;
   struct gpiod_line_request *line_request;
   unsigned int gpio_num;
+  int shared;                   // Line is part of the bulk SPI request, see below
 };
 
 struct gpiod_line *gpiod_line_get(const char *port, int gpio_num) {
@@ -514,8 +521,10 @@ err_out:
 }
 
 void gpiod_line_release(struct gpiod_line *gpio_line) {
-  gpiod_line_request_release(gpio_line->line_request);
-  gpiod_chip_close(gpio_line->chip);
+  if(!gpio_line->shared) {
+    gpiod_line_request_release(gpio_line->line_request);
+    gpiod_chip_close(gpio_line->chip);
+  }
   mmt_free(gpio_line);
 }
 
@@ -537,7 +546,183 @@ static inline unsigned int linuxgpio_get_gpio_num(struct gpiod_line *gpio_line)
 #endif
 }
 
-struct gpiod_line *linuxgpio_libgpiod_lines[N_PINS];
+#if HAVE_LIBGPIOD_V2
+/*
+ * SCK, SDO and SDI are requested as one bulk line request so that SPI
+ * transfers can change SCK and SDO with a single set-values call per edge
+ * group; all other pins keep their own request. The request lives in the
+ * programmer's private data so concurrent sessions each have their own.
+ */
+static const int linuxgpio_spi_pins[] = { PIN_AVR_SCK, PIN_AVR_SDO, PIN_AVR_SDI };
+
+static int linuxgpio_libgpiod_bulk_open(const PROGRAMMER *pgm, const char *port) {
+  struct gpiod_line_settings *out = NULL, *in = NULL;
+  struct gpiod_line_config *line_config = NULL;
+  struct gpiod_request_config *req_cfg = NULL;
+  unsigned int offsets[3];
+  char abs_port[32];
+  int retval = -1;
+
+  for(int k = 0; k < 3; k++)
+    if((offsets[k] = pgm->pinno[linuxgpio_spi_pins[k]] & PIN_MASK) > PIN_MAX)
+      return -1;
+  if(offsets[0] == offsets[1] || offsets[0] == offsets[2] || offsets[1] == offsets[2])
+    return -1;
+
+  if(snprintf(abs_port, sizeof(abs_port), "/dev/%s", port) >= (int) sizeof(abs_port))
+    return -1;
+  if(!(my.spi_chip = gpiod_chip_open(abs_port)))
+    return -1;
+
+  out = gpiod_line_settings_new();
+  in = gpiod_line_settings_new();
+  line_config = gpiod_line_config_new();
+  req_cfg = gpiod_request_config_new();
+  if(!out || !in || !line_config || !req_cfg)
+    goto err_out;
+
+  if(gpiod_line_settings_set_direction(out, GPIOD_LINE_DIRECTION_OUTPUT) ||
+    gpiod_line_settings_set_output_value(out, GPIOD_LINE_VALUE_INACTIVE) ||
+    gpiod_line_settings_set_direction(in, GPIOD_LINE_DIRECTION_INPUT))
+    goto err_out;
+  if(gpiod_line_config_add_line_settings(line_config, offsets, 2, out) ||
+    gpiod_line_config_add_line_settings(line_config, offsets + 2, 1, in))
+    goto err_out;
+  gpiod_request_config_set_consumer(req_cfg, "avrdude");
+
+  if(!(my.spi_request = gpiod_chip_request_lines(my.spi_chip, req_cfg, line_config)))
+    goto err_out;
+
+  for(int k = 0; k < 3; k++) {
+    struct gpiod_line *line = mmt_malloc(sizeof *line);
+
+    *line = (struct gpiod_line) { my.spi_chip, my.spi_request, offsets[k], 1 };
+    my.libgpiod_lines[linuxgpio_spi_pins[k]] = line;
+  }
+  retval = 0;
+
+err_out:
+  gpiod_line_settings_free(out);
+  gpiod_line_settings_free(in);
+  gpiod_line_config_free(line_config);
+  gpiod_request_config_free(req_cfg);
+  if(retval) {
+    gpiod_chip_close(my.spi_chip);
+    my.spi_chip = NULL;
+  }
+  return retval;
+}
+
+// Turn the bulk SPI lines into inputs and release them
+static void linuxgpio_libgpiod_bulk_close(const PROGRAMMER *pgm) {
+  struct gpiod_line_settings *in = gpiod_line_settings_new();
+  struct gpiod_line_config *line_config = gpiod_line_config_new();
+  unsigned int offsets[3];
+
+  if(!my.spi_request)
+    goto out;
+
+  for(int k = 0; k < 3; k++) {
+    offsets[k] = my.libgpiod_lines[linuxgpio_spi_pins[k]]->gpio_num;
+    gpiod_line_release(my.libgpiod_lines[linuxgpio_spi_pins[k]]);
+    my.libgpiod_lines[linuxgpio_spi_pins[k]] = NULL;
+  }
+  if(!in || !line_config || gpiod_line_settings_set_direction(in, GPIOD_LINE_DIRECTION_INPUT) ||
+    gpiod_line_config_add_line_settings(line_config, offsets, 3, in) ||
+    gpiod_line_request_reconfigure_lines(my.spi_request, line_config))
+    msg_error("failed to set SPI pins to input: %s\n", strerror(errno));
+
+  gpiod_line_request_release(my.spi_request);
+  gpiod_chip_close(my.spi_chip);
+  my.spi_request = NULL;
+  my.spi_chip = NULL;
+
+out:
+  gpiod_line_settings_free(in);
+  gpiod_line_config_free(line_config);
+}
+
+/*
+ * Full-duplex SPI transfer of count bytes over the bulk request. The levels
+ * of all edge groups are computed upfront: per bit SCK goes high, SDI is
+ * sampled, and SCK goes low together with SDO taking the next bit. This needs
+ * three calls per bit rather than the four setpin()/getpin() calls of
+ * bitbang_txrx() and avoids their per-call pin lookup.
+ */
+static int linuxgpio_libgpiod_spi(const PROGRAMMER *pgm, const unsigned char *cmd, unsigned char *res, int count) {
+  unsigned int sck = my.libgpiod_lines[PIN_AVR_SCK]->gpio_num;
+  unsigned int sdi = my.libgpiod_lines[PIN_AVR_SDI]->gpio_num;
+  unsigned int offs[2] = { sck, my.libgpiod_lines[PIN_AVR_SDO]->gpio_num };
+  int isck = !!(pgm->pinno[PIN_AVR_SCK] & PIN_INVERSE), isdo = !!(pgm->pinno[PIN_AVR_SDO] & PIN_INVERSE);
+  int isdi = !!(pgm->pinno[PIN_AVR_SDI] & PIN_INVERSE), nbits = 8*count, rc = 0;
+  enum gpiod_line_value high = isck? GPIOD_LINE_VALUE_INACTIVE: GPIOD_LINE_VALUE_ACTIVE;
+  enum gpiod_line_value *low;
+
+  if(count <= 0)
+    return 0;
+
+  // Edge group j sets SCK low and SDO to bit j; the last group keeps SDO
+  low = mmt_malloc(2*(nbits + 1)*sizeof *low);
+  for(int j = 0; j <= nbits; j++) {
+    int k = j < nbits? j: nbits - 1, b = (cmd[k/8] >> (7 - k%8)) & 1;
+
+    low[2*j] = isck? GPIOD_LINE_VALUE_ACTIVE: GPIOD_LINE_VALUE_INACTIVE;
+    low[2*j + 1] = b ^ isdo? GPIOD_LINE_VALUE_ACTIVE: GPIOD_LINE_VALUE_INACTIVE;
+  }
+  if(res)
+    memset(res, 0, count);
+
+  uint64_t start = bitbang_adapt_start(pgm);
+
+  if(gpiod_line_request_set_values_subset(my.spi_request, 2, offs, low) < 0)
+    goto error;
+  for(int j = 0; j < nbits; j++) {
+    bitbang_pin_delay(pgm);
+    if(gpiod_line_request_set_value(my.spi_request, sck, high) < 0)
+      goto error;
+    bitbang_pin_delay(pgm);
+
+    enum gpiod_line_value v = gpiod_line_request_get_value(my.spi_request, sdi);
+
+    if(v == GPIOD_LINE_VALUE_ERROR)
+      goto error;
+    if(res && ((v == GPIOD_LINE_VALUE_ACTIVE) ^ isdi))
+      res[j/8] |= 0x80 >> j%8;
+    if(gpiod_line_request_set_values_subset(my.spi_request, 2, offs, low + 2*(j + 1)) < 0)
+      goto error;
+  }
+  bitbang_pin_delay(pgm);
+  bitbang_adapt_end(pgm, start, count, 2);
+  goto out;
+
+error:
+  msg_error("failed to drive SPI lines: %s\n", strerror(errno));
+  rc = -1;
+
+out:
+  mmt_free(low);
+  return rc < 0? rc: count;
+}
+
+static int linuxgpio_libgpiod_cmd(const PROGRAMMER *pgm, const unsigned char *cmd, unsigned char *res) {
+  if(!my.spi_request)
+    return bitbang_cmd(pgm, cmd, res);
+
+  return linuxgpio_libgpiod_spi(pgm, cmd, res, 4) < 0? -1: 0;
+}
+
+// All n commands form one precomputed waveform
+static int linuxgpio_libgpiod_cmd_multi(const PROGRAMMER *pgm, const unsigned char *cmds, unsigned char *res, int n) {
+  if(!my.spi_request) {
+    for(int i = 0; i < n; i++)
+      if(bitbang_cmd(pgm, cmds + 4*i, res + 4*i) < 0)
+        return -1;
+    return 0;
+  }
+
+  return linuxgpio_libgpiod_spi(pgm, cmds, res, 4*n) < 0? -1: 0;
+}
+#endif
 
 // Try to tell if libgpiod is going to work.
 // Returns True (non-zero) if it looks like libgpiod will work, False
@@ -561,14 +746,16 @@ static void linuxgpio_libgpiod_display(const PROGRAMMER *pgm, const char *p) {
 }
 
 static int linuxgpio_libgpiod_open(PROGRAMMER *pgm, const char *port) {
-  if(pgm->bitclock)
-    pmsg_warning("-c %s does not support adjustable bitclock speed; ignoring -B\n", pgmid);
-
   if(bitbang_check_prerequisites(pgm) < 0)
     return -1;
 
   for(int i = 0; i < N_PINS; ++i)
-    linuxgpio_libgpiod_lines[i] = NULL;
+    my.libgpiod_lines[i] = NULL;
+
+#if HAVE_LIBGPIOD_V2
+  if(linuxgpio_libgpiod_bulk_open(pgm, port) < 0)
+    pmsg_notice("cannot request SPI lines in bulk; using one request per line\n");
+#endif
 
   // Avrdude assumes that if a pin number is invalid it means not used/available
   for(int i = 1; i < N_PINS; i++) { // The pin enumeration in libavrdude.h starts with PPI_AVR_VCC = 1
@@ -576,19 +763,19 @@ static int linuxgpio_libgpiod_open(PROGRAMMER *pgm, const char *port) {
     int gpio_num;
 
     gpio_num = pgm->pinno[i] & PIN_MASK;
-    if(gpio_num > PIN_MAX)
+    if(gpio_num > PIN_MAX || my.libgpiod_lines[i]) // Unused or part of the bulk request
       continue;
 
-    linuxgpio_libgpiod_lines[i] = gpiod_line_get(port, gpio_num);
-    if(linuxgpio_libgpiod_lines[i] == NULL) {
+    my.libgpiod_lines[i] = gpiod_line_get(port, gpio_num);
+    if(my.libgpiod_lines[i] == NULL) {
       msg_error("failed to open %s line %d: %s\n", port, gpio_num, strerror(errno));
       return -1;
     }
 
     // Request the pin, select direction
     r = i == PIN_AVR_SDI?
-      gpiod_line_request_input(linuxgpio_libgpiod_lines[i], "avrdude"):
-      gpiod_line_request_output(linuxgpio_libgpiod_lines[i], "avrdude", 0);
+      gpiod_line_request_input(my.libgpiod_lines[i], "avrdude"):
+      gpiod_line_request_output(my.libgpiod_lines[i], "avrdude", 0);
 
     if(r != 0) {
       msg_error("failed to request %s line %d: %s\n", port, gpio_num, strerror(errno));
@@ -603,23 +790,27 @@ static int linuxgpio_libgpiod_open(PROGRAMMER *pgm, const char *port) {
 static void linuxgpio_libgpiod_close(PROGRAMMER *pgm) {
   int i;
 
+#if HAVE_LIBGPIOD_V2
+  linuxgpio_libgpiod_bulk_close(pgm);
+#endif
+
   // First configure all pins as input, except RESET.
   // This should avoid possible conflicts when AVR firmware starts.
   for(i = 0; i < N_PINS; ++i) {
-    if(linuxgpio_libgpiod_lines[i] != NULL && i != PIN_AVR_RESET) {
+    if(my.libgpiod_lines[i] != NULL && i != PIN_AVR_RESET) {
 
 #if HAVE_LIBGPIOD_V1_6 || HAVE_LIBGPIOD_V2
-      int r = gpiod_line_set_direction_input(linuxgpio_libgpiod_lines[i]);
+      int r = gpiod_line_set_direction_input(my.libgpiod_lines[i]);
 #else
-      int r = gpiod_line_set_direction_input(&linuxgpio_libgpiod_lines[i]);
+      int r = gpiod_line_set_direction_input(&my.libgpiod_lines[i]);
 #endif
 
       if(r != 0)
         msg_error("failed to set pin %u to input: %s\n",
-          linuxgpio_get_gpio_num(linuxgpio_libgpiod_lines[i]), strerror(errno));
+          linuxgpio_get_gpio_num(my.libgpiod_lines[i]), strerror(errno));
 
-      gpiod_line_release(linuxgpio_libgpiod_lines[i]);
-      linuxgpio_libgpiod_lines[i] = NULL;
+      gpiod_line_release(my.libgpiod_lines[i]);
+      my.libgpiod_lines[i] = NULL;
     }
   }
 
@@ -628,20 +819,20 @@ static void linuxgpio_libgpiod_close(PROGRAMMER *pgm) {
   else if(pgm->exit_reset == EXIT_RESET_DISABLED) // Exit with RESET pin low
     pgm->setpin(pgm, PIN_AVR_RESET, 0);
   else { // Exit with RESET pin as input (default behaviour)
-    if(linuxgpio_libgpiod_lines[PIN_AVR_RESET] != NULL) {
+    if(my.libgpiod_lines[PIN_AVR_RESET] != NULL) {
 
   #if HAVE_LIBGPIOD_V1_6 || HAVE_LIBGPIOD_V2
-      int r = gpiod_line_set_direction_input(linuxgpio_libgpiod_lines[PIN_AVR_RESET]);
+      int r = gpiod_line_set_direction_input(my.libgpiod_lines[PIN_AVR_RESET]);
   #else
-      int r = gpiod_line_set_direction_input(&linuxgpio_libgpiod_lines[PIN_AVR_RESET]);
+      int r = gpiod_line_set_direction_input(&my.libgpiod_lines[PIN_AVR_RESET]);
   #endif
 
       if(r != 0) {
         msg_error("failed to set pin %u to input: %s\n",
-          linuxgpio_get_gpio_num(linuxgpio_libgpiod_lines[PIN_AVR_RESET]), strerror(errno));
+          linuxgpio_get_gpio_num(my.libgpiod_lines[PIN_AVR_RESET]), strerror(errno));
       }
-      gpiod_line_release(linuxgpio_libgpiod_lines[PIN_AVR_RESET]);
-      linuxgpio_libgpiod_lines[PIN_AVR_RESET] = NULL;
+      gpiod_line_release(my.libgpiod_lines[PIN_AVR_RESET]);
+      my.libgpiod_lines[PIN_AVR_RESET] = NULL;
     }
   }
 }
@@ -658,20 +849,19 @@ static int linuxgpio_libgpiod_setpin(const PROGRAMMER *pgm, int pinfunc, int val
   }
   pin &= PIN_MASK;
 
-  if(pin > PIN_MAX || linuxgpio_libgpiod_lines[pinfunc] == NULL) {
+  if(pin > PIN_MAX || my.libgpiod_lines[pinfunc] == NULL) {
     return -1;
   }
 
-  int r = gpiod_line_set_value(linuxgpio_libgpiod_lines[pinfunc], value);
+  int r = gpiod_line_set_value(my.libgpiod_lines[pinfunc], value);
 
   if(r != 0) {
     msg_error("failed to set value of %s (%u) to %d: %s\n", avr_pin_name(pinfunc),
-      linuxgpio_get_gpio_num(linuxgpio_libgpiod_lines[pinfunc]), value, strerror(errno));
+      linuxgpio_get_gpio_num(my.libgpiod_lines[pinfunc]), value, strerror(errno));
     return -1;
   }
 
-  if(pgm->ispdelay > 1)
-    bitbang_delay(pgm->ispdelay);
+  bitbang_pin_delay(pgm);
 
   return 0;
 }
@@ -686,14 +876,14 @@ static int linuxgpio_libgpiod_getpin(const PROGRAMMER *pgm, int pinfunc) {
 
   pin &= PIN_MASK;
 
-  if(pin > PIN_MAX || linuxgpio_libgpiod_lines[pinfunc] == NULL) {
+  if(pin > PIN_MAX || my.libgpiod_lines[pinfunc] == NULL) {
     return -1;
   }
 
-  int r = gpiod_line_get_value(linuxgpio_libgpiod_lines[pinfunc]);
+  int r = gpiod_line_get_value(my.libgpiod_lines[pinfunc]);
 
   if(r == -1) {
-    msg_error("failed to read %u: %s\n", linuxgpio_get_gpio_num(linuxgpio_libgpiod_lines[pinfunc]), strerror(errno));
+    msg_error("failed to read %u: %s\n", linuxgpio_get_gpio_num(my.libgpiod_lines[pinfunc]), strerror(errno));
     return -1;
   }
 
@@ -707,18 +897,18 @@ static int linuxgpio_libgpiod_highpulsepin(const PROGRAMMER *pgm, int pinfunc) {
 
   unsigned int pin = pgm->pinno[pinfunc] & PIN_MASK;
 
-  if(pin > PIN_MAX || linuxgpio_libgpiod_lines[pinfunc] == NULL) {
+  if(pin > PIN_MAX || my.libgpiod_lines[pinfunc] == NULL) {
     return -1;
   }
 
-  int r = gpiod_line_set_value(linuxgpio_libgpiod_lines[pinfunc], 1);
+  int r = gpiod_line_set_value(my.libgpiod_lines[pinfunc], 1);
 
   if(r != 0) {
     msg_error("failed to set value\n");
     return -1;
   }
 
-  r = gpiod_line_set_value(linuxgpio_libgpiod_lines[pinfunc], 0);
+  r = gpiod_line_set_value(my.libgpiod_lines[pinfunc], 0);
   if(r != 0) {
     msg_error("failed to set value\n");
     return -1;
@@ -767,6 +957,10 @@ void linuxgpio_initpgm(PROGRAMMER *pgm) {
     pgm->setpin = linuxgpio_libgpiod_setpin;
     pgm->getpin = linuxgpio_libgpiod_getpin;
     pgm->highpulsepin = linuxgpio_libgpiod_highpulsepin;
+#if HAVE_LIBGPIOD_V2
+    pgm->cmd = linuxgpio_libgpiod_cmd;
+    pgm->cmd_multi = linuxgpio_libgpiod_cmd_multi;
+#endif
   } else {
     msg_notice("falling back to sysfs for linuxgpio\n");
   }
@@ -328,6 +328,180 @@ static int linuxspi_cmd(const PROGRAMMER *pgm, const unsigned char *cmd, unsigne
   return linuxspi_spi_duplex(pgm, cmd, res, 4);
 }
 
+#define LINUXSPI_MAX_XFERS 510  // Max 4-byte commands per ioctl: SPI_IOC_MESSAGE() caps at 511
+
+// Send n 4-byte commands as one SPI message of n transfers per ioctl
+static int linuxspi_cmd_multi(const PROGRAMMER *pgm, const unsigned char *cmds, unsigned char *res, int n) {
+  struct spi_ioc_transfer *tr = mmt_malloc(LINUXSPI_MAX_XFERS*sizeof *tr);
+  int ret = 0;
+
+  for(int i = 0; i < n; i += LINUXSPI_MAX_XFERS) {
+    int k = n - i < LINUXSPI_MAX_XFERS? n - i: LINUXSPI_MAX_XFERS;
+
+    for(int j = 0; j < k; j++)
+      tr[j] = (struct spi_ioc_transfer) {
+        .tx_buf = (unsigned long) (cmds + 4*(i + j)),
+        .rx_buf = (unsigned long) (res + 4*(i + j)),
+        .len = 4,
+        .delay_usecs = 1,
+        .speed_hz = 1.0/pgm->bitclock,
+        .bits_per_word = 8,
+      };
+
+    errno = 0;
+    if(ioctl(my.fd_spidev, SPI_IOC_MESSAGE(k), tr) != 4*k) {
+      int ioctl_errno = errno;
+
+      pmsg_error("unable to send SPI message of %d commands", k);
+      if(ioctl_errno)
+        msg_error(": %s", strerror(ioctl_errno));
+      msg_error("\n");
+      ret = -1;
+      break;
+    }
+  }
+  mmt_free(tr);
+
+  return ret;
+}
+
+/*
+ * Wait until a write to memory m has finished: poll the RDY/BSY instruction
+ * if the part supports it for the write mode (page or byte) used, otherwise
+ * wait for the maximum write delay of the memory
+ */
+static int linuxspi_wait_ready(const PROGRAMMER *pgm, const AVRMEM *m, int paged) {
+  const unsigned char rdybsy[4] = { 0xf0, 0x00, 0x00, 0x00 };
+  unsigned char res[4];
+
+  if(!(m->mode & (paged? 0x40: 0x08))) {
+    usleep(m->max_write_delay);
+    return 0;
+  }
+
+  // Give up after ten times the maximum write delay, but no earlier than after 10 ms
+  uint64_t timeout = m->max_write_delay > 1000? 10*(uint64_t) m->max_write_delay: 10000;
+  uint64_t start = avr_ustimestamp();
+
+  do {
+    if(linuxspi_cmd(pgm, rdybsy, res) < 0)
+      return -1;
+    if(!(res[3] & 1))
+      return 0;
+  } while(avr_ustimestamp() - start < timeout);
+
+  pmsg_error("timeout waiting for %s write to finish\n", m->desc);
+  return -1;
+}
+
+// Queue the 4-byte command of opcode op with address addr and input data at cmd
+static unsigned char *linuxspi_putcmd(unsigned char *cmd, const OPCODE *op, unsigned long addr, int data) {
+  memset(cmd, 0, 4);
+  avr_set_bits(op, cmd);
+  avr_set_addr(op, cmd, addr);
+  if(data >= 0)
+    avr_set_input(op, cmd, data);
+
+  return cmd + 4;
+}
+
+/*
+ * Write a flash page or a paged EEPROM page: all load page commands, the
+ * preceding load extended address and the write page command go out as one
+ * SPI message; EEPROMs without page buffer are written byte by byte
+ */
+static int linuxspi_paged_write(const PROGRAMMER *pgm, const AVRPART *p, const AVRMEM *m,
+  unsigned int page_size, unsigned int addr, unsigned int n_bytes) {
+
+  int isflash = mem_is_flash(m), ncmd;
+  const OPCODE *lo = m->op[AVR_OP_LOADPAGE_LO], *hi = m->op[AVR_OP_LOADPAGE_HI];
+  const OPCODE *wrpage = m->op[AVR_OP_WRITEPAGE], *lext = m->op[AVR_OP_LOAD_EXT_ADDR];
+  unsigned char *cmds, *res, *c;
+
+  if(!isflash && !mem_is_eeprom(m))
+    return -2;
+
+  if(addr + n_bytes > (unsigned int) m->size)
+    n_bytes = m->size - addr;
+
+  if(!lo || !wrpage || (isflash && !hi)) { // No page buffer
+    const OPCODE *wop = m->op[AVR_OP_WRITE];
+
+    if(isflash || !wop)
+      return -2;
+    for(unsigned int i = addr; i < addr + n_bytes; i++) {
+      unsigned char cmd[4], r[4];
+
+      linuxspi_putcmd(cmd, wop, i, m->buf[i]);
+      if(linuxspi_cmd(pgm, cmd, r) < 0 || linuxspi_wait_ready(pgm, m, 0) < 0)
+        return -1;
+    }
+    return n_bytes;
+  }
+
+  c = cmds = mmt_malloc(4*(n_bytes + 2));
+  res = mmt_malloc(4*(n_bytes + 2));
+  if(lext)
+    c = linuxspi_putcmd(c, lext, isflash? addr/2: addr, -1);
+  for(unsigned int i = addr; i < addr + n_bytes; i++)
+    if(isflash)
+      c = linuxspi_putcmd(c, i & 1? hi: lo, i/2, m->buf[i]);
+    else
+      c = linuxspi_putcmd(c, lo, i, m->buf[i]);
+  c = linuxspi_putcmd(c, wrpage, isflash? addr/2: addr, -1);
+  ncmd = (c - cmds)/4;
+
+  int rc = linuxspi_cmd_multi(pgm, cmds, res, ncmd);
+
+  mmt_free(cmds);
+  mmt_free(res);
+  if(rc < 0 || linuxspi_wait_ready(pgm, m, 1) < 0)
+    return -1;
+
+  return n_bytes;
+}
+
+// Read a flash or EEPROM page with all read commands in one SPI message
+static int linuxspi_paged_load(const PROGRAMMER *pgm, const AVRPART *p, const AVRMEM *m,
+  unsigned int page_size, unsigned int addr, unsigned int n_bytes) {
+
+  int isflash = mem_is_flash(m), off = 0;
+  const OPCODE *lo = m->op[isflash? AVR_OP_READ_LO: AVR_OP_READ], *hi = m->op[AVR_OP_READ_HI];
+  const OPCODE *lext = m->op[AVR_OP_LOAD_EXT_ADDR];
+  unsigned char *cmds, *res, *c;
+
+  if(!isflash && !mem_is_eeprom(m))
+    return -2;
+  if(!lo || (isflash && !hi))
+    return -2;
+
+  if(addr + n_bytes > (unsigned int) m->size)
+    n_bytes = m->size - addr;
+
+  c = cmds = mmt_malloc(4*(n_bytes + 1));
+  res = mmt_malloc(4*(n_bytes + 1));
+  if(lext) {
+    c = linuxspi_putcmd(c, lext, isflash? addr/2: addr, -1);
+    off = 4;
+  }
+  for(unsigned int i = addr; i < addr + n_bytes; i++)
+    c = linuxspi_putcmd(c, isflash && (i & 1)? hi: lo, isflash? i/2: i, -1);
+
+  int rc = linuxspi_cmd_multi(pgm, cmds, res, (c - cmds)/4);
+
+  if(rc == 0)
+    for(unsigned int i = 0; i < n_bytes; i++) {
+      unsigned char data = 0;
+
+      avr_get_output(isflash && ((addr + i) & 1)? hi: lo, res + off + 4*i, &data);
+      m->buf[addr + i] = data;
+    }
+  mmt_free(cmds);
+  mmt_free(res);
+
+  return rc < 0? -1: (int) n_bytes;
+}
+
 static int linuxspi_program_enable(const PROGRAMMER *pgm, const AVRPART *p) {
   unsigned char cmd[4], res[4];
 
@@ -477,6 +651,9 @@ void linuxspi_initpgm(PROGRAMMER *pgm) {
   pgm->teardown = linuxspi_teardown;
   pgm->parseexitspecs = linuxspi_parseexitspecs;
   pgm->parseextparams = linuxspi_parseextparams;
+  pgm->cmd_multi = linuxspi_cmd_multi;
+  pgm->paged_write = linuxspi_paged_write;
+  pgm->paged_load = linuxspi_paged_load;
 }
 
 const char linuxspi_desc[] = "SPI using Linux spidev driver";
@@ -49,6 +49,10 @@
 #include <dirent.h>
 #endif
 
+#ifdef HAVE_PTHREAD_H
+#include <pthread.h>
+#endif
+
 #include "avrdude.h"
 #include "libavrdude.h"
 #include "config.h"
@@ -56,6 +60,65 @@
 
 char *progname = "avrdude";
 
+static AVRDUDE_TLS const char *msg_prefix; // Line prefix for messages, eg, port in gang mode
+static AVRDUDE_TLS char *msg_line;            // Unfinished output line of a session with prefix
+static AVRDUDE_TLS FILE *msg_line_fp;         // Stream msg_line is destined for
+
+// Print pending output of a session with prefix, eg, at the end of the session
+static void msg_flush_line(void) {
+  if(msg_line) {
+    fputs(msg_line, msg_line_fp);
+    mmt_free(msg_line);
+    msg_line = NULL;
+  }
+}
+
+/*
+ * Print to fp; sessions with a message prefix (gang mode) collect output and
+ * print only whole lines with one fputs() so concurrent sessions do not
+ * interleave within lines
+ */
+static void msg_fprintf(FILE *fp, const char *format, ...) {
+  va_list ap;
+
+  va_start(ap, format);
+  if(!msg_prefix) {
+    vfprintf(fp, format, ap);
+    va_end(ap);
+    return;
+  }
+  va_list ap2;
+
+  va_copy(ap2, ap);
+  int len = vsnprintf(NULL, 0, format, ap);
+  char *str = mmt_malloc(len < 0? 1: len + 1);
+
+  if(len > 0)
+    vsnprintf(str, len + 1, format, ap2);
+  va_end(ap2);
+  va_end(ap);
+  if(msg_line && msg_line_fp != fp)
+    msg_flush_line();
+  msg_line_fp = fp;
+  if(msg_line) {
+    char *cat = str_sprintf("%s%s", msg_line, str);
+
+    mmt_free(msg_line);
+    mmt_free(str);
+    str = cat;
+  }
+  char *eol = strrchr(str, '\n');
+
+  if(!eol) {
+    msg_line = str;
+    return;
+  }
+  msg_line = eol[1]? mmt_strdup(eol + 1): NULL;
+  eol[1] = 0;
+  fputs(str, fp);
+  mmt_free(str);
+}
+
 static const char *avrdude_message_type(int msglvl) {
   switch(msglvl) {
   case MSG_EXT_ERROR:
@@ -93,7 +156,7 @@ int avrdude_message2(FILE *fp, int lno, const char *file, const char *func,
   int rc = 0;
   va_list ap;
 
-  static struct {               // Memorise whether last print ended at beginning of line
+  static AVRDUDE_TLS struct {   // Memorise whether last print ended at beginning of line
     FILE *fp;
     int bol;                    // Are we at the beginning of a line for this fp stream?
   } bols[5 + 1];                // Cater for up to 5 different FILE pointers plus one catch-all
@@ -119,30 +182,33 @@ int avrdude_message2(FILE *fp, int lno, const char *file, const char *func,
   // Reduce effective verbosity level by number of -q above one when printing to stderr
   if((quell_progress < 2 || fp != stderr? verbose: verbose + 1 - quell_progress) >= msglvl) {
     if(msgmode & MSG2_LEFT_MARGIN && !bols[bi].bol) {
-      fprintf(fp, "\n");
+      msg_fprintf(fp, "\n");
       bols[bi].bol = 1;
     }
     // Keep vertical tab at start of format string as conditional new line
     if(*format == '\v') {
       format++;
       if(!bols[bi].bol) {
-        fprintf(fp, "\n");
+        msg_fprintf(fp, "\n");
         bols[bi].bol = 1;
       }
     }
 
+    if(msg_prefix && bols[bi].bol && *format)   // Prefix does not change bol for UCFIRST
+      msg_fprintf(fp, "[%s] ", msg_prefix);
+
     if(msgmode & (MSG2_PROGNAME | MSG2_TYPE)) {
       if(msgmode & MSG2_PROGNAME) {
-        fprintf(fp, "%s", progname);
+        msg_fprintf(fp, "%s", progname);
         bols[bi].bol = 0;
       }
       if(msgmode & MSG2_TYPE) {
         const char *mt = avrdude_message_type(msglvl);
 
         if(bols[bi].bol)
-          fprintf(fp, "%c%s", msgmode & (MSG2_UCFIRST)? toupper(*mt & 0xff): *mt, mt + 1);
+          msg_fprintf(fp, "%c%s", msgmode & (MSG2_UCFIRST)? toupper(*mt & 0xff): *mt, mt + 1);
         else
-          fprintf(fp, " %s", mt);
+          msg_fprintf(fp, " %s", mt);
         bols[bi].bol = 0;
       }
       if(verbose >= MSG_NOTICE2) {
@@ -155,16 +221,16 @@ int avrdude_message2(FILE *fp, int lno, const char *file, const char *func,
 
         bfname = bfname? bfname + 1: file;
         if(msgmode & MSG2_FUNCTION)
-          fprintf(fp, " %s()", func);
+          msg_fprintf(fp, " %s()", func);
         if(msgmode & MSG2_FILELINE)
-          fprintf(fp, " %s %d", bfname, lno);
+          msg_fprintf(fp, " %s %d", bfname, lno);
       }
-      fprintf(fp, ": ");
+      msg_fprintf(fp, ": ");
     } else if(msgmode & MSG2_INDENT1) {
-      fprintf(fp, "%*s", (int) strlen(progname) + 1, "");
+      msg_fprintf(fp, "%*s", (int) strlen(progname) + 1, "");
       bols[bi].bol = 0;
     } else if(msgmode & MSG2_INDENT2) {
-      fprintf(fp, "%*s", (int) strlen(progname) + 2, "");
+      msg_fprintf(fp, "%*s", (int) strlen(progname) + 2, "");
       bols[bi].bol = 0;
     }
     // Figure out whether this print will leave us at beginning of line
@@ -191,9 +257,9 @@ int avrdude_message2(FILE *fp, int lno, const char *file, const char *func,
 
     if(*p) {                    // Finally: print!
       if(bols[bi].bol && (msgmode & MSG2_UCFIRST))
-        fprintf(fp, "%c%s", toupper(*p & 0xff), p + 1);
+        msg_fprintf(fp, "%c%s", toupper(*p & 0xff), p + 1);
       else
-        fprintf(fp, "%s", p);
+        msg_fprintf(fp, "%s", p);
       bols[bi].bol = p[strlen(p) - 1] == '\n';
     }
     mmt_free(p);
@@ -210,7 +276,7 @@ struct list_walk_cookie {
   const char *prefix;
 };
 
-libavrdude_context *cx;         // Context pointer, eventually the only global variable
+AVRDUDE_TLS libavrdude_context *cx; // Context pointer, eventually the only global variable
 
 static LISTID updates = NULL;
 
@@ -220,14 +286,34 @@ static LISTID additional_config_files = NULL;
 
 static PROGRAMMER *pgm;
 
+// Command line settings that each programming session needs
+typedef struct {
+  const char *exitspecs;        // Exit specs string from command line
+  int erase;                    // 1=erase chip, 0=don't
+  int explicit_e;               // 1=explicit -e on command line, 0=not specified there
+  int calibrate;                // 1=calibrate RC oscillator, 0=don't
+  int incremental;              // 1=skip writing flash pages that are unchanged on device
+  int baudrate;                 // Override default programmer baud rate
+  int touch_1200bps;            // Touch serial port prior to programming
+  double bitclock;              // Specify programmer bit clock (JTAG ICE)
+  int ispdelay;                 // Specify the delay for ISP clock
+  int is_dryrun;                // Programmer is dryrun or dryboot
+  int disableffopt;             // Disables trailing 0xff flash optimisation (-A, -D)
+  int gang;                     // Session is one of several running concurrently
+  const char *timing;           // File to append JSON timing statistics to, - is stdout
+  const char *record, *replay;  // Trace files for recording or replaying the serdev exchange
+  enum updateflags uflags;      // Flags for do_op()
+} Session_opts;
+
 // Global options
-int verbose;                    // Verbose output
-int quell_progress;             // Quell progress report and un-verbose output
-int ovsigck;                    // 1 = override sig check, 0 = don't
-const char *partdesc;           // Part -p string
-const char *pgmid;              // Programmer -c string
+AVRDUDE_TLS int verbose;        // Verbose output
+AVRDUDE_TLS int quell_progress; // Quell progress report and un-verbose output
+AVRDUDE_TLS int ovsigck;        // 1 = override sig check, 0 = don't
+AVRDUDE_TLS const char *partdesc; // Part -p string
+AVRDUDE_TLS const char *pgmid;  // Programmer -c string
 
 static char usr_config[PATH_MAX];       // Per-user config file
+static char conf_cache[PATH_MAX];       // Binary cache of parsed config files
 
 // Usage message
 static void usage(void) {
@@ -249,6 +335,7 @@ static void usage(void) {
     "  -C, --config +<config-file>\n"
     "                            Specify additional config file, can be repeated\n"
     "  -N, --noconfig            Do not load %s%s\n"
+    "  --noconfig-cache          Always parse config files, do not use binary cache\n"
     "  -c, --programmer <programmer>\n"
     "                            Specify programmer; -c ? and -c ?type list all\n"
     "  -c, --programmer <wildcard>/<flags>\n"
@@ -261,8 +348,10 @@ static void usage(void) {
     "  -P, --port <port>         Connection; -P ?s or -P ?sa lists serial ones\n"
     "  -r, --reconnect           Reconnect to -P port after \"touching\" it; wait\n"
     "                            400 ms for each -r; needed for some USB boards\n"
+    "  --gang                    Program the part at every -P port concurrently\n"
     "  -F                        Override invalid signature or initial checks\n"
     "  -e, --erase               Perform a chip erase at the beginning\n"
+    "  --incremental             Only write flash pages that differ from the device\n"
     "  -O, --osccal              Perform RC oscillator calibration (see AVR053)\n"
     "  -t, --terminal            Run an interactive terminal when it is its turn\n"
     "  -T <terminal cmd line>    Run terminal line when it is its turn\n"
@@ -271,6 +360,9 @@ static void usage(void) {
     "                            Multiple -t, -T and -U options can be specified\n"
     "  -n, --test-memory         Do not write to the device whilst processing -U\n"
     "  -V, --noverify-memory     Do not automatically verify during -U\n"
+    "  --timing <file>           Append session timing and I/O statistics as JSON\n"
+    "  --record <file>           Record the exchange with the programmer to file\n"
+    "  --replay <file>           Replay a recording instead of using the hardware\n"
     "  -E <exitsp>[,<exitsp>]    List programmer exit specifications\n"
     "  -x <extended_param>       Pass <extended_param> to programmer, see -x help\n"
     "  -v, --verbose             Verbose output; -v -v for more\n"
@@ -677,1244 +769,1685 @@ static char *concatpath(char *dst, char *dir, char *file, size_t n) {
 
   return dst;
 }
+
+// Create the missing parent directories of a file, ignoring errors
+static void mkparentdirs(const char *file) {
+  char *dir = mmt_strdup(file);
+
+  for(char *p = strchr(dir + 1, '/'); p; p = strchr(p + 1, '/')) {
+    *p = 0;
+    mkdir(dir, 0777);
+    *p = '/';
+  }
+  mmt_free(dir);
+}
 #endif
 
 
-int main(int argc, char *argv[]) {
+/*
+ * Now that we know which part we are going to program, locate any -U options
+ * using the default memory region, fill in the device-dependent default
+ * region name ("application" for Xmega parts or "flash" otherwise) and check
+ * for basic problems with memory names or file access with a view to exit
+ * before programming.
+ *
+ * Return -1 if avrdude should exit before programming and 0 otherwise
+ */
+static int check_updates(const AVRPART *p) {
+  int rc, doexit = 0;
+
+  for(LNODEID ln = lfirst(updates); ln; ln = lnext(ln)) {
+    UPDATE *upd = ldata(ln);
+
+    if(upd->memstr == NULL && upd->cmdline == NULL) {
+      const char *mtype = is_pdi(p)? "application": "flash";
+
+      pmsg_notice2("defaulting memstr in -U %c:%s option to \"%s\"\n",
+        (upd->op == DEVICE_READ)? 'r': (upd->op == DEVICE_WRITE)? 'w': 'v', upd->filename, mtype);
+      upd->memstr = mmt_strdup(mtype);
+    }
+    rc = update_dryrun(p, upd);
+    if(rc && rc != LIBAVRDUDE_SOFTFAIL)
+      doexit = 1;
+  }
+
+  return doexit? -1: 0;
+}
+
+#ifdef HAVE_PTHREAD_H
+static pthread_mutex_t gang_lock = PTHREAD_MUTEX_INITIALIZER;
+#define gang_lock() pthread_mutex_lock(&gang_lock)
+#define gang_unlock() pthread_mutex_unlock(&gang_lock)
+#else
+#define gang_lock() do { } while(0)
+#define gang_unlock() do { } while(0)
+#endif
+
+// Append one line of JSON with the timing and I/O statistics of this session to fname
+static void timing_report(const char *fname, const PROGRAMMER *pgm, const AVRPART *p, int exitrc) {
+  FILE *fp = str_eq(fname, "-")? stdout: fopen(fname, "a");
+
+  if(!fp) {
+    pmsg_ext_error("cannot append to timing file %s: %s\n", fname, strerror(errno));
+    return;
+  }
+  gang_lock();
+  avr_stats_json(fp, pgm, p, exitrc);
+  gang_unlock();
+  if(fp != stdout)
+    fclose(fp);
+}
+
+/*
+ * Open the programmer at port, identify the part and carry out the -e, -O
+ * and -U/-T operations of the command line. This is one programming session;
+ * gang programming runs one session per port, each on its own thread.
+ *
+ * Return the exit code for main()
+ */
+static int session(PROGRAMMER *pgm, char *port, const Session_opts *so) {
   int rc;                       // General return code checking
-  int exitrc;                   // Exit code for main()
+  int exitrc = 0;               // Exit code for this session
   int i;                        // General loop counter
-  int ch;                       // Options flag
-  struct avrpart *p;            // Which avr part we are programming
+  AVRPART *p = NULL;            // Which avr part we are programming
+  AVRPART *gp = NULL;           // Part copy owned by this session
   AVRMEM *sig;                  // Signature data
-  struct stat sb;
   UPDATE *upd;
   LNODEID *ln;
 
-  // Options/operating mode variables
-  int erase;                    // 1=erase chip, 0=don't
-  int flashread;                // 1=flash is going to be read, 0=no flash reads
-  int calibrate;                // 1=calibrate RC oscillator, 0=don't
-  int no_avrduderc;             // 1=don't load personal conf file
-  char *port;                   // Device port (/dev/xxx)
-  const char *exitspecs;        // Exit specs string from command line
-  int explicit_c;               // 1=explicit -c on command line, 0=not specified there
-  int explicit_e;               // 1=explicit -e on command line, 0=not specified there
-  char sys_config[PATH_MAX];    // System wide config file
-  char executable_abspath[PATH_MAX];     // Absolute path to avrdude executable
-  char executable_dirpath[PATH_MAX];     // Absolute path to folder with executable
-  bool executable_abspath_found = false; // Absolute path to executable found
-  bool sys_config_found = false;         // avrdude.conf file found
-  char *e;                      // For strtod() error checking
-  const char *errstr;           // For str_int() error checking
-  int baudrate;                 // Override default programmer baud rate
-  int touch_1200bps;            // Touch serial port prior to programming
-  double bitclock;              // Specify programmer bit clock (JTAG ICE)
-  int ispdelay;                 // Specify the delay for ISP clock
-  int init_ok;                  // Device initialization worked well
-  int is_open;                  // Device open succeeded
-  int ce_delayed;               // Chip erase delayed
-  char *logfile;                // Use logfile rather than stderr for diagnostics
-  int showversion;              // Show version and exit
-  enum updateflags uflags = UF_AUTO_ERASE | UF_VERIFY;  // Flags for do_op()
+  const char *exitspecs = so->exitspecs;
+  int erase = so->erase, explicit_e = so->explicit_e, calibrate = so->calibrate;
+  int incremental = so->incremental, is_dryrun = so->is_dryrun;
+  int baudrate = so->baudrate, touch_1200bps = so->touch_1200bps, ispdelay = so->ispdelay;
+  double bitclock = so->bitclock;
+  enum updateflags uflags = so->uflags;
+  int flashread = 0;            // 1=flash is going to be read, 0=no flash reads
+  int init_ok = 0;              // Device initialization worked well
+  int is_open = 0;              // Device open succeeded
+  int ce_delayed = 0;           // Chip erase delayed
 
-  init_cx(NULL);
+  /*
+   * Divide a serialadapter port string into tokens separated by colons.
+   * There are two ways such a port string can be presented:
+   *   1) -P <serialadapter>[:<sernum>]
+   *   2) -P usb:<usbvid>:<usbpid>[:<sernum>]
+   * In either case the serial number is optional. The USB vendor and
+   * product ids are hexadecimal numbers.
+   */
+  bool print_ports = true;
+  SERIALADAPTER *ser = NULL;
 
-#ifdef _MSC_VER
-  _set_printf_count_output(1);
+  if(pgm->conntype == CONNTYPE_SERIAL) {
+    char *portdup = mmt_strdup(port);
+    char *port_tok[4], *tok = portdup;
+
+    for(int t = 0, maxt = str_starts(portdup, DEFAULT_USB ":")? 4: 2; t < 4; t++) {
+      char *save = tok && t < maxt? tok: "";
+
+      if(t < maxt - 1 && tok && (tok = strchr(tok, ':')))
+        *tok++ = 0;
+      port_tok[t] = mmt_strdup(save);
+    }
+    mmt_free(portdup);
+
+    // Use libserialport to find the actual serial port
+    ser = locate_programmer(programmers, port_tok[0]);
+    if(is_serialadapter(ser)) {
+
+#ifdef HAVE_LIBSERIALPORT
+      int rv = setport_from_serialadapter(&port, ser, port_tok[1]);
+
+      if(rv == -1) {
+        pmsg_warning("serial adapter %s", port_tok[0]);
+        if(port_tok[1][0])
+          msg_warning(" with serial number %s", port_tok[1]);
+        else if(ser->usbsn && ser->usbsn[0])
+          msg_warning(" with serial number %s", ser->usbsn);
+        msg_warning(" not connected to host\n");
+      } else if(rv == -2)
+        print_ports = false;
+      if(rv)
+        ser = NULL;
 #endif
+    } else if(str_eq(port_tok[0], DEFAULT_USB)) {
+      // Port or usb:[vid]:[pid]
+      int vid, pid;
 
-  // Set line buffering for file descriptors so we see stdout and stderr properly interleaved
-  setvbuf(stdout, (char *) NULL, _IOLBF, 0);
-  setvbuf(stderr, (char *) NULL, _IOLBF, 0);
+      if(sscanf(port_tok[1], "%x", &vid) > 0 && sscanf(port_tok[2], "%x", &pid) > 0) {
+        int rv = setport_from_vid_pid(&port, vid, pid, port_tok[3]);
 
-  sys_config[0] = '\0';
+        if(rv == -1) {
+          if(port_tok[3][0])
+            pmsg_warning("serial adapter with USB VID %s and PID %s and serial number %s not connected\n", port_tok[1],
+              port_tok[2], port_tok[3]);
+          else
+            pmsg_warning("serial adapter with USB VID %s and PID %s not connected\n", port_tok[1], port_tok[2]);
+        } else if(rv == -2)
+          print_ports = false;
+      }
+    }
+    for(int i = 0; i < 4; i++)
+      mmt_free(port_tok[i]);
+    if(touch_1200bps && touch_serialport(&port, 1200, touch_1200bps) < 0)
+      goto skipopen;
+  }
 
-  progname = strrchr(argv[0], '/');
+  // Open the programmer
+  if(verbose > 0) {
+    if(!is_dryrun)
+      pmsg_notice("using port            : %s\n", port);
+    pmsg_notice("using programmer      : %s\n", pgmid);
+  }
 
-#if defined (WIN32)
-  // Take care of backslash as dir sep in W32
-  if(!progname)
-    progname = strrchr(argv[0], '\\');
-#endif                          // WIN32
+  if(baudrate && !pgm->baudrate && !default_baudrate) { // None set
+    pmsg_notice("setting baud rate     : %d\n", baudrate);
+    pgm->baudrate = baudrate;
+  } else if(baudrate && ((pgm->baudrate && pgm->baudrate != baudrate)
+      || (!pgm->baudrate && default_baudrate != baudrate))) {
+    pmsg_notice("overriding baud rate  : %d\n", baudrate);
+    pgm->baudrate = baudrate;
+  } else if(!pgm->baudrate && default_baudrate) {
+    pmsg_notice("default baud rate     : %d\n", default_baudrate);
+    pgm->baudrate = default_baudrate;
+  } else if(ser && ser->baudrate) {
+    pmsg_notice("serial baud rate      : %d\n", ser->baudrate);
+    pgm->baudrate = ser->baudrate;
+  } else if(pgm->baudrate != 0)
+    pmsg_notice("programmer baud rate  : %d\n", pgm->baudrate);
 
-  if(progname)
-    progname++;
-  else
-    progname = argv[0];
+  if(bitclock != 0.0) {
+    pmsg_notice("setting bit clk period: %.1f us\n", bitclock);
+    pgm->bitclock = bitclock*1e-6;
+  }
 
-  // Remove trailing .exe
-  if(str_ends(progname, ".exe")) {
-    progname = mmt_strdup(progname);    // Don't write to argv[0]
-    progname[strlen(progname) - 4] = 0;
+  if(ispdelay != 0) {
+    pmsg_notice("setting ISP clk delay : %3i us\n", ispdelay);
+    pgm->ispdelay = ispdelay;
   }
 
-  avrdude_conf_version = "";
+  if(so->record && serial_record(so->record) < 0) {
+    exitrc = 1;
+    goto session_exit;
+  }
+  if(so->replay && serial_replay(so->replay) < 0) {
+    exitrc = 1;
+    goto session_exit;
+  }
 
-  default_programmer = "";
-  default_parallel = "";
-  default_serial = "";
-  default_spi = "";
-  default_baudrate = 0;
-  default_bitclock = 0.0;
-  default_linuxgpio = "";
-  allow_subshells = 0;
+  double start = avr_timestamp();
 
-  init_config();
+  rc = pgm->open(pgm, port);
+  avr_phase_end(AVR_PH_OPEN, start);
+  if(rc < 0) {
+    if(rc == LIBAVRDUDE_EXIT) {
+      exitrc = 0;
+      goto session_exit;
+    }
 
-  atexit(cleanup_main);
+    pmsg_error("unable to open port %s for programmer %s\n", port, pgmid);
+  skipopen:
+    if(print_ports && pgm->conntype == CONNTYPE_SERIAL) {
 
-  updates = lcreat(NULL, 0);
-  if(updates == NULL) {
-    pmsg_error("cannot initialize updater list\n");
-    exit(1);
+#ifdef HAVE_LIBSERIALPORT
+      list_available_serialports(programmers);
+      if(touch_1200bps == 1)
+        pmsg_info("alternatively, try -rr or -rrr for longer delays\n");
+#endif
+    }
+    exitrc = 1;
+    pgm->ppidata = 0;           // Clear all bits at exit
+    goto session_exit;
   }
+  is_open = 1;
 
-  extended_params = lcreat(NULL, 0);
-  if(extended_params == NULL) {
-    pmsg_error("cannot initialize extended parameter list\n");
-    exit(1);
+  if(partdesc == NULL) {
+    part_not_found(NULL);
+    exitrc = 1;
+    goto session_exit;
   }
 
-  additional_config_files = lcreat(NULL, 0);
-  if(additional_config_files == NULL) {
-    pmsg_error("cannot initialize additional config files list\n");
-    exit(1);
+  p = locate_part(part_list, partdesc);
+  if(p == NULL) {
+    part_not_found(partdesc);
+    exitrc = 1;
+    goto session_exit;
   }
+  if(so->gang)                  // Concurrent sessions need their own part memories
+    p = gp = avr_dup_part(p);
 
-  partdesc = NULL;
-  port = NULL;
-  erase = 0;
-  flashread = 0;
-  calibrate = 0;
-  no_avrduderc = 0;
-  p = NULL;
-  ovsigck = 0;
-  quell_progress = 0;
-  exitspecs = NULL;
-  pgm = NULL;
-  pgmid = "";
-  explicit_c = 0;
-  explicit_e = 0;
-  verbose = 0;
-  baudrate = 0;
-  touch_1200bps = 0;
-  bitclock = 0.0;
-  ispdelay = 0;
-  is_open = 0;
-  ce_delayed = 0;
-  logfile = NULL;
-  showversion = 0;
+  if(exitspecs != NULL) {
+    if(pgm->parseexitspecs == NULL) {
+      pmsg_warning("-E option not supported by this programmer type\n");
+      exitspecs = NULL;
+    } else {
+      int rc = pgm->parseexitspecs(pgm, exitspecs);
 
-  if(argc == 1) {               // No arguments?
-    usage();
-    return 0;
+      if(rc == LIBAVRDUDE_EXIT) {
+        exitrc = 0;
+        goto session_exit;
+      }
+      if(rc < 0) {
+        pmsg_error("unable to parse list of -E parameters\n");
+        exitrc = 1;
+        goto session_exit;
+      }
+    }
   }
 
-  // Determine the location of personal configuration file
+  if(avr_initmem(p) != 0) {
+    msg_error("\n");
+    pmsg_error("unable to initialize memories\n");
+    exitrc = 1;
+    goto session_exit;
+  }
 
-#if defined(WIN32)
-  win_set_path(usr_config, sizeof usr_config, USER_CONF_FILE);
-#else
-  usr_config[0] = 0;
-  if(!concatpath(usr_config, getenv("XDG_CONFIG_HOME"), XDG_USER_CONF_FILE, sizeof usr_config))
-    concatpath(usr_config, getenv("HOME"), ".config/" XDG_USER_CONF_FILE, sizeof usr_config);
-  if(stat(usr_config, &sb) < 0 || (sb.st_mode & S_IFREG) == 0)
-    concatpath(usr_config, getenv("HOME"), USER_CONF_FILE, sizeof usr_config);
-#endif
+  if(verbose > 0) {
+    if((str_eq(pgm->type, "avr910"))) {
+      imsg_notice("avr910_devcode (avrdude.conf) : ");
+      if(p->avr910_devcode)
+        msg_notice("0x%02x\n", (uint8_t) p->avr910_devcode);
+      else
+        msg_notice("none\n");
+    }
+  }
 
-  // Process command line arguments
-  struct option longopts[] = {
-    {"help",       no_argument,       NULL, '?'},
-    {"baud",       required_argument, NULL, 'b'},
-    {"bitclock",   required_argument, NULL, 'B'},
-    {"programmer", required_argument, NULL, 'c'},
-    {"config",     required_argument, NULL, 'C'},
-    {"noerase",    no_argument,       NULL, 'D'},
-    {"erase",      no_argument,       NULL, 'e'},
-    {"logfile",    required_argument, NULL, 'l'},
-    {"test-memory",no_argument,       NULL, 'n'},
-    {"noconfig",   no_argument,       NULL, 'N'},
-    {"osccal",     no_argument,       NULL, 'O'},
-    {"part",       required_argument, NULL, 'p'},
-    {"port",       required_argument, NULL, 'P'},
-    {"quell",      no_argument,       NULL, 'q'},
-    {"reconnect",  no_argument,       NULL, 'r'},
-    {"terminal",   no_argument,       NULL, 't'},
-    {"memory",     required_argument, NULL, 'U'},
-    {"verbose",    no_argument,       NULL, 'v'},
-    {"noverify-memory",no_argument,   NULL, 'V'},
-    {"version",    no_argument,       &showversion, 0},
-    {NULL,         0,                 NULL, 0}
-  };
+  if(!so->gang && check_updates(p) < 0) { // Gang programming checked them up front
+    exitrc = 1;
+    goto session_exit;
+  }
 
-  int option_idx = 0;
+  if(calibrate) {
+    // Perform an RC oscillator calibration as outlined in appnote AVR053
+    if(pgm->perform_osccal == 0) {
+      pmsg_error("programmer does not support RC oscillator calibration\n");
+      exitrc = 1;
+    } else {
+      pmsg_notice2("performing RC oscillator calibration\n");
+      exitrc = pgm->perform_osccal(pgm);
+    }
+    if(exitrc)
+      pmsg_error("RC calibration unsuccesful\n");
+    else
+      pmsg_notice("calibration value is now stored in EEPROM at address 0\n");
 
-  while((ch = getopt_long(argc, argv,
-			  "?Ab:B:c:C:DeE:Fi:l:nNp:OP:qrtT:U:vVx:",
-			  longopts, &option_idx)) != -1) {
-    switch(ch) {
-    case 'b':                  // Override default programmer baud rate
-      baudrate = str_int(optarg, STR_INT32, &errstr);
-      if(errstr) {
-        pmsg_error("invalid baud rate %s specified: %s\n", optarg, errstr);
-        exit(1);
+    goto session_exit;
+  }
+
+  if(verbose > 0 && quell_progress < 2) {
+    avr_display(stderr, pgm, p, "", verbose);
+    msg_notice2("\n");
+    programmer_display(pgm, "");
+  }
+
+  lmsg_info("");
+
+  exitrc = 0;
+
+  // Enable the programmer
+  pgm->enable(pgm, p);
+
+  // Turn off all the status LEDs and reset LED states
+  led_set(pgm, LED_BEG);
+
+  // Initialize the chip in preparation for accepting commands
+  start = avr_timestamp();
+  init_ok = (rc = pgm->initialize(pgm, p)) >= 0;
+  avr_phase_end(AVR_PH_INIT, start);
+  if(!init_ok) {
+    if(rc == LIBAVRDUDE_EXIT) {
+      exitrc = 0;
+      goto session_exit;
+    }
+    pmsg_error("initialization failed  (rc = %d)\n", rc);
+    if(rc == -2)
+      imsg_error(" - the programmer ISP clock is too fast for the target\n");
+    else
+      imsg_error(" - double check the connections and try again\n");
+
+    if(str_eq(pgm->type, "serialupdi"))
+      imsg_error(" - use -b to set lower baud rate, e.g. -b %d\n", baudrate? baudrate/2: 57600);
+    else if(str_eq(pgm->type, "buspirate_bb") || str_eq(pgm->type, "linuxgpio") ||
+      str_eq(pgm->type, "par") || str_eq(pgm->type, "SERBB")) {
+      imsg_error(" - use -i %sto set a longer delay (in microseconds) between each bit state change, e.g. -i 50\n",
+        bitclock? "instead of -B ": "");
+    }
+    else
+      imsg_error(" - use -B to set lower the bit clock frequency, e.g. -B 125kHz\n");
+
+    if(str_starts(pgm->type, "pickit5"))
+      imsg_error(" - reset the programmer by unplugging it");
+
+    if(!ovsigck) {
+      imsg_error(" - use -F to override this check\n");
+      exitrc = 1;
+      goto session_exit;
+    }
+  }
+
+  // Indicate programmer is ready
+  led_set(pgm, LED_RDY);
+
+  msg_notice("\n");
+  pmsg_notice("AVR device initialized and ready to accept instructions\n");
+
+  /*
+   * Let's read the signature bytes to make sure there is at least a chip on
+   * the other end that is responding correctly.  A check against
+   * 0xffffff/0x000000 should ensure that the signature bytes are valid.
+   */
+  if(!is_awire(p)) {            // Not AVR32
+    int attempt = 0;
+    int waittime = 10000;       // 10 ms
+
+  sig_again:
+    usleep(waittime);
+    if(init_ok) {
+      start = avr_timestamp();
+      rc = avr_signature(pgm, p);
+      avr_phase_end(AVR_PH_SIGNATURE, start);
+      if(rc == LIBAVRDUDE_EXIT) {
+        exitrc = 0;
+        goto session_exit;
       }
-      break;
+      if(rc != LIBAVRDUDE_SUCCESS) {
+        if(rc == LIBAVRDUDE_SOFTFAIL && is_updi(p) && attempt < 1) {
+          attempt++;
+          if(erase) {
+            erase = 0;
+            if(uflags & UF_NOWRITE) {
+              pmsg_warning("conflicting -e and -n options specified, NOT erasing chip\n");
+            } else {
+              pmsg_info("unlocking the chip");
+              exitrc = avr_unlock(pgm, p);
+              if(exitrc)
+                goto session_exit;
+              msg_info(" and trying again\n");
+              goto sig_again;
+            }
+          }
+          if(!ovsigck) {
+            pmsg_error("double check chip or use -F to override this check\n");
+            exitrc = 1;
+            goto session_exit;
+          }
+        }
+        pmsg_error("unable to read signature data (rc = %d)\n", rc);
+        if(!ovsigck) {
+          imsg_error("use -F to override this check\n");
+          exitrc = 1;
+          goto session_exit;
+        }
+      }
+    }
 
-    case 'B':                  // Specify bit clock period
-      bitclock = strtod(optarg, &e);
-      if((e == optarg) || bitclock <= 0.0) {
-        pmsg_error("invalid bit clock period %s\n", optarg);
-        exit(1);
+    sig = avr_locate_signature(p);
+    if(sig == NULL)
+      pmsg_warning("signature memory not defined for device %s\n", p->desc);
+    else {
+      const char *mculist = str_ccmcunames_signature(sig->buf, pgm->prog_modes);
+
+      if(!*mculist) {           // No matching signatures?
+        if(is_updi(p)) {        // UPDI parts have different(!) offsets for signature
+          int k, n = 0;         // Gather list of known different signature offsets
+          unsigned myoff = sig->offset, offlist[10];
+
+          for(LNODEID ln1 = lfirst(part_list); ln1; ln1 = lnext(ln1)) {
+            AVRMEM *m = avr_locate_signature(ldata(ln1));
+
+            if(m && m->offset != myoff) {
+              for(k = 0; k < n; k++)
+                if(m->offset == offlist[k])
+                  break;
+              if(k == n && k < (int) (sizeof offlist/sizeof *offlist))
+                offlist[n++] = m->offset;
+            }
+          }
+          // Now go through the list of other(!) sig offsets and try these
+          for(k = 0; k < n; k++) {
+            sig->offset = offlist[k];
+            if(avr_signature(pgm, p) >= 0)
+              if(*(mculist = str_ccmcunames_signature(sig->buf, pgm->prog_modes)))
+                break;
+          }
+          sig->offset = myoff;
+        }
       }
-      while(*e && isascii(*e & 0xff) && isspace(*e & 0xff))
-        e++;
-      if(*e == 0 || str_caseeq(e, "us"))        // us is optional and the default
-        ;
-      else if(str_caseeq(e, "m") || str_caseeq(e, "mhz"))
-        bitclock = 1/bitclock;
-      else if(str_caseeq(e, "k") || str_caseeq(e, "khz"))
-        bitclock = 1e3/bitclock;
-      else if(str_caseeq(e, "hz"))
-        bitclock = 1e6/bitclock;
-      else {
-        pmsg_error("invalid bit clock unit %s\n", e);
-        exit(1);
+
+      int ff = 1, zz = 1;
+
+      for(i = 0; i < sig->size; i++) {
+        if(sig->buf[i] != 0xff)
+          ff = 0;
+        if(sig->buf[i] != 0x00)
+          zz = 0;
+      }
+      bool signature_matches = sig->size >= 3 && !memcmp(sig->buf, p->signature, 3);
+      int showsig = !signature_matches || ff || zz || verbose > 0;
+
+      if(showsig)
+        pmsg_info("device signature =%s", str_cchex(sig->buf, sig->size, 1));
+      if(*mculist && showsig)
+        msg_info(" (%s)", is_dryrun? p->desc: mculist);
+
+      if(ff || zz) {            // All three bytes are 0xff or all three bytes are 0x00
+        if(++attempt < 3) {
+          waittime *= 5;
+          msg_info(" (retrying)\n");
+          goto sig_again;
+        }
+        msg_info("\n");
+        pmsg_error("invalid device signature\n");
+        if(!ovsigck) {
+          pmsg_error("expected signature for %s is%s\n", p->desc, str_cchex(p->signature, 3, 1));
+          imsg_error("  - double check connections and try again, or use -F to carry on regardless\n");
+          exitrc = 1;
+          goto session_exit;
+        }
+      } else if(showsig) {
+        msg_info("\n");
       }
-      break;
 
-    case 'i':                  // Specify isp clock delay
-      ispdelay = str_int(optarg, STR_INT32, &errstr);
-      if(errstr || ispdelay == 0) {
-        pmsg_error("invalid isp clock delay %s specified", optarg);
-        if(errstr)
-          msg_error(": %s\n", errstr);
-        else
-          msg_error("\n");
-        exit(1);
+      if(!signature_matches) {
+        if(ovsigck) {
+          pmsg_warning("expected signature for %s is%s\n", p->desc, str_cchex(p->signature, 3, 1));
+        } else {
+          pmsg_error("expected signature for %s is%s\n", p->desc, str_cchex(p->signature, 3, 1));
+          imsg_error("  - double check chip or use -F to carry on regardless\n");
+          exitrc = 1;
+          goto session_exit;
+        }
       }
-      break;
+    }
+  }
 
-    case 'c':                  // Programmer id
-      pgmid = optarg;
-      explicit_c = 1;
-      break;
+  if(incremental) {             // Needs to be able to erase unchanged pages individually
+    if(explicit_e)
+      pmsg_warning("-e erases the chip so that --incremental has no effect\n");
+    else if(!(uflags & UF_AUTO_ERASE) || avr_can_page_erase_flash(pgm, p))
+      cx->avr_incremental = 1;
+    else
+      pmsg_warning("-c %s cannot erase individual flash pages of %s; ignoring --incremental\n", pgmid, p->desc);
+  }
 
-    case 'C':                  // System wide configuration file
-      if(optarg[0] == '+') {
-        ladd(additional_config_files, optarg + 1);
-      } else {
-        strncpy(sys_config, optarg, PATH_MAX);
-        sys_config[PATH_MAX - 1] = 0;
+  if(uflags & UF_AUTO_ERASE) {
+    if((p->prog_modes & (PM_PDI | PM_UPDI)) && pgm->page_erase && lsize(updates) > 0) {
+      for(ln = lfirst(updates); ln; ln = lnext(ln)) {
+        upd = ldata(ln);
+        if(upd->memstr && upd->op == DEVICE_WRITE && memlist_contains_flash(upd->memstr, p)) {
+          cx->avr_disableffopt = 1;     // Must write full flash file including trailing 0xff
+          pmsg_notice("NOT erasing chip as page erase will be used for new flash%s contents;\n",
+            avr_locate_bootrow(p)? "/bootrow": "");
+          imsg_notice("unprogrammed flash contents remains: use -e for an explicit chip-erase\n");
+          break;
+        }
       }
-      break;
-
-    case 'D':                  // Disable auto-erase
+    } else {
       uflags &= ~UF_AUTO_ERASE;
-      // Fall through
+      for(ln = lfirst(updates); ln; ln = lnext(ln)) {
+        upd = ldata(ln);
+        if(upd->cmdline && *str_ltrim(upd->cmdline) && str_starts("erase", str_ltrim(upd->cmdline)))
+          break;                // -T erase already erases the chip: no auto-erase needed
 
-    case 'A':                  // Explicit disabling of trailing-0xff removal
-      cx->avr_disableffopt = 1;
-      break;
+        if(upd->cmdline || (upd->memstr &&      // Might be reading flash?
+            (upd->op == DEVICE_READ || upd->op == DEVICE_VERIFY) && memlist_contains_flash(upd->memstr, p)))
+          flashread = 1;
 
-    case 'e':                  // Perform a chip erase
-      erase = 1;
-      explicit_e = 1;
-      uflags &= ~UF_AUTO_ERASE;
-      break;
+        if(upd->memstr && upd->op == DEVICE_WRITE && memlist_contains_flash(upd->memstr, p)) {
+          if(flashread) {
+            pmsg_info("NOT auto-erasing chip as flash might need reading before writing to it\n");
+          } else if(cx->avr_incremental) {
+            uflags |= UF_AUTO_ERASE;    // Page erase changed pages before writing them
+            pmsg_notice("NOT auto-erasing chip as --incremental only writes changed flash pages\n");
+          } else {
+            erase = 1;
+            pmsg_notice("auto-erasing chip as flash memory needs programming (-U %s:w:...)\n", upd->memstr);
+            imsg_notice("specify the -D option to disable this feature\n");
+          }
+          break;
+        }
+      }
+    }
+  }
 
-    case 'E':
-      exitspecs = optarg;
-      break;
+  if(init_ok && erase) {
+    /*
+     * Erase the chip's flash and eeprom memories, this is required before the
+     * chip can accept new programming
+     */
+    if(uflags & UF_NOWRITE) {
+      if(explicit_e)
+        pmsg_warning("conflicting -e and -n specified, NOT erasing chip\n");
+      else
+        pmsg_notice("-n specified, NOT erasing chip\n");
+    } else {
+      start = avr_timestamp();
+      exitrc = avr_chip_erase(pgm, p);
+      avr_phase_end(AVR_PH_ERASE, start);
+      if(exitrc == LIBAVRDUDE_SOFTFAIL) {
+        pmsg_notice("delaying chip erase until first -U upload to flash\n");
+        ce_delayed = 1;
+        exitrc = 0;
+      } else if(exitrc) {
+        pmsg_error("chip erase failed\n");
+        goto session_exit;
+      } else
+        pmsg_notice("erased chip\n");
+    }
+  }
 
-    case 'F':                  // Override invalid signature check
-      ovsigck = 1;
-      break;
+  if(!init_ok && !ovsigck) {    // Bail out on failed initialisation unless -F was given
+    exitrc = 1;
+    goto session_exit;
+  }
 
-    case 'l':
-      logfile = optarg;
-      break;
+  int wrmem = 0, terminal = 0;
 
-    case 'n':
-      uflags |= UF_NOWRITE;
-      break;
+  if(lsize(updates) <= 1)
+    uflags |= UF_NOHEADING;
+  for(ln = lfirst(updates); ln; ln = lnext(ln)) {
+    const AVRMEM *m;
 
-    case 'N':
-      no_avrduderc = 1;
+    upd = ldata(ln);
+    if(upd->cmdline && wrmem) { // Invalidate cache if device was written to
+      wrmem = 0;
+      pgm->reset_cache(pgm, p);
+    } else if(!upd->cmdline) {  // Flush cache before any device memory access
+      pgm->flush_cache(pgm, p);
+      wrmem |= upd->op == DEVICE_WRITE;
+    }
+    if((uflags & UF_NOWRITE) && upd->cmdline && !terminal++)
+      pmsg_warning("the terminal ignores option -n, that is, it writes to the device\n");
+    rc = do_op(pgm, p, upd, uflags);
+    if(rc && rc != LIBAVRDUDE_SOFTFAIL) {
+      exitrc = 1;
       break;
+    } else if(rc == 0 && upd->op == DEVICE_WRITE && (m = avr_locate_mem(p, upd->memstr)) && mem_is_in_flash(m))
+      ce_delayed = 0;           // Redeemed chip erase promise
+  }
+  pgm->flush_cache(pgm, p);
 
-    case 'O':                  // Perform RC oscillator calibration
-      calibrate = 1;
-      break;
+  if(pgm->end_programming)
+    if(pgm->end_programming(pgm, p) < 0)
+      pmsg_error("could not end programming, aborting\n");
 
-    case 'p':                  // Specify AVR part
-      partdesc = optarg;
-      break;
+session_exit:
 
-    case 'P':
-      port = mmt_strdup(optarg);
-      break;
+  // Program complete
+  if(is_open) {
+    // Clear rdy LED and summarise interaction in err, pgm and vfy LEDs
+    led_set(pgm, LED_END);
+    pgm->powerdown(pgm);
+    pgm->disable(pgm);
+    pgm->close(pgm);
+  }
 
-    case 'q':                  // Quell progress output
-      quell_progress++;
-      break;
+  if(cx->usb_access_error) {
+    pmsg_info("\nUSB access errors detected; this could have many reasons; if it is\n"
+      "USB permission problems, avrdude is likely to work when run as root\n"
+      "but this is not good practice; instead you might want to\n");
 
-    case 'r':
-      touch_1200bps++;
-      break;
+#if 0 && !defined(WIN32)
+    DIR *dir;
 
-    case 't':                  // Enter terminal mode
-      ladd(updates, cmd_update("interactive terminal"));
-      break;
+    if((dir = opendir("/etc/udev/rules.d"))) {  // Linux udev land
+      closedir(dir);
+      imsg_info("run the command below to show udev rules recitifying USB access\n" "$ %s -c %s/u\n", progname, pgmid);
+    } else
+#endif
 
-    case 'T':
-      ladd(updates, cmd_update(optarg));
-      break;
+      imsg_info("check out USB port permissions on your OS and set them correctly\n");
+  }
 
-    case 'U':
-      upd = parse_op(optarg);
-      if(upd == NULL) {
-        pmsg_error("unable to parse update operation %s\n", optarg);
-        exit(1);
-      }
-      ladd(updates, upd);
-      break;
+  if(serial_traced && serial_trace_end() < 0 && so->replay && !exitrc)
+    exitrc = 1;                 // Replay did not follow the recording
 
-    case 'v':
-      verbose++;
-      break;
+  if(so->timing)
+    timing_report(so->timing, pgm, p, ce_delayed? 1: exitrc);
 
-    case 'V':
-      uflags &= ~UF_VERIFY;
-      break;
+  if(gp)
+    avr_free_part(gp);
 
-    case 'x':
-      ladd(extended_params, optarg);
-      break;
+  return ce_delayed? 1: exitrc;
+}
 
-    case 0:
-      if(longopts[option_idx].flag)
-        *longopts[option_idx].flag = 1;
-      break;
+/*
+ * Gang programming: the same -c/-p/-U set for several -P ports, each port
+ * programmed by its own session on its own thread. The config files and the
+ * input files are parsed once; input images are shared via fileio_share().
+ */
+typedef struct {
+  PROGRAMMER *pgm;              // Own programmer instance of this target
+  char *port;                   // Port as given on the command line
+  const Session_opts *so;
+  int verbose, quell_progress, ovsigck; // Settings of the main thread
+  const char *partdesc, *pgmid;
+  // Below are shared with the main thread under gang_lock
+  char phase[32];               // Header of last progress report, eg, Writing
+  int percent;                  // Progress of current phase
+  int done, exitrc;             // Session finished with exit code exitrc
+} Gang_target;
+
+static AVRDUDE_TLS Gang_target *gang_self; // Target of the session on this thread
+
+// Record progress so the main thread can summarise it
+static void gang_progress(int percent, double etime, const char *hdr, int finish) {
+  Gang_target *t = gang_self;
+
+  gang_lock();
+  if(hdr)
+    snprintf(t->phase, sizeof t->phase, "%s", str_ltrim(hdr));
+  t->percent = percent;
+  gang_unlock();
+}
 
-    case '?':                  // Help
-      usage();
-      exit(0);
-      break;
+// Each programmer instance needs its own r/w caches
+static PROGRAMMER *gang_pgm_dup(const PROGRAMMER *src) {
+  PROGRAMMER *pgm = pgm_dup(src);
 
-    default:
-      pmsg_error("invalid option -%c\n\n", ch);
-      usage();
-      exit(1);
-      break;
-    }
-  }
+  pgm->cp_flash = mmt_malloc(sizeof(AVR_Cache));
+  pgm->cp_eeprom = mmt_malloc(sizeof(AVR_Cache));
+  pgm->cp_bootrow = mmt_malloc(sizeof(AVR_Cache));
+  pgm->cp_usersig = mmt_malloc(sizeof(AVR_Cache));
 
-  if(showversion) {
-    printf(
-      "%c%s version %s\n"
-      "Copyright see https://github.com/avrdudes/avrdude/blob/main/AUTHORS\n"
-      "Use https://github.com/avrdudes/avrdude/issues to report bugs and ask questions\n",
-      toupper(*progname), *progname? progname+1: "", AVRDUDE_FULL_VERSION
-    );
-    exit(0);
-  }
+  return pgm;
+}
 
-  if(logfile != NULL) {
-    FILE *newstderr = freopen(logfile, "w", stderr);
+static void *gang_worker(void *arg) {
+  Gang_target *t = arg;
+
+  // Only needed when running on the main thread, but harmless otherwise
+  libavrdude_context *cx_main = cx;
+  FP_UpdateProgress progress_main = update_progress;
+  const char *prefix_main = msg_prefix;
+
+  cx = NULL;
+  init_cx(t->pgm);
+  cx->avr_disableffopt = t->so->disableffopt;
+  verbose = t->verbose;
+  quell_progress = t->quell_progress;
+  ovsigck = t->ovsigck;
+  partdesc = t->partdesc;
+  pgmid = t->pgmid;
+  msg_prefix = t->port;
+  gang_self = t;
+
+#ifdef HAVE_PTHREAD_H
+  if(progress_main)             // As single sessions, none with -q
+    update_progress = gang_progress;
+#endif
 
-    if(newstderr == NULL) {
-      // Help!  There's no stderr to complain to anymore now
-      printf("Cannot create logfile %s: %s\n", logfile, strerror(errno));
-      return 1;
-    }
-  }
+  int rc = session(t->pgm, t->port, t->so);
 
-  msg_debug("$ ");              // Record command line
-  for(int i = 0; i < argc; i++)
-    msg_debug("%s%c", str_ccsharg(argv[i]), i == argc - 1? '\n': ' ');
+  msg_flush_line();
 
-  size_t ztest;
+  gang_lock();
+  t->exitrc = rc;
+  t->done = 1;
+  gang_unlock();
 
-  if(1 != sscanf("42", "%zi", &ztest) || ztest != 42)
-    pmsg_warning("linked C library does not conform to C99; %s may not work as expected\n", progname);
+  mmt_free(cx);
+  cx = cx_main;
+  update_progress = progress_main;
+  msg_prefix = prefix_main;
+
+  return NULL;
+}
+
+/*
+ * Program all n targets concurrently; pgms[] are initialised programmer
+ * instances, one per port in ports[]
+ *
+ * Return the exit code for main()
+ */
+static int gang_program(PROGRAMMER **pgms, char **ports, int n, const Session_opts *so) {
+  AVRPART *lp = partdesc? locate_part(part_list, partdesc): NULL;
 
-  // Search for system configuration file unless -C conffile was given
-  if(strlen(sys_config) == 0) {
-    /*
-     * Executable abspath: Determine the absolute path to avrdude executable.
-     * This will be used to locate the avrdude.conf file later.
-     */
-    int executable_dirpath_len;
-    int executable_abspath_len = wai_getExecutablePath(executable_abspath,
-      PATH_MAX,
-      &executable_dirpath_len);
+  if(!lp) {
+    part_not_found(partdesc);
+    return 1;
+  }
 
-    if(
-      (executable_abspath_len != -1) &&
-      (executable_abspath_len != 0) && (executable_dirpath_len != -1) && (executable_dirpath_len != 0)
-      ) {
-      // All requirements satisfied, executable path was found
-      executable_abspath_found = true;
+  // Check -U options and decode input files once for all targets
+  AVRPART *sp = avr_dup_part(lp);
+  int rc = 0;
 
-      // Make sure the string is null terminated
-      executable_abspath[executable_abspath_len] = '\0';
+  avr_initmem(sp);
+  if(check_updates(sp) < 0)
+    rc = -1;
+  for(LNODEID ln = lfirst(updates); rc == 0 && ln; ln = lnext(ln))
+    rc = update_share_input(sp, ldata(ln));
+  avr_free_part(sp);
+  if(rc < 0)
+    return 1;
+
+  Gang_target *gt = mmt_malloc(n*sizeof *gt);
+  int len, wport = 0, nfail = 0;
+
+  for(int k = 0; k < n; k++) {
+    gt[k] = (Gang_target) {
+      .pgm = pgms[k], .port = ports[k], .so = so,
+      .verbose = verbose, .quell_progress = quell_progress, .ovsigck = ovsigck,
+      .partdesc = partdesc, .pgmid = pgmid,
+    };
+    if((len = strlen(ports[k])) > wport)
+      wport = len;
+  }
+  pmsg_info("gang programming %d %s targets\n", n, partdesc);
+
+#ifdef HAVE_PTHREAD_H
+  pthread_t *tid = mmt_malloc(n*sizeof *tid);
+  int *started = mmt_malloc(n*sizeof *started);
+
+  for(int k = 0; k < n; k++) {
+    if((rc = pthread_create(tid + k, NULL, gang_worker, gt + k))) {
+      pmsg_ext_error("cannot create thread for %s: %s\n", ports[k], strerror(rc));
+      gt[k].exitrc = 1;
+      gt[k].done = 1;
+    } else
+      started[k] = 1;
+  }
 
-      replace_backslashes(executable_abspath);
+  // Summarise progress about once a second until all sessions are done
+  char *last = mmt_strdup("");
+  uint64_t lastprint = avr_mstimestamp();
 
-      // Define executable_dirpath to be the path to the parent folder of the executable
-      strcpy(executable_dirpath, executable_abspath);
-      executable_dirpath[executable_dirpath_len] = '\0';
+  for(int ndone = 0; ndone < n; ) {
+    char *line = mmt_strdup("");
 
-      // Debug output
-      msg_trace2("executable_abspath = %s\n", executable_abspath);
-      msg_trace2("executable_abspath_len = %i\n", executable_abspath_len);
-      msg_trace2("executable_dirpath = %s\n", executable_dirpath);
-      msg_trace2("executable_dirpath_len = %i\n", executable_dirpath_len);
-    }
+    usleep(100*1000);
+    gang_lock();
+    ndone = 0;
+    for(int k = 0; k < n; k++) {
+      char *tmp = line;
 
-    /*
-     * System config
-     * -------------
-     * Determine the location of avrdude.conf. Check in this order:
-     *  1. <dirpath of executable>/../etc/avrdude.conf
-     *  2. <dirpath of executable>/avrdude.conf
-     *  3. CONFIG_DIR/avrdude.conf
-     *
-     * When found, write the result into the 'sys_config' variable.
-     */
-    if(executable_abspath_found) {
-      // 1. Check <dirpath of executable>/../etc/avrdude.conf
-      strcpy(sys_config, executable_dirpath);
-      sys_config[PATH_MAX - 1] = '\0';
-      i = strlen(sys_config);
-      if(i && (sys_config[i - 1] != '/'))
-        strcat(sys_config, "/");
-      strcat(sys_config, "../etc/" SYSTEM_CONF_FILE);
-      sys_config[PATH_MAX - 1] = '\0';
-      if(access(sys_config, F_OK) == 0) {
-        sys_config_found = true;
-      } else {
-        // 2. Check <dirpath of executable>/avrdude.conf
-        strcpy(sys_config, executable_dirpath);
-        sys_config[PATH_MAX - 1] = '\0';
-        i = strlen(sys_config);
-        if(i && (sys_config[i - 1] != '/'))
-          strcat(sys_config, "/");
-        strcat(sys_config, SYSTEM_CONF_FILE);
-        sys_config[PATH_MAX - 1] = '\0';
-        if(access(sys_config, F_OK) == 0) {
-          sys_config_found = true;
-        }
+      if(gt[k].done)
+        ndone++;
+      else if(*gt[k].phase) {
+        line = str_sprintf("%s, %s %s %d%%", tmp, gt[k].port, gt[k].phase, gt[k].percent);
+        mmt_free(tmp);
       }
     }
-    if(!sys_config_found) {
-      // 3. Check CONFIG_DIR/avrdude.conf
+    gang_unlock();
+    if(ndone < n && !quell_progress && !str_eq(line, last) && avr_mstimestamp() - lastprint >= 1000) {
+      pmsg_info("%d of %d done%s\n", ndone, n, line);
+      lastprint = avr_mstimestamp();
+    }
+    mmt_free(last);
+    last = line;
+  }
+  mmt_free(last);
 
-#if defined(WIN32)
-      win_set_path(sys_config, sizeof sys_config, SYSTEM_CONF_FILE);
+  for(int k = 0; k < n; k++)
+    if(started[k])
+      pthread_join(tid[k], NULL);
+  mmt_free(started);
+  mmt_free(tid);
 #else
-      strcpy(sys_config, CONFIG_DIR);
-      i = strlen(sys_config);
-      if(i && (sys_config[i - 1] != '/'))
-        strcat(sys_config, "/");
-      strcat(sys_config, SYSTEM_CONF_FILE);
+  pmsg_notice("no thread support: programming targets one after the other\n");
+  for(int k = 0; k < n; k++)
+    gang_worker(gt + k);
 #endif
 
-      if(access(sys_config, F_OK) == 0) {
-        sys_config_found = true;
-      }
-    }
-  }
-  // Debug output
-  msg_trace2("sys_config = %s\n", sys_config);
-  msg_trace2("sys_config_found = %s\n", sys_config_found? "true": "false");
-  msg_trace2("\n");
+  lmsg_info("");
+  for(int k = 0; k < n; k++) {
+    if(gt[k].exitrc)
+      nfail++;
+    if(k && pgms[k]->teardown)  // First programmer is torn down by exithook()
+      pgms[k]->teardown(pgms[k]);
+  }
+  pmsg_info("%d of %d target%s programmed successfully\n", n - nfail, n, str_plural(n));
+  for(int k = 0; k < n; k++)
+    imsg_info("%-*s %s\n", wport, gt[k].port, gt[k].exitrc? "failed": "ok");
+  mmt_free(gt);
+
+  return nfail? 1: 0;
+}
 
-  if(quell_progress == 0)
-    terminal_setup_update_progress();
+int main(int argc, char *argv[]) {
+  int rc;                       // General return code checking
+  int exitrc;                   // Exit code for main()
+  int i;                        // General loop counter
+  int ch;                       // Options flag
+  struct avrpart *p;            // Which avr part we are programming
+  struct stat sb;
+  UPDATE *upd;
 
-  // Print out an identifying string so folks can tell what version they are running
-  pmsg_notice("%s version %s\n", progname, AVRDUDE_FULL_VERSION);
-  pmsg_notice("Copyright see https://github.com/avrdudes/avrdude/blob/main/AUTHORS\n\n");
+  // Options/operating mode variables
+  int erase;                    // 1=erase chip, 0=don't
+  int calibrate;                // 1=calibrate RC oscillator, 0=don't
+  int no_avrduderc;             // 1=don't load personal conf file
+  char *port;                   // Device port (/dev/xxx)
+  const char *exitspecs;        // Exit specs string from command line
+  int explicit_c;               // 1=explicit -c on command line, 0=not specified there
+  int explicit_e;               // 1=explicit -e on command line, 0=not specified there
+  char sys_config[PATH_MAX];    // System wide config file
+  char executable_abspath[PATH_MAX];     // Absolute path to avrdude executable
+  char executable_dirpath[PATH_MAX];     // Absolute path to folder with executable
+  bool executable_abspath_found = false; // Absolute path to executable found
+  bool sys_config_found = false;         // avrdude.conf file found
+  char *e;                      // For strtod() error checking
+  const char *errstr;           // For str_int() error checking
+  int baudrate;                 // Override default programmer baud rate
+  int touch_1200bps;            // Touch serial port prior to programming
+  double bitclock;              // Specify programmer bit clock (JTAG ICE)
+  int ispdelay;                 // Specify the delay for ISP clock
+  char *logfile;                // Use logfile rather than stderr for diagnostics
+  int showversion;              // Show version and exit
+  int noconfcache;              // 1=parse config files even if cache is valid
+  int incremental;              // 1=skip writing flash pages that are unchanged on device
+  int gang;                     // 1=program all -P ports concurrently
+  LISTID ports;                 // All -P ports in order of the command line
+  const char *timing;           // --timing file for JSON statistics
+  const char *record, *replay;  // --record and --replay trace files
+  int confcached;               // Config was restored from the binary cache
+  enum updateflags uflags = UF_AUTO_ERASE | UF_VERIFY;  // Flags for do_op()
 
-  if(*sys_config) {
-    char *real_sys_config = realpath(sys_config, NULL);
+  init_cx(NULL);
 
-    if(real_sys_config) {
-      pmsg_notice("system wide configuration file is %s\n", real_sys_config);
-    } else
-      pmsg_warning("cannot determine realpath() of config file %s: %s\n", sys_config, strerror(errno));
+#ifdef _MSC_VER
+  _set_printf_count_output(1);
+#endif
 
-    rc = read_config(real_sys_config);
-    if(rc) {
-      pmsg_error("unable to process system wide configuration file %s\n", real_sys_config);
-      exit(1);
-    }
-    mmt_free(real_sys_config);
-  }
+  // Set line buffering for file descriptors so we see stdout and stderr properly interleaved
+  setvbuf(stdout, (char *) NULL, _IOLBF, 0);
+  setvbuf(stderr, (char *) NULL, _IOLBF, 0);
 
-  if(usr_config[0] != 0 && !no_avrduderc) {
-    int ok = (rc = stat(usr_config, &sb)) >= 0 && (sb.st_mode & S_IFREG);
+  sys_config[0] = '\0';
 
-    pmsg_notice("user configuration file %s%s%s\n", ok? "is ": "", usr_config,
-      rc < 0? " does not exist": !(sb.st_mode & S_IFREG)? " is not a regular file, skipping": "");
+  progname = strrchr(argv[0], '/');
 
-    if(ok) {
-      rc = read_config(usr_config);
-      if(rc) {
-        pmsg_error("unable to process user configuration file %s\n", usr_config);
-        exit(1);
-      }
-    }
-  }
+#if defined (WIN32)
+  // Take care of backslash as dir sep in W32
+  if(!progname)
+    progname = strrchr(argv[0], '\\');
+#endif                          // WIN32
 
-  if(!str_eq(avrdude_conf_version, AVRDUDE_FULL_VERSION)) {
-    pmsg_warning("system wide configuration file version (%s)\n", avrdude_conf_version);
-    imsg_warning("does not match Avrdude build version (%s)\n", AVRDUDE_FULL_VERSION);
+  if(progname)
+    progname++;
+  else
+    progname = argv[0];
+
+  // Remove trailing .exe
+  if(str_ends(progname, ".exe")) {
+    progname = mmt_strdup(progname);    // Don't write to argv[0]
+    progname[strlen(progname) - 4] = 0;
   }
 
-  if(lsize(additional_config_files) > 0) {
-    LNODEID ln1;
-    const char *p = NULL;
+  avrdude_conf_version = "";
 
-    for(ln1 = lfirst(additional_config_files); ln1; ln1 = lnext(ln1)) {
-      p = ldata(ln1);
-      pmsg_notice("additional configuration file is %s\n", p);
+  default_programmer = "";
+  default_parallel = "";
+  default_serial = "";
+  default_spi = "";
+  default_baudrate = 0;
+  default_bitclock = 0.0;
+  default_linuxgpio = "";
+  allow_subshells = 0;
 
-      rc = read_config(p);
-      if(rc) {
-        pmsg_error("unable to process additional configuration file %s\n", p);
-        exit(1);
-      }
-    }
-  }
+  init_config();
 
-  // Sort memories of all parts in canonical order
-  for(LNODEID ln1 = lfirst(part_list); ln1; ln1 = lnext(ln1))
-    if((p = ldata(ln1))->mem)
-      lsort(p->mem, avr_mem_cmp);
+  atexit(cleanup_main);
 
-  // Set bitclock from configuration files unless changed by command line
-  if(default_bitclock > 0 && bitclock == 0.0) {
-    bitclock = default_bitclock;
+  updates = lcreat(NULL, 0);
+  if(updates == NULL) {
+    pmsg_error("cannot initialize updater list\n");
+    exit(1);
   }
 
-  if(!(pgmid && *pgmid) && *default_programmer)
-    pgmid = cache_string(default_programmer);
+  extended_params = lcreat(NULL, 0);
+  if(extended_params == NULL) {
+    pmsg_error("cannot initialize extended parameter list\n");
+    exit(1);
+  }
 
-  // Developer options to print parts and/or programmer entries of avrdude.conf
-  int dev_opt_c = dev_opt(pgmid);       // -c <wildcard>/[duASsrtiBUPTIJWHQ]
-  int dev_opt_p = dev_opt(partdesc);    // -p <wildcard>/[cdoASsrw*tiBUPTIJWHQ]
+  additional_config_files = lcreat(NULL, 0);
+  if(additional_config_files == NULL) {
+    pmsg_error("cannot initialize additional config files list\n");
+    exit(1);
+  }
 
-  if(dev_opt_c || dev_opt_p) {  // See -c/h and or -p/h
-    dev_output_pgm_part(dev_opt_c, pgmid, dev_opt_p, partdesc);
-    exit(0);
+  partdesc = NULL;
+  port = NULL;
+  erase = 0;
+  calibrate = 0;
+  no_avrduderc = 0;
+  p = NULL;
+  ovsigck = 0;
+  quell_progress = 0;
+  exitspecs = NULL;
+  pgm = NULL;
+  pgmid = "";
+  explicit_c = 0;
+  explicit_e = 0;
+  verbose = 0;
+  baudrate = 0;
+  touch_1200bps = 0;
+  bitclock = 0.0;
+  ispdelay = 0;
+  logfile = NULL;
+  showversion = 0;
+  noconfcache = 0;
+  timing = NULL;
+  record = replay = NULL;
+  confcached = 0;
+  incremental = 0;
+  gang = 0;
+  ports = lcreat(NULL, 0);
+
+  if(argc == 1) {               // No arguments?
+    usage();
+    return 0;
   }
 
-  PROGRAMMER *dry = locate_programmer(programmers, "dryrun");
+  // Determine the location of personal configuration file
+
+#if defined(WIN32)
+  win_set_path(usr_config, sizeof usr_config, USER_CONF_FILE);
+#else
+  usr_config[0] = 0;
+  if(!concatpath(usr_config, getenv("XDG_CONFIG_HOME"), XDG_USER_CONF_FILE, sizeof usr_config))
+    concatpath(usr_config, getenv("HOME"), ".config/" XDG_USER_CONF_FILE, sizeof usr_config);
+  if(stat(usr_config, &sb) < 0 || (sb.st_mode & S_IFREG) == 0)
+    concatpath(usr_config, getenv("HOME"), USER_CONF_FILE, sizeof usr_config);
+
+  // Binary cache of the parsed config files
+  conf_cache[0] = 0;
+  if(!concatpath(conf_cache, getenv("XDG_CACHE_HOME"), XDG_CONF_CACHE_FILE, sizeof conf_cache))
+    concatpath(conf_cache, getenv("HOME"), ".cache/" XDG_CONF_CACHE_FILE, sizeof conf_cache);
+#endif
 
-  for(LNODEID ln1 = lfirst(part_list); ln1; ln1 = lnext(ln1)) {
-    AVRPART *p = ldata(ln1);
+  // Process command line arguments
+  struct option longopts[] = {
+    {"help",       no_argument,       NULL, '?'},
+    {"baud",       required_argument, NULL, 'b'},
+    {"bitclock",   required_argument, NULL, 'B'},
+    {"programmer", required_argument, NULL, 'c'},
+    {"config",     required_argument, NULL, 'C'},
+    {"noerase",    no_argument,       NULL, 'D'},
+    {"erase",      no_argument,       NULL, 'e'},
+    {"gang",       no_argument,       &gang, 1},
+    {"incremental",no_argument,       &incremental, 1},
+    {"logfile",    required_argument, NULL, 'l'},
+    {"test-memory",no_argument,       NULL, 'n'},
+    {"noconfig",   no_argument,       NULL, 'N'},
+    {"noconfig-cache", no_argument,   &noconfcache, 1},
+    {"osccal",     no_argument,       NULL, 'O'},
+    {"part",       required_argument, NULL, 'p'},
+    {"port",       required_argument, NULL, 'P'},
+    {"quell",      no_argument,       NULL, 'q'},
+    {"reconnect",  no_argument,       NULL, 'r'},
+    {"terminal",   no_argument,       NULL, 't'},
+    {"memory",     required_argument, NULL, 'U'},
+    {"verbose",    no_argument,       NULL, 'v'},
+    {"noverify-memory",no_argument,   NULL, 'V'},
+    {"timing",     required_argument, NULL, 0},
+    {"record",     required_argument, NULL, 0},
+    {"replay",     required_argument, NULL, 0},
+    {"version",    no_argument,       &showversion, 0},
+    {NULL,         0,                 NULL, 0}
+  };
 
-    for(LNODEID ln2 = lfirst(programmers); ln2; ln2 = lnext(ln2)) {
-      PROGRAMMER *pgm = ldata(ln2);
+  int option_idx = 0;
 
-      if(!is_programmer(pgm))
-        continue;
-      const char *pnam = pgm->id? ldata(lfirst(pgm->id)): "???";
-      int pm = pgm->prog_modes & p->prog_modes;
+  while((ch = getopt_long(argc, argv,
+			  "?Ab:B:c:C:DeE:Fi:l:nNp:OP:qrtT:U:vVx:",
+			  longopts, &option_idx)) != -1) {
+    switch(ch) {
+    case 'b':                  // Override default programmer baud rate
+      baudrate = str_int(optarg, STR_INT32, &errstr);
+      if(errstr) {
+        pmsg_error("invalid baud rate %s specified: %s\n", optarg, errstr);
+        exit(1);
+      }
+      break;
 
-      if((pm & (pm - 1)) && !str_eq(pnam, "dryrun") && !(dry && pgm->initpgm == dry->initpgm))
-        pmsg_warning("%s and %s share multiple modes (%s)\n", pnam, p->desc, avr_prog_modes(pm));
-    }
-  }
+    case 'B':                  // Specify bit clock period
+      bitclock = strtod(optarg, &e);
+      if((e == optarg) || bitclock <= 0.0) {
+        pmsg_error("invalid bit clock period %s\n", optarg);
+        exit(1);
+      }
+      while(*e && isascii(*e & 0xff) && isspace(*e & 0xff))
+        e++;
+      if(*e == 0 || str_caseeq(e, "us"))        // us is optional and the default
+        ;
+      else if(str_caseeq(e, "m") || str_caseeq(e, "mhz"))
+        bitclock = 1/bitclock;
+      else if(str_caseeq(e, "k") || str_caseeq(e, "khz"))
+        bitclock = 1e3/bitclock;
+      else if(str_caseeq(e, "hz"))
+        bitclock = 1e6/bitclock;
+      else {
+        pmsg_error("invalid bit clock unit %s\n", e);
+        exit(1);
+      }
+      break;
 
-  if(port) {
-    if(str_eq(port, "?s")) {
-      list_available_serialports(programmers);
-      exit(0);
-    } else if(str_eq(port, "?sa")) {
-      lmsg_error("Valid serial adapters are:\n");
-      list_serialadapters(stderr, "  ", programmers);
-      exit(0);
-    }
-  }
+    case 'i':                  // Specify isp clock delay
+      ispdelay = str_int(optarg, STR_INT32, &errstr);
+      if(errstr || ispdelay == 0) {
+        pmsg_error("invalid isp clock delay %s specified", optarg);
+        if(errstr)
+          msg_error(": %s\n", errstr);
+        else
+          msg_error("\n");
+        exit(1);
+      }
+      break;
 
-  if(partdesc) {
-    if(str_eq(partdesc, "?")) {
-      if(pgmid && *pgmid && explicit_c) {
-        PROGRAMMER *pgm = locate_programmer_starts_set(programmers, pgmid, &pgmid, NULL);
+    case 'c':                  // Programmer id
+      pgmid = optarg;
+      explicit_c = 1;
+      break;
 
-        if(!pgm || !is_programmer(pgm)) {
-          programmer_not_found(pgmid, pgm, NULL);
-          exit(1);
-        }
-        msg_error("\nValid parts for programmer %s are:\n", pgmid);
-        list_parts(stderr, "  ", part_list, pgm->prog_modes);
+    case 'C':                  // System wide configuration file
+      if(optarg[0] == '+') {
+        ladd(additional_config_files, optarg + 1);
       } else {
-        msg_error("\nValid parts are:\n");
-        list_parts(stderr, "  ", part_list, ~0);
+        strncpy(sys_config, optarg, PATH_MAX);
+        sys_config[PATH_MAX - 1] = 0;
       }
-      msg_error("\n");
-      exit(1);
-    }
-  }
+      break;
 
-  if(pgmid) {
-    if(str_eq(pgmid, "?")) {
-      if(partdesc && *partdesc) {
-        AVRPART *p = locate_part(part_list, partdesc);
+    case 'D':                  // Disable auto-erase
+      uflags &= ~UF_AUTO_ERASE;
+      // Fall through
 
-        if(!p) {
-          part_not_found(partdesc);
-          exit(1);
-        }
-        msg_error("\nValid programmers for part %s are:\n", p->desc);
-        list_programmers(stderr, "  ", programmers, p->prog_modes);
-      } else {
-        msg_error("\nValid programmers are:\n");
-        list_programmers(stderr, "  ", programmers, ~0);
-      }
-      msg_error("\n");
-      exit(1);
-    }
+    case 'A':                  // Explicit disabling of trailing-0xff removal
+      cx->avr_disableffopt = 1;
+      break;
 
-    if(str_eq(pgmid, "?type")) {
-      msg_error("\nValid programmer types are:\n");
-      list_programmer_types(stderr, "  ");
-      msg_error("\n");
-      exit(1);
-    }
-  }
+    case 'e':                  // Perform a chip erase
+      erase = 1;
+      explicit_e = 1;
+      uflags &= ~UF_AUTO_ERASE;
+      break;
 
-  msg_notice("\n");
+    case 'E':
+      exitspecs = optarg;
+      break;
 
-  if(!pgmid || !*pgmid) {
-    programmer_not_found(NULL, NULL, NULL);
-    exit(1);
-  }
+    case 'F':                  // Override invalid signature check
+      ovsigck = 1;
+      break;
 
-  p = partdesc && *partdesc? locate_part(part_list, partdesc): NULL;
-  pgm = locate_programmer_starts_set(programmers, pgmid, &pgmid, p);
-  if(pgm == NULL || !is_programmer(pgm)) {
-    programmer_not_found(pgmid, pgm, p);
-    exit(1);
-  }
+    case 'l':
+      logfile = optarg;
+      break;
 
-  if(p && !(p->prog_modes & pgm->prog_modes)) {
-    pmsg_error("-c %s cannot program %s for lack of a common programming mode\n", pgmid, p->desc);
-    if(!ovsigck) {
-      imsg_error("use -F to override this check\n");
-      exit(1);
-    }
-  }
+    case 'n':
+      uflags |= UF_NOWRITE;
+      break;
 
-  if(pgm->initpgm) {
-    pgm->initpgm(pgm);
-  } else {
-    msg_error("\n");
-    pmsg_error("cannot initialize the programmer\n\n");
-    exit(1);
-  }
+    case 'N':
+      no_avrduderc = 1;
+      break;
 
-  if(pgm->setup) {
-    pgm->setup(pgm);
-  }
-  if(pgm->teardown) {
-    atexit(exithook);
-  }
+    case 'O':                  // Perform RC oscillator calibration
+      calibrate = 1;
+      break;
 
-  if(lsize(extended_params) > 0) {
-    if(pgm->parseextparams == NULL) {
-      for(LNODEID ln = lfirst(extended_params); ln; ln = lnext(ln)) {
-        const char *extended_param = ldata(ln);
+    case 'p':                  // Specify AVR part
+      partdesc = optarg;
+      break;
 
-        if(str_eq(extended_param, "help")) {
-          msg_error("%s -c %s extended options:\n", progname, pgmid);
-          msg_error("  -x help  Show this help menu and exit\n");
-          exit(0);
-        } else
-          pmsg_error("programmer does not support extended parameter -x %s, option ignored\n", extended_param);
-      }
-    } else {
-      int rc = pgm->parseextparams(pgm, extended_params);
+    case 'P':                  // Last one counts unless --gang
+      port = mmt_strdup(optarg);
+      ladd(ports, port);
+      break;
 
-      if(rc == LIBAVRDUDE_EXIT)
-        exit(0);
-      if(rc < 0) {
-        pmsg_error("unable to parse list of -x parameters\n");
-        exit(1);
-      }
-    }
-  }
+    case 'q':                  // Quell progress output
+      quell_progress++;
+      break;
 
-  if(port == NULL) {
-    switch(pgm->conntype) {
-    case CONNTYPE_PARALLEL:
-      port = mmt_strdup(default_parallel);
+    case 'r':
+      touch_1200bps++;
       break;
 
-    case CONNTYPE_SERIAL:
-      port = mmt_strdup(default_serial);
+    case 't':                  // Enter terminal mode
+      ladd(updates, cmd_update("interactive terminal"));
+      break;
+
+    case 'T':
+      ladd(updates, cmd_update(optarg));
+      break;
+
+    case 'U':
+      upd = parse_op(optarg);
+      if(upd == NULL) {
+        pmsg_error("unable to parse update operation %s\n", optarg);
+        exit(1);
+      }
+      ladd(updates, upd);
       break;
 
-    case CONNTYPE_USB:
-      port = mmt_strdup(DEFAULT_USB);
+    case 'v':
+      verbose++;
       break;
 
-    case CONNTYPE_SPI:
+    case 'V':
+      uflags &= ~UF_VERIFY;
+      break;
 
-#ifdef HAVE_LINUXSPI
-      port = mmt_strdup(*default_spi? default_spi: "unknown");
-#else
-      port = mmt_strdup("unknown");
-#endif
+    case 'x':
+      ladd(extended_params, optarg);
+      break;
 
+    case 0:
+      if(longopts[option_idx].flag)
+        *longopts[option_idx].flag = 1;
+      else if(str_eq(longopts[option_idx].name, "timing"))
+        timing = optarg;
+      else if(str_eq(longopts[option_idx].name, "record"))
+        record = optarg;
+      else if(str_eq(longopts[option_idx].name, "replay"))
+        replay = optarg;
       break;
 
-    case CONNTYPE_LINUXGPIO:
-      port = mmt_strdup(default_linuxgpio);
+    case '?':                  // Help
+      usage();
+      exit(0);
       break;
 
     default:
-      port = mmt_strdup("unknown");
+      pmsg_error("invalid option -%c\n\n", ch);
+      usage();
+      exit(1);
       break;
-
     }
   }
 
-  int is_dryrun = str_eq(pgm->type, "dryrun") || (dry && pgm->initpgm == dry->initpgm);
-
-  if((port[0] == 0 || str_eq(port, "unknown")) && !is_dryrun) {
-    msg_error("\n");
-    pmsg_error("no port has been specified on the command line or in the config file;\n");
-    imsg_error("specify a port using the -P option and try again\n");
-    exit(1);
+  if(showversion) {
+    printf(
+      "%c%s version %s\n"
+      "Copyright see https://github.com/avrdudes/avrdude/blob/main/AUTHORS\n"
+      "Use https://github.com/avrdudes/avrdude/issues to report bugs and ask questions\n",
+      toupper(*progname), *progname? progname+1: "", AVRDUDE_FULL_VERSION
+    );
+    exit(0);
   }
 
-  /*
-   * Divide a serialadapter port string into tokens separated by colons.
-   * There are two ways such a port string can be presented:
-   *   1) -P <serialadapter>[:<sernum>]
-   *   2) -P usb:<usbvid>:<usbpid>[:<sernum>]
-   * In either case the serial number is optional. The USB vendor and
-   * product ids are hexadecimal numbers.
-   */
-  bool print_ports = true;
-  SERIALADAPTER *ser = NULL;
-
-  if(pgm->conntype == CONNTYPE_SERIAL) {
-    char *portdup = mmt_strdup(port);
-    char *port_tok[4], *tok = portdup;
-
-    for(int t = 0, maxt = str_starts(portdup, DEFAULT_USB ":")? 4: 2; t < 4; t++) {
-      char *save = tok && t < maxt? tok: "";
+  if(logfile != NULL) {
+    FILE *newstderr = freopen(logfile, "w", stderr);
 
-      if(t < maxt - 1 && tok && (tok = strchr(tok, ':')))
-        *tok++ = 0;
-      port_tok[t] = mmt_strdup(save);
+    if(newstderr == NULL) {
+      // Help!  There's no stderr to complain to anymore now
+      printf("Cannot create logfile %s: %s\n", logfile, strerror(errno));
+      return 1;
     }
-    mmt_free(portdup);
+  }
 
-    // Use libserialport to find the actual serial port
-    ser = locate_programmer(programmers, port_tok[0]);
-    if(is_serialadapter(ser)) {
+  msg_debug("$ ");              // Record command line
+  for(int i = 0; i < argc; i++)
+    msg_debug("%s%c", str_ccsharg(argv[i]), i == argc - 1? '\n': ' ');
 
-#ifdef HAVE_LIBSERIALPORT
-      int rv = setport_from_serialadapter(&port, ser, port_tok[1]);
+  size_t ztest;
 
-      if(rv == -1) {
-        pmsg_warning("serial adapter %s", port_tok[0]);
-        if(port_tok[1][0])
-          msg_warning(" with serial number %s", port_tok[1]);
-        else if(ser->usbsn && ser->usbsn[0])
-          msg_warning(" with serial number %s", ser->usbsn);
-        msg_warning(" not connected to host\n");
-      } else if(rv == -2)
-        print_ports = false;
-      if(rv)
-        ser = NULL;
-#endif
-    } else if(str_eq(port_tok[0], DEFAULT_USB)) {
-      // Port or usb:[vid]:[pid]
-      int vid, pid;
+  if(1 != sscanf("42", "%zi", &ztest) || ztest != 42)
+    pmsg_warning("linked C library does not conform to C99; %s may not work as expected\n", progname);
 
-      if(sscanf(port_tok[1], "%x", &vid) > 0 && sscanf(port_tok[2], "%x", &pid) > 0) {
-        int rv = setport_from_vid_pid(&port, vid, pid, port_tok[3]);
+  if(gang) {                    // Sessions run concurrently: no user interaction or output files
+    if(lsize(ports) < 2) {
+      pmsg_warning("--gang needs at least two -P ports; programming a single target\n");
+      gang = 0;
+    }
+    if(calibrate) {
+      pmsg_error("-O cannot be used with --gang\n");
+      exit(1);
+    }
+    if(record || replay) {
+      pmsg_error("--record and --replay cannot be used with --gang\n");
+      exit(1);
+    }
+    for(LNODEID ln1 = lfirst(updates); ln1; ln1 = lnext(ln1)) {
+      UPDATE *upd1 = ldata(ln1);
 
-        if(rv == -1) {
-          if(port_tok[3][0])
-            pmsg_warning("serial adapter with USB VID %s and PID %s and serial number %s not connected\n", port_tok[1],
-              port_tok[2], port_tok[3]);
-          else
-            pmsg_warning("serial adapter with USB VID %s and PID %s not connected\n", port_tok[1], port_tok[2]);
-        } else if(rv == -2)
-          print_ports = false;
+      if(upd1->cmdline) {
+        pmsg_error("-t and -T cannot be used with --gang\n");
+        exit(1);
+      }
+      if(upd1->op == DEVICE_READ) {
+        pmsg_error("-U %s:r:... cannot be used with --gang\n", upd1->memstr? upd1->memstr: "");
+        exit(1);
       }
     }
-    for(int i = 0; i < 4; i++)
-      mmt_free(port_tok[i]);
-    if(touch_1200bps && touch_serialport(&port, 1200, touch_1200bps) < 0)
-      goto skipopen;
-  }
-
-  // Open the programmer
-  if(verbose > 0) {
-    if(!is_dryrun)
-      pmsg_notice("using port            : %s\n", port);
-    pmsg_notice("using programmer      : %s\n", pgmid);
   }
 
-  if(baudrate && !pgm->baudrate && !default_baudrate) { // None set
-    pmsg_notice("setting baud rate     : %d\n", baudrate);
-    pgm->baudrate = baudrate;
-  } else if(baudrate && ((pgm->baudrate && pgm->baudrate != baudrate)
-      || (!pgm->baudrate && default_baudrate != baudrate))) {
-    pmsg_notice("overriding baud rate  : %d\n", baudrate);
-    pgm->baudrate = baudrate;
-  } else if(!pgm->baudrate && default_baudrate) {
-    pmsg_notice("default baud rate     : %d\n", default_baudrate);
-    pgm->baudrate = default_baudrate;
-  } else if(ser && ser->baudrate) {
-    pmsg_notice("serial baud rate      : %d\n", ser->baudrate);
-    pgm->baudrate = ser->baudrate;
-  } else if(pgm->baudrate != 0)
-    pmsg_notice("programmer baud rate  : %d\n", pgm->baudrate);
+  // Search for system configuration file unless -C conffile was given
+  if(strlen(sys_config) == 0) {
+    /*
+     * Executable abspath: Determine the absolute path to avrdude executable.
+     * This will be used to locate the avrdude.conf file later.
+     */
+    int executable_dirpath_len;
+    int executable_abspath_len = wai_getExecutablePath(executable_abspath,
+      PATH_MAX,
+      &executable_dirpath_len);
 
-  if(bitclock != 0.0) {
-    pmsg_notice("setting bit clk period: %.1f us\n", bitclock);
-    pgm->bitclock = bitclock*1e-6;
-  }
+    if(
+      (executable_abspath_len != -1) &&
+      (executable_abspath_len != 0) && (executable_dirpath_len != -1) && (executable_dirpath_len != 0)
+      ) {
+      // All requirements satisfied, executable path was found
+      executable_abspath_found = true;
 
-  if(ispdelay != 0) {
-    pmsg_notice("setting ISP clk delay : %3i us\n", ispdelay);
-    pgm->ispdelay = ispdelay;
-  }
+      // Make sure the string is null terminated
+      executable_abspath[executable_abspath_len] = '\0';
 
-  rc = pgm->open(pgm, port);
-  if(rc < 0) {
-    if(rc == LIBAVRDUDE_EXIT) {
-      exitrc = 0;
-      goto main_exit;
-    }
+      replace_backslashes(executable_abspath);
 
-    pmsg_error("unable to open port %s for programmer %s\n", port, pgmid);
-  skipopen:
-    if(print_ports && pgm->conntype == CONNTYPE_SERIAL) {
+      // Define executable_dirpath to be the path to the parent folder of the executable
+      strcpy(executable_dirpath, executable_abspath);
+      executable_dirpath[executable_dirpath_len] = '\0';
 
-#ifdef HAVE_LIBSERIALPORT
-      list_available_serialports(programmers);
-      if(touch_1200bps == 1)
-        pmsg_info("alternatively, try -rr or -rrr for longer delays\n");
-#endif
+      // Debug output
+      msg_trace2("executable_abspath = %s\n", executable_abspath);
+      msg_trace2("executable_abspath_len = %i\n", executable_abspath_len);
+      msg_trace2("executable_dirpath = %s\n", executable_dirpath);
+      msg_trace2("executable_dirpath_len = %i\n", executable_dirpath_len);
     }
-    exitrc = 1;
-    pgm->ppidata = 0;           // Clear all bits at exit
-    goto main_exit;
-  }
-  is_open = 1;
-
-  if(partdesc == NULL) {
-    part_not_found(NULL);
-    exitrc = 1;
-    goto main_exit;
-  }
 
-  p = locate_part(part_list, partdesc);
-  if(p == NULL) {
-    part_not_found(partdesc);
-    exitrc = 1;
-    goto main_exit;
-  }
+    /*
+     * System config
+     * -------------
+     * Determine the location of avrdude.conf. Check in this order:
+     *  1. <dirpath of executable>/../etc/avrdude.conf
+     *  2. <dirpath of executable>/avrdude.conf
+     *  3. CONFIG_DIR/avrdude.conf
+     *
+     * When found, write the result into the 'sys_config' variable.
+     */
+    if(executable_abspath_found) {
+      // 1. Check <dirpath of executable>/../etc/avrdude.conf
+      strcpy(sys_config, executable_dirpath);
+      sys_config[PATH_MAX - 1] = '\0';
+      i = strlen(sys_config);
+      if(i && (sys_config[i - 1] != '/'))
+        strcat(sys_config, "/");
+      strcat(sys_config, "../etc/" SYSTEM_CONF_FILE);
+      sys_config[PATH_MAX - 1] = '\0';
+      if(access(sys_config, F_OK) == 0) {
+        sys_config_found = true;
+      } else {
+        // 2. Check <dirpath of executable>/avrdude.conf
+        strcpy(sys_config, executable_dirpath);
+        sys_config[PATH_MAX - 1] = '\0';
+        i = strlen(sys_config);
+        if(i && (sys_config[i - 1] != '/'))
+          strcat(sys_config, "/");
+        strcat(sys_config, SYSTEM_CONF_FILE);
+        sys_config[PATH_MAX - 1] = '\0';
+        if(access(sys_config, F_OK) == 0) {
+          sys_config_found = true;
+        }
+      }
+    }
+    if(!sys_config_found) {
+      // 3. Check CONFIG_DIR/avrdude.conf
 
-  if(exitspecs != NULL) {
-    if(pgm->parseexitspecs == NULL) {
-      pmsg_warning("-E option not supported by this programmer type\n");
-      exitspecs = NULL;
-    } else {
-      int rc = pgm->parseexitspecs(pgm, exitspecs);
+#if defined(WIN32)
+      win_set_path(sys_config, sizeof sys_config, SYSTEM_CONF_FILE);
+#else
+      strcpy(sys_config, CONFIG_DIR);
+      i = strlen(sys_config);
+      if(i && (sys_config[i - 1] != '/'))
+        strcat(sys_config, "/");
+      strcat(sys_config, SYSTEM_CONF_FILE);
+#endif
 
-      if(rc == LIBAVRDUDE_EXIT)
-        exit(0);
-      if(rc < 0) {
-        pmsg_error("unable to parse list of -E parameters\n");
-        exit(1);
+      if(access(sys_config, F_OK) == 0) {
+        sys_config_found = true;
       }
     }
   }
+  // Debug output
+  msg_trace2("sys_config = %s\n", sys_config);
+  msg_trace2("sys_config_found = %s\n", sys_config_found? "true": "false");
+  msg_trace2("\n");
 
-  if(avr_initmem(p) != 0) {
-    msg_error("\n");
-    pmsg_error("unable to initialize memories\n");
-    exitrc = 1;
-    goto main_exit;
-  }
+  if(quell_progress == 0)
+    terminal_setup_update_progress();
 
-  if(verbose > 0) {
-    if((str_eq(pgm->type, "avr910"))) {
-      imsg_notice("avr910_devcode (avrdude.conf) : ");
-      if(p->avr910_devcode)
-        msg_notice("0x%02x\n", (uint8_t) p->avr910_devcode);
-      else
-        msg_notice("none\n");
-    }
-  }
+  // Print out an identifying string so folks can tell what version they are running
+  pmsg_notice("%s version %s\n", progname, AVRDUDE_FULL_VERSION);
+  pmsg_notice("Copyright see https://github.com/avrdudes/avrdude/blob/main/AUTHORS\n\n");
 
   /*
-   * Now that we know which part we are going to program, locate any -U options
-   * using the default memory region, fill in the device-dependent default
-   * region name ("application" for Xmega parts or "flash" otherwise) and check
-   * for basic problems with memory names or file access with a view to exit
-   * before programming.
+   * Collect the absolute paths of all config files to be read so that a
+   * valid binary cache of an earlier parse of the same files can be used
+   * instead; developer options for parts and programmers (wildcards or /
+   * flags) print config comments, which are not cached, so parse in that case
    */
-  int doexit = 0;
+  LISTID cfgfiles = NULL;
+
+  if(*conf_cache && !noconfcache && !(partdesc && strpbrk(partdesc, "*/")) && !(pgmid && strpbrk(pgmid, "*/"))) {
+    char *rp;
+    int ok = 1;
+
+    cfgfiles = lcreat(NULL, 0);
+    if(*sys_config)
+      ok = (rp = realpath(sys_config, NULL)) && ladd(cfgfiles, rp) >= 0;
+    if(ok && usr_config[0] != 0 && !no_avrduderc && stat(usr_config, &sb) >= 0 && (sb.st_mode & S_IFREG))
+      ok = (rp = realpath(usr_config, NULL)) && ladd(cfgfiles, rp) >= 0;
+    for(LNODEID ln1 = lfirst(additional_config_files); ok && ln1; ln1 = lnext(ln1))
+      ok = (rp = realpath(ldata(ln1), NULL)) && ladd(cfgfiles, rp) >= 0;
+
+    if(ok && lsize(cfgfiles) > 0)
+      confcached = read_config_cache(conf_cache, cfgfiles) == 0;
+    else {
+      ldestroy_cb(cfgfiles, mmt_f_free);
+      cfgfiles = NULL;
+    }
+  }
 
-  for(ln = lfirst(updates); ln; ln = lnext(ln)) {
-    upd = ldata(ln);
-    if(upd->memstr == NULL && upd->cmdline == NULL) {
-      const char *mtype = is_pdi(p)? "application": "flash";
+  if(*sys_config) {
+    char *real_sys_config = realpath(sys_config, NULL);
 
-      pmsg_notice2("defaulting memstr in -U %c:%s option to \"%s\"\n",
-        (upd->op == DEVICE_READ)? 'r': (upd->op == DEVICE_WRITE)? 'w': 'v', upd->filename, mtype);
-      upd->memstr = mmt_strdup(mtype);
+    if(real_sys_config) {
+      pmsg_notice("system wide configuration file is %s\n", real_sys_config);
+    } else
+      pmsg_warning("cannot determine realpath() of config file %s: %s\n", sys_config, strerror(errno));
+
+    rc = confcached? 0: read_config(real_sys_config);
+    if(rc) {
+      pmsg_error("unable to process system wide configuration file %s\n", real_sys_config);
+      exit(1);
     }
-    rc = update_dryrun(p, upd);
-    if(rc && rc != LIBAVRDUDE_SOFTFAIL)
-      doexit = 1;
-  }
-  if(doexit) {
-    exitrc = 1;
-    goto main_exit;
+    mmt_free(real_sys_config);
   }
 
-  if(calibrate) {
-    // Perform an RC oscillator calibration as outlined in appnote AVR053
-    if(pgm->perform_osccal == 0) {
-      pmsg_error("programmer does not support RC oscillator calibration\n");
-      exitrc = 1;
-    } else {
-      pmsg_notice2("performing RC oscillator calibration\n");
-      exitrc = pgm->perform_osccal(pgm);
-    }
-    if(exitrc)
-      pmsg_error("RC calibration unsuccesful\n");
-    else
-      pmsg_notice("calibration value is now stored in EEPROM at address 0\n");
+  if(usr_config[0] != 0 && !no_avrduderc) {
+    int ok = (rc = stat(usr_config, &sb)) >= 0 && (sb.st_mode & S_IFREG);
 
-    goto main_exit;
-  }
+    pmsg_notice("user configuration file %s%s%s\n", ok? "is ": "", usr_config,
+      rc < 0? " does not exist": !(sb.st_mode & S_IFREG)? " is not a regular file, skipping": "");
 
-  if(verbose > 0 && quell_progress < 2) {
-    avr_display(stderr, pgm, p, "", verbose);
-    msg_notice2("\n");
-    programmer_display(pgm, "");
+    if(ok) {
+      rc = confcached? 0: read_config(usr_config);
+      if(rc) {
+        pmsg_error("unable to process user configuration file %s\n", usr_config);
+        exit(1);
+      }
+    }
   }
 
-  lmsg_info("");
-
-  exitrc = 0;
+  if(!str_eq(avrdude_conf_version, AVRDUDE_FULL_VERSION)) {
+    pmsg_warning("system wide configuration file version (%s)\n", avrdude_conf_version);
+    imsg_warning("does not match Avrdude build version (%s)\n", AVRDUDE_FULL_VERSION);
+  }
 
-  // Enable the programmer
-  pgm->enable(pgm, p);
+  if(lsize(additional_config_files) > 0) {
+    LNODEID ln1;
+    const char *p = NULL;
 
-  // Turn off all the status LEDs and reset LED states
-  led_set(pgm, LED_BEG);
+    for(ln1 = lfirst(additional_config_files); ln1; ln1 = lnext(ln1)) {
+      p = ldata(ln1);
+      pmsg_notice("additional configuration file is %s\n", p);
 
-  // Initialize the chip in preparation for accepting commands
-  init_ok = (rc = pgm->initialize(pgm, p)) >= 0;
-  if(!init_ok) {
-    if(rc == LIBAVRDUDE_EXIT) {
-      exitrc = 0;
-      goto main_exit;
+      rc = confcached? 0: read_config(p);
+      if(rc) {
+        pmsg_error("unable to process additional configuration file %s\n", p);
+        exit(1);
+      }
     }
-    pmsg_error("initialization failed  (rc = %d)\n", rc);
-    if(rc == -2)
-      imsg_error(" - the programmer ISP clock is too fast for the target\n");
-    else
-      imsg_error(" - double check the connections and try again\n");
+  }
 
-    if(str_eq(pgm->type, "serialupdi"))
-      imsg_error(" - use -b to set lower baud rate, e.g. -b %d\n", baudrate? baudrate/2: 57600);
-    else if(str_eq(pgm->type, "buspirate_bb") || str_eq(pgm->type, "linuxgpio") ||
-      str_eq(pgm->type, "par") || str_eq(pgm->type, "SERBB")) {
-      imsg_error(" - use -i %sto set a longer delay (in microseconds) between each bit state change, e.g. -i 50\n",
-        bitclock? "instead of -B ": "");
-    }
-    else
-      imsg_error(" - use -B to set lower the bit clock frequency, e.g. -B 125kHz\n");
+  // Sort memories of all parts in canonical order
+  for(LNODEID ln1 = lfirst(part_list); ln1; ln1 = lnext(ln1))
+    if((p = ldata(ln1))->mem)
+      lsort(p->mem, avr_mem_cmp);
 
-    if(str_starts(pgm->type, "pickit5"))
-      imsg_error(" - reset the programmer by unplugging it");
+  if(cfgfiles) {
+    if(!confcached) {
 
-    if(!ovsigck) {
-      imsg_error(" - use -F to override this check\n");
-      exitrc = 1;
-      goto main_exit;
+#if !defined(WIN32)
+      mkparentdirs(conf_cache);
+#endif
+
+      write_config_cache(conf_cache, cfgfiles);
     }
+    ldestroy_cb(cfgfiles, mmt_f_free);
   }
 
-  // Indicate programmer is ready
-  led_set(pgm, LED_RDY);
+  // Set bitclock from configuration files unless changed by command line
+  if(default_bitclock > 0 && bitclock == 0.0) {
+    bitclock = default_bitclock;
+  }
 
-  msg_notice("\n");
-  pmsg_notice("AVR device initialized and ready to accept instructions\n");
+  if(!(pgmid && *pgmid) && *default_programmer)
+    pgmid = cache_string(default_programmer);
 
-  /*
-   * Let's read the signature bytes to make sure there is at least a chip on
-   * the other end that is responding correctly.  A check against
-   * 0xffffff/0x000000 should ensure that the signature bytes are valid.
-   */
-  if(!is_awire(p)) {            // Not AVR32
-    int attempt = 0;
-    int waittime = 10000;       // 10 ms
+  // Developer options to print parts and/or programmer entries of avrdude.conf
+  int dev_opt_c = dev_opt(pgmid);       // -c <wildcard>/[duASsrtiBUPTIJWHQ]
+  int dev_opt_p = dev_opt(partdesc);    // -p <wildcard>/[cdoASsrw*tiBUPTIJWHQ]
 
-  sig_again:
-    usleep(waittime);
-    if(init_ok) {
-      rc = avr_signature(pgm, p);
-      if(rc == LIBAVRDUDE_EXIT) {
-        exitrc = 0;
-        goto main_exit;
-      }
-      if(rc != LIBAVRDUDE_SUCCESS) {
-        if(rc == LIBAVRDUDE_SOFTFAIL && is_updi(p) && attempt < 1) {
-          attempt++;
-          if(erase) {
-            erase = 0;
-            if(uflags & UF_NOWRITE) {
-              pmsg_warning("conflicting -e and -n options specified, NOT erasing chip\n");
-            } else {
-              pmsg_info("unlocking the chip");
-              exitrc = avr_unlock(pgm, p);
-              if(exitrc)
-                goto main_exit;
-              msg_info(" and trying again\n");
-              goto sig_again;
-            }
-          }
-          if(!ovsigck) {
-            pmsg_error("double check chip or use -F to override this check\n");
-            exitrc = 1;
-            goto main_exit;
-          }
-        }
-        pmsg_error("unable to read signature data (rc = %d)\n", rc);
-        if(!ovsigck) {
-          imsg_error("use -F to override this check\n");
-          exitrc = 1;
-          goto main_exit;
-        }
-      }
-    }
+  if(dev_opt_c || dev_opt_p) {  // See -c/h and or -p/h
+    dev_output_pgm_part(dev_opt_c, pgmid, dev_opt_p, partdesc);
+    exit(0);
+  }
 
-    sig = avr_locate_signature(p);
-    if(sig == NULL)
-      pmsg_warning("signature memory not defined for device %s\n", p->desc);
-    else {
-      const char *mculist = str_ccmcunames_signature(sig->buf, pgm->prog_modes);
+  PROGRAMMER *dry = locate_programmer(programmers, "dryrun");
 
-      if(!*mculist) {           // No matching signatures?
-        if(is_updi(p)) {        // UPDI parts have different(!) offsets for signature
-          int k, n = 0;         // Gather list of known different signature offsets
-          unsigned myoff = sig->offset, offlist[10];
+  for(LNODEID ln1 = lfirst(part_list); ln1; ln1 = lnext(ln1)) {
+    AVRPART *p = ldata(ln1);
 
-          for(LNODEID ln1 = lfirst(part_list); ln1; ln1 = lnext(ln1)) {
-            AVRMEM *m = avr_locate_signature(ldata(ln1));
+    for(LNODEID ln2 = lfirst(programmers); ln2; ln2 = lnext(ln2)) {
+      PROGRAMMER *pgm = ldata(ln2);
 
-            if(m && m->offset != myoff) {
-              for(k = 0; k < n; k++)
-                if(m->offset == offlist[k])
-                  break;
-              if(k == n && k < (int) (sizeof offlist/sizeof *offlist))
-                offlist[n++] = m->offset;
-            }
-          }
-          // Now go through the list of other(!) sig offsets and try these
-          for(k = 0; k < n; k++) {
-            sig->offset = offlist[k];
-            if(avr_signature(pgm, p) >= 0)
-              if(*(mculist = str_ccmcunames_signature(sig->buf, pgm->prog_modes)))
-                break;
-          }
-          sig->offset = myoff;
-        }
-      }
+      if(!is_programmer(pgm))
+        continue;
+      const char *pnam = pgm->id? ldata(lfirst(pgm->id)): "???";
+      int pm = pgm->prog_modes & p->prog_modes;
 
-      int ff = 1, zz = 1;
+      if((pm & (pm - 1)) && !str_eq(pnam, "dryrun") && !(dry && pgm->initpgm == dry->initpgm))
+        pmsg_warning("%s and %s share multiple modes (%s)\n", pnam, p->desc, avr_prog_modes(pm));
+    }
+  }
 
-      for(i = 0; i < sig->size; i++) {
-        if(sig->buf[i] != 0xff)
-          ff = 0;
-        if(sig->buf[i] != 0x00)
-          zz = 0;
-      }
-      bool signature_matches = sig->size >= 3 && !memcmp(sig->buf, p->signature, 3);
-      int showsig = !signature_matches || ff || zz || verbose > 0;
+  if(port) {
+    if(str_eq(port, "?s")) {
+      list_available_serialports(programmers);
+      exit(0);
+    } else if(str_eq(port, "?sa")) {
+      lmsg_error("Valid serial adapters are:\n");
+      list_serialadapters(stderr, "  ", programmers);
+      exit(0);
+    }
+  }
 
-      if(showsig)
-        pmsg_info("device signature =%s", str_cchex(sig->buf, sig->size, 1));
-      if(*mculist && showsig)
-        msg_info(" (%s)", is_dryrun? p->desc: mculist);
+  if(partdesc) {
+    if(str_eq(partdesc, "?")) {
+      if(pgmid && *pgmid && explicit_c) {
+        PROGRAMMER *pgm = locate_programmer_starts_set(programmers, pgmid, &pgmid, NULL);
 
-      if(ff || zz) {            // All three bytes are 0xff or all three bytes are 0x00
-        if(++attempt < 3) {
-          waittime *= 5;
-          msg_info(" (retrying)\n");
-          goto sig_again;
-        }
-        msg_info("\n");
-        pmsg_error("invalid device signature\n");
-        if(!ovsigck) {
-          pmsg_error("expected signature for %s is%s\n", p->desc, str_cchex(p->signature, 3, 1));
-          imsg_error("  - double check connections and try again, or use -F to carry on regardless\n");
-          exitrc = 1;
-          goto main_exit;
+        if(!pgm || !is_programmer(pgm)) {
+          programmer_not_found(pgmid, pgm, NULL);
+          exit(1);
         }
-      } else if(showsig) {
-        msg_info("\n");
+        msg_error("\nValid parts for programmer %s are:\n", pgmid);
+        list_parts(stderr, "  ", part_list, pgm->prog_modes);
+      } else {
+        msg_error("\nValid parts are:\n");
+        list_parts(stderr, "  ", part_list, ~0);
       }
+      msg_error("\n");
+      exit(1);
+    }
+  }
 
-      if(!signature_matches) {
-        if(ovsigck) {
-          pmsg_warning("expected signature for %s is%s\n", p->desc, str_cchex(p->signature, 3, 1));
-        } else {
-          pmsg_error("expected signature for %s is%s\n", p->desc, str_cchex(p->signature, 3, 1));
-          imsg_error("  - double check chip or use -F to carry on regardless\n");
-          exitrc = 1;
-          goto main_exit;
+  if(pgmid) {
+    if(str_eq(pgmid, "?")) {
+      if(partdesc && *partdesc) {
+        AVRPART *p = locate_part(part_list, partdesc);
+
+        if(!p) {
+          part_not_found(partdesc);
+          exit(1);
         }
+        msg_error("\nValid programmers for part %s are:\n", p->desc);
+        list_programmers(stderr, "  ", programmers, p->prog_modes);
+      } else {
+        msg_error("\nValid programmers are:\n");
+        list_programmers(stderr, "  ", programmers, ~0);
       }
+      msg_error("\n");
+      exit(1);
+    }
+
+    if(str_eq(pgmid, "?type")) {
+      msg_error("\nValid programmer types are:\n");
+      list_programmer_types(stderr, "  ");
+      msg_error("\n");
+      exit(1);
     }
   }
 
-  if(uflags & UF_AUTO_ERASE) {
-    if((p->prog_modes & (PM_PDI | PM_UPDI)) && pgm->page_erase && lsize(updates) > 0) {
-      for(ln = lfirst(updates); ln; ln = lnext(ln)) {
-        upd = ldata(ln);
-        if(upd->memstr && upd->op == DEVICE_WRITE && memlist_contains_flash(upd->memstr, p)) {
-          cx->avr_disableffopt = 1;     // Must write full flash file including trailing 0xff
-          pmsg_notice("NOT erasing chip as page erase will be used for new flash%s contents;\n",
-            avr_locate_bootrow(p)? "/bootrow": "");
-          imsg_notice("unprogrammed flash contents remains: use -e for an explicit chip-erase\n");
-          break;
-        }
-      }
-    } else {
-      uflags &= ~UF_AUTO_ERASE;
-      for(ln = lfirst(updates); ln; ln = lnext(ln)) {
-        upd = ldata(ln);
-        if(upd->cmdline && *str_ltrim(upd->cmdline) && str_starts("erase", str_ltrim(upd->cmdline)))
-          break;                // -T erase already erases the chip: no auto-erase needed
+  msg_notice("\n");
 
-        if(upd->cmdline || (upd->memstr &&      // Might be reading flash?
-            (upd->op == DEVICE_READ || upd->op == DEVICE_VERIFY) && memlist_contains_flash(upd->memstr, p)))
-          flashread = 1;
+  if(!pgmid || !*pgmid) {
+    programmer_not_found(NULL, NULL, NULL);
+    exit(1);
+  }
 
-        if(upd->memstr && upd->op == DEVICE_WRITE && memlist_contains_flash(upd->memstr, p)) {
-          if(flashread) {
-            pmsg_info("NOT auto-erasing chip as flash might need reading before writing to it\n");
-          } else {
-            erase = 1;
-            pmsg_notice("auto-erasing chip as flash memory needs programming (-U %s:w:...)\n", upd->memstr);
-            imsg_notice("specify the -D option to disable this feature\n");
-          }
-          break;
-        }
-      }
+  p = partdesc && *partdesc? locate_part(part_list, partdesc): NULL;
+  pgm = locate_programmer_starts_set(programmers, pgmid, &pgmid, p);
+  if(pgm == NULL || !is_programmer(pgm)) {
+    programmer_not_found(pgmid, pgm, p);
+    exit(1);
+  }
+
+  if(p && !(p->prog_modes & pgm->prog_modes)) {
+    pmsg_error("-c %s cannot program %s for lack of a common programming mode\n", pgmid, p->desc);
+    if(!ovsigck) {
+      imsg_error("use -F to override this check\n");
+      exit(1);
     }
   }
 
-  if(init_ok && erase) {
-    /*
-     * Erase the chip's flash and eeprom memories, this is required before the
-     * chip can accept new programming
-     */
-    if(uflags & UF_NOWRITE) {
-      if(explicit_e)
-        pmsg_warning("conflicting -e and -n specified, NOT erasing chip\n");
-      else
-        pmsg_notice("-n specified, NOT erasing chip\n");
-    } else {
-      exitrc = avr_chip_erase(pgm, p);
-      if(exitrc == LIBAVRDUDE_SOFTFAIL) {
-        pmsg_notice("delaying chip erase until first -U upload to flash\n");
-        ce_delayed = 1;
-        exitrc = 0;
-      } else if(exitrc) {
-        pmsg_error("chip erase failed\n");
-        goto main_exit;
-      } else
-        pmsg_notice("erased chip\n");
+  // Gang programming needs one programmer instance per port; copy before initpgm() sets private data
+  int ngang = gang? lsize(ports): 1;
+  PROGRAMMER **gpgms = mmt_malloc(ngang*sizeof *gpgms);
+  char **gports = mmt_malloc(ngang*sizeof *gports);
+
+  gpgms[0] = pgm;
+  gports[0] = port;
+  if(gang) {
+    int k = 0;
+
+    for(LNODEID ln1 = lfirst(ports); ln1; ln1 = lnext(ln1), k++) {
+      gports[k] = ldata(ln1);
+      if(k)
+        gpgms[k] = gang_pgm_dup(pgm);
     }
   }
 
-  if(!init_ok && !ovsigck) {    // Bail out on failed initialisation unless -F was given
-    exitrc = 1;
-    goto main_exit;
+  if(pgm->initpgm) {
+    pgm->initpgm(pgm);
+  } else {
+    msg_error("\n");
+    pmsg_error("cannot initialize the programmer\n\n");
+    exit(1);
   }
 
-  int wrmem = 0, terminal = 0;
+  if(pgm->setup) {
+    pgm->setup(pgm);
+  }
+  if(pgm->teardown) {
+    atexit(exithook);
+  }
 
-  if(lsize(updates) <= 1)
-    uflags |= UF_NOHEADING;
-  for(ln = lfirst(updates); ln; ln = lnext(ln)) {
-    const AVRMEM *m;
+  if(lsize(extended_params) > 0) {
+    if(pgm->parseextparams == NULL) {
+      for(LNODEID ln = lfirst(extended_params); ln; ln = lnext(ln)) {
+        const char *extended_param = ldata(ln);
 
-    upd = ldata(ln);
-    if(upd->cmdline && wrmem) { // Invalidate cache if device was written to
-      wrmem = 0;
-      pgm->reset_cache(pgm, p);
-    } else if(!upd->cmdline) {  // Flush cache before any device memory access
-      pgm->flush_cache(pgm, p);
-      wrmem |= upd->op == DEVICE_WRITE;
+        if(str_eq(extended_param, "help")) {
+          msg_error("%s -c %s extended options:\n", progname, pgmid);
+          msg_error("  -x help  Show this help menu and exit\n");
+          exit(0);
+        } else
+          pmsg_error("programmer does not support extended parameter -x %s, option ignored\n", extended_param);
+      }
+    } else {
+      int rc = pgm->parseextparams(pgm, extended_params);
+
+      if(rc == LIBAVRDUDE_EXIT)
+        exit(0);
+      if(rc < 0) {
+        pmsg_error("unable to parse list of -x parameters\n");
+        exit(1);
+      }
     }
-    if((uflags & UF_NOWRITE) && upd->cmdline && !terminal++)
-      pmsg_warning("the terminal ignores option -n, that is, it writes to the device\n");
-    rc = do_op(pgm, p, upd, uflags);
-    if(rc && rc != LIBAVRDUDE_SOFTFAIL) {
-      exitrc = 1;
-      break;
-    } else if(rc == 0 && upd->op == DEVICE_WRITE && (m = avr_locate_mem(p, upd->memstr)) && mem_is_in_flash(m))
-      ce_delayed = 0;           // Redeemed chip erase promise
   }
-  pgm->flush_cache(pgm, p);
-
-  if(pgm->end_programming)
-    if(pgm->end_programming(pgm, p) < 0)
-      pmsg_error("could not end programming, aborting\n");
 
-main_exit:
+  for(int k = 1; k < ngang; k++) {
+    PROGRAMMER *gpgm = gpgms[k];
 
-  // Program complete
-  if(is_open) {
-    // Clear rdy LED and summarise interaction in err, pgm and vfy LEDs
-    led_set(pgm, LED_END);
-    pgm->powerdown(pgm);
-    pgm->disable(pgm);
-    pgm->close(pgm);
+    gpgm->initpgm(gpgm);
+    if(gpgm->setup)
+      gpgm->setup(gpgm);
+    if(lsize(extended_params) > 0 && gpgm->parseextparams && gpgm->parseextparams(gpgm, extended_params) < 0)
+      exit(1);
   }
 
-  if(cx->usb_access_error) {
-    pmsg_info("\nUSB access errors detected; this could have many reasons; if it is\n"
-      "USB permission problems, avrdude is likely to work when run as root\n"
-      "but this is not good practice; instead you might want to\n");
+  if(port == NULL) {
+    switch(pgm->conntype) {
+    case CONNTYPE_PARALLEL:
+      port = mmt_strdup(default_parallel);
+      break;
 
-#if 0 && !defined(WIN32)
-    DIR *dir;
+    case CONNTYPE_SERIAL:
+      port = mmt_strdup(default_serial);
+      break;
 
-    if((dir = opendir("/etc/udev/rules.d"))) {  // Linux udev land
-      closedir(dir);
-      imsg_info("run the command below to show udev rules recitifying USB access\n" "$ %s -c %s/u\n", progname, pgmid);
-    } else
+    case CONNTYPE_USB:
+      port = mmt_strdup(DEFAULT_USB);
+      break;
+
+    case CONNTYPE_SPI:
+
+#ifdef HAVE_LINUXSPI
+      port = mmt_strdup(*default_spi? default_spi: "unknown");
+#else
+      port = mmt_strdup("unknown");
 #endif
 
-      imsg_info("check out USB port permissions on your OS and set them correctly\n");
+      break;
+
+    case CONNTYPE_LINUXGPIO:
+      port = mmt_strdup(default_linuxgpio);
+      break;
+
+    default:
+      port = mmt_strdup("unknown");
+      break;
+
+    }
+  }
+
+  int is_dryrun = str_eq(pgm->type, "dryrun") || (dry && pgm->initpgm == dry->initpgm);
+
+  if((port[0] == 0 || str_eq(port, "unknown")) && !is_dryrun) {
+    msg_error("\n");
+    pmsg_error("no port has been specified on the command line or in the config file;\n");
+    imsg_error("specify a port using the -P option and try again\n");
+    exit(1);
   }
 
+  Session_opts so = {
+    .exitspecs = exitspecs, .erase = erase, .explicit_e = explicit_e, .calibrate = calibrate,
+    .incremental = incremental, .baudrate = baudrate, .touch_1200bps = touch_1200bps,
+    .bitclock = bitclock, .ispdelay = ispdelay, .is_dryrun = is_dryrun,
+    .disableffopt = cx->avr_disableffopt, .gang = gang, .timing = timing,
+    .record = record, .replay = replay, .uflags = uflags,
+  };
+
+  exitrc = gang? gang_program(gpgms, gports, ngang, &so): session(pgm, port, &so);
+  mmt_free(gpgms);
+  mmt_free(gports);
+
   msg_info("\n");
   pmsg_info("%s done.  Thank you.\n", progname);
 
-  return ce_delayed? 1: exitrc;
+  return exitrc;
 }
@@ -92,8 +92,7 @@ static int par_setpin_internal(const PROGRAMMER *pgm, int pin, int value) {
   else
     ppi_clr(&pgm->fd, ppipins[pin].reg, ppipins[pin].bit);
 
-  if(pgm->ispdelay > 1)
-    bitbang_delay(pgm->ispdelay);
+  bitbang_pin_delay(pgm);
 
   return 0;
 }
@@ -173,20 +172,16 @@ static int par_highpulsepin(const PROGRAMMER *pgm, int pinfunc) {
 
   if(inverted) {
     ppi_clr(&pgm->fd, ppipins[pin].reg, ppipins[pin].bit);
-    if(pgm->ispdelay > 1)
-      bitbang_delay(pgm->ispdelay);
+    bitbang_pin_delay(pgm);
 
     ppi_set(&pgm->fd, ppipins[pin].reg, ppipins[pin].bit);
-    if(pgm->ispdelay > 1)
-      bitbang_delay(pgm->ispdelay);
+    bitbang_pin_delay(pgm);
   } else {
     ppi_set(&pgm->fd, ppipins[pin].reg, ppipins[pin].bit);
-    if(pgm->ispdelay > 1)
-      bitbang_delay(pgm->ispdelay);
+    bitbang_pin_delay(pgm);
 
     ppi_clr(&pgm->fd, ppipins[pin].reg, ppipins[pin].bit);
-    if(pgm->ispdelay > 1)
-      bitbang_delay(pgm->ispdelay);
+    bitbang_pin_delay(pgm);
   }
 
   return 0;
@@ -226,9 +221,6 @@ static void par_enable(PROGRAMMER *pgm, const AVRPART *p) {
 }
 
 static int par_open(PROGRAMMER *pgm, const char *port) {
-  if(pgm->bitclock)
-    pmsg_warning("-c %s does not support adjustable bitclock speed using -B; use -i instead\n", pgmid);
-
   if(bitbang_check_prerequisites(pgm) < 0)
     return -1;
 
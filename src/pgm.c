@@ -81,6 +81,8 @@ void pgm_init_functions(PROGRAMMER *pgm) {
   pgm->vfy_led = pgm_default_led;
   pgm->read_byte_cached = avr_read_byte_cached;
   pgm->write_byte_cached = avr_write_byte_cached;
+  pgm->read_range_cached = avr_read_range_cached;
+  pgm->write_range_cached = avr_write_range_cached;
   pgm->chip_erase_cached = avr_chip_erase_cached;
   pgm->page_erase_cached = avr_page_erase_cached;
   pgm->flush_cache = avr_flush_cache;
@@ -93,9 +95,13 @@ void pgm_init_functions(PROGRAMMER *pgm) {
   pgm->cmd = NULL;
   pgm->cmd_tpi = NULL;
   pgm->spi = NULL;
+  pgm->cmd_multi = NULL;
   pgm->paged_write = NULL;
   pgm->paged_load = NULL;
   pgm->page_erase = NULL;
+  pgm->paged_write_multi = NULL;
+  pgm->paged_load_multi = NULL;
+  pgm->checksum = NULL;
   pgm->write_setup = NULL;
   pgm->read_sig_bytes = NULL;
   pgm->read_sib = NULL;
@@ -301,6 +307,18 @@ PROGRAMMER *locate_programmer_starts_set(const LISTID programmers, const char *p
   if(!pgid || !(p1 = tolower((unsigned char) *pgid)))
     return NULL;
 
+  // Programmer ids are unique, so an exact match via the index is the answer
+  if(cfg_index_valid(&cx->cfg_pgmidx, programmers)) {
+    const char *id;
+
+    pgm = cfg_index_lookup(&cx->cfg_pgmidx, pgid, &id);
+    if(pgm && is_programmer(pgm) && (pgm->prog_modes & pmode)) {
+      if(setid)
+        *setid = id;
+      return pgm;
+    }
+  }
+
   l = strlen(pgid);
   matches = 0;
   matchp = NULL;
@@ -340,6 +358,9 @@ done:
 
 // Locate a programmer (or serial adapter) by full name and set the matching id
 PROGRAMMER *locate_programmer_set(const LISTID programmers, const char *configid, const char **setid) {
+  if(cfg_index_valid(&cx->cfg_pgmidx, programmers))
+    return cfg_index_lookup(&cx->cfg_pgmidx, configid, setid);
+
   for(LNODEID ln1 = lfirst(programmers); ln1; ln1 = lnext(ln1)) {
     PROGRAMMER *p = ldata(ln1);
 
@@ -395,6 +416,8 @@ static int sort_programmer_compare(const PROGRAMMER *p1, const PROGRAMMER *p2) {
 // Sort the list of programmers given as "programmers"
 void sort_programmers(LISTID programmers) {
   lsort(programmers, (int (*)(void *, void *)) sort_programmer_compare);
+  if(cfg_index_valid(&cx->cfg_pgmidx, programmers))     // First match in list order may have changed
+    cfg_index_programmers(programmers);
 }
 
 // Soft assignment: some PROGRAMMER entries can be both programmers and serial adapters
@@ -2106,68 +2106,18 @@ static int usbdev_check_connected(unsigned int vid, unsigned int pid) {
   This functions are hardcoded on the Pickit endpoint numbers
 */
 static int usbdev_bulk_recv(const union filedescriptor *fd, unsigned char *buf, size_t nbytes) {
-  int i, amnt;
-  unsigned char *p = buf;
+  union filedescriptor dfd = *fd;
 
-  if(fd->usb.handle == NULL)
-    return -1;
-
-  for(i = 0; nbytes > 0;) {
-    if(cx->usb_buflen <= cx->usb_bufptr) {
-      int rv = usb_bulk_read(fd->usb.handle, USB_PK5_DATA_READ_EP, cx->usb_buf, fd->usb.max_xfer, 10000);
-
-      if(rv < 0) {
-        pmsg_notice2("%s(): usb_bulk_read() error: %s\n", __func__, usb_strerror());
-        return -1;
-      }
-
-      cx->usb_buflen = rv;
-      cx->usb_bufptr = 0;
-    }
-
-    amnt = cx->usb_buflen - cx->usb_bufptr > (int) nbytes? (int) nbytes: cx->usb_buflen - cx->usb_bufptr;
-    memcpy(buf + i, cx->usb_buf + cx->usb_bufptr, amnt);
-    cx->usb_bufptr += amnt;
-    nbytes -= amnt;
-    i += amnt;
-  }
-
-  if(verbose > 4)
-    trace_buffer(__func__, p, i);
-
-  return 0;
+  // Reuse the USB serdev so this works with either libusb backend
+  dfd.usb.rep = USB_PK5_DATA_READ_EP;
+  return usb_serdev.recv(&dfd, buf, nbytes);
 }
 
 static int usbdev_bulk_send(const union filedescriptor *fd, const unsigned char *bp, size_t mlen) {
-  int rv;
-  const unsigned char *p = bp;
-  int tx_size, i = mlen;
-
-  if(fd->usb.handle == NULL)
-    return -1;
-
-  /*
-   * Split the frame into multiple packets.  It's important to make sure we
-   * finish with a short packet, or else the device won't know the frame is
-   * finished.  For example, if we need to send 64 bytes, we must send a packet
-   * of length 64 followed by a packet of length 0.
-   */
-  do {
-    tx_size = ((int) mlen < fd->usb.max_xfer)? (int) mlen: fd->usb.max_xfer;
+  union filedescriptor dfd = *fd;
 
-    rv = usb_bulk_write(fd->usb.handle, USB_PK5_DATA_WRITE_EP, (char *) bp, tx_size, 10000);
-    if(rv != tx_size) {
-      pmsg_error("wrote %d out of %d bytes, err = %s\n", rv, tx_size, usb_strerror());
-      return -1;
-    }
-    bp += tx_size;
-    mlen -= tx_size;
-    i += tx_size;
-  } while(mlen > 0);
-
-  if(verbose > 3)
-    trace_buffer(__func__, p, i);
-  return 0;
+  dfd.usb.wep = USB_PK5_DATA_WRITE_EP;
+  return usb_serdev.send(&dfd, bp, mlen);
 }
 
 #else
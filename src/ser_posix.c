@@ -31,9 +31,15 @@
 #include <sys/ioctl.h>
 #include <sys/types.h>
 #include <sys/time.h>
-#include <sys/select.h>
 #include <sys/socket.h>
 #include <netdb.h>
+#include <limits.h>
+#include <poll.h>
+
+#if defined(__linux__)
+#define HAVE_EPOLL 1
+#include <sys/epoll.h>
+#endif
 
 #include <fcntl.h>
 #include <termios.h>
@@ -46,8 +52,9 @@
 #include "avrdude.h"
 #include "libavrdude.h"
 
-long serial_recv_timeout = 5000;        // ms
-long serial_drain_timeout = 250;        // ms
+AVRDUDE_TLS long serial_recv_timeout = 5000; // ms
+AVRDUDE_TLS long serial_drain_timeout = 250; // ms
+AVRDUDE_TLS long serial_send_timeout = 5000; // ms
 
 struct baud_mapping {
   long baud;
@@ -327,7 +334,8 @@ static int net_open(const char *port, union filedescriptor *fdp) {
       continue;
     }
     if(connect(fd, rp->ai_addr, rp->ai_addrlen) != -1) {
-      // Success, we are connected
+      // Success, we are connected; the serial I/O loop expects non-blocking fds
+      fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
       break;
     }
     close(fd);
@@ -413,125 +421,438 @@ static void ser_close(union filedescriptor *fd) {
     cx->ser_saved_original_termios = 0;
   }
 
+  serial_loop_free(cx->ser_loop);
+  cx->ser_loop = NULL;
   close(fd->ifd);
 }
 
 // Close but don't restore attributes
 static void ser_rawclose(union filedescriptor *fd) {
   cx->ser_saved_original_termios = 0;
+  serial_loop_free(cx->ser_loop);
+  cx->ser_loop = NULL;
   close(fd->ifd);
 }
 
-static int ser_send(const union filedescriptor *fd, const unsigned char *buf, size_t len) {
-  int rc;
+/*
+ * Asynchronous serial I/O
+ *
+ * A Serial_loop holds a FIFO of read and write requests on any number of
+ * non-blocking fds. serial_loop_run() waits for readiness with epoll (Linux)
+ * or poll() and services the oldest request per fd and direction; each
+ * request completes through its callback once all bytes have been
+ * transferred, when it has seen no progress for its timeout or on error.
+ * Callbacks may submit new requests but must not run the loop. The blocking
+ * ser_send(), ser_recv() and ser_drain() below are thin shims that submit one
+ * request to a loop private to the session and run it until it completes.
+ */
 
-  if(verbose >= MSG_TRACE)
-    trace_buffer(__func__, buf, len);
+typedef struct serial_req {
+  struct serial_req *next;
+  int fd, out;                  // File descriptor and direction (1 for write)
+  unsigned char *buf;
+  size_t len, done;             // Requested and transferred number of bytes
+  long timeout;                 // Inactivity timeout in ms, negative for none
+  uint64_t deadline;            // Set once the request is first serviced
+  int armed;
+  Serial_cb cb;
+  void *arg;
+} Serial_req;
+
+struct serial_loop {
+  Serial_req *head, *tail;
+  struct pollfd *want, *have;   // Desired and (epoll) registered interest
+  int nwant, nhave, size;
+  int epfd;                     // -1 if epoll is not available
+};
 
-  while(len) {
-    rc = write(fd->ifd, buf, len > 1024? 1024: len);
-    if(rc < 0) {
-      pmsg_ext_error("unable to write: %s\n", strerror(errno));
-      return -1;
-    }
-    buf += rc;
-    len -= rc;
+Serial_loop *serial_loop_new(void) {
+  Serial_loop *loop = mmt_malloc(sizeof *loop);
+
+  loop->epfd = -1;
+#ifdef HAVE_EPOLL
+  loop->epfd = epoll_create1(EPOLL_CLOEXEC);
+#endif
+
+  return loop;
+}
+
+void serial_loop_free(Serial_loop *loop) {
+  if(!loop)
+    return;
+  for(Serial_req *r = loop->head, *nxt; r; r = nxt) {
+    nxt = r->next;
+    mmt_free(r);
   }
+  if(loop->epfd >= 0)
+    close(loop->epfd);
+  mmt_free(loop->want);
+  mmt_free(loop->have);
+  mmt_free(loop);
+}
+
+static int serial_async_submit(Serial_loop *loop, int fd, int out, unsigned char *buf, size_t len,
+  long timeout, Serial_cb cb, void *arg) {
+
+  if(!loop || fd < 0 || !cb)
+    return -1;
+
+  Serial_req *r = mmt_malloc(sizeof *r);
+
+  r->fd = fd;
+  r->out = out;
+  r->buf = buf;
+  r->len = len;
+  r->timeout = timeout;
+  r->cb = cb;
+  r->arg = arg;
+  if(loop->tail)
+    loop->tail->next = r;
+  else
+    loop->head = r;
+  loop->tail = r;
 
   return 0;
 }
 
-static int ser_recv(const union filedescriptor *fd, unsigned char *buf, size_t buflen) {
-  struct timeval timeout, to2;
-  fd_set rfds;
-  int nfds;
-  int rc;
-  unsigned char *p = buf;
-  size_t len = 0;
+int serial_async_recv(Serial_loop *loop, const union filedescriptor *fd, unsigned char *buf, size_t len,
+  long timeout, Serial_cb cb, void *arg) {
+
+  return serial_async_submit(loop, fd->ifd, 0, buf, len, timeout, cb, arg);
+}
 
-  timeout.tv_sec = serial_recv_timeout/1000L;
-  timeout.tv_usec = (serial_recv_timeout%1000L)*1000;
+int serial_async_send(Serial_loop *loop, const union filedescriptor *fd, const unsigned char *buf, size_t len,
+  long timeout, Serial_cb cb, void *arg) {
 
-  while(len < buflen) {
-    to2 = timeout;
-  reselect:
-    FD_ZERO(&rfds);
-    FD_SET(fd->ifd, &rfds);
+  return serial_async_submit(loop, fd->ifd, 1, (unsigned char *) buf, len, timeout, cb, arg);
+}
 
-    nfds = select(fd->ifd + 1, &rfds, NULL, NULL, &to2);
-    if(nfds == 0) {
-      pmsg_notice2("%s(): programmer is not responding\n", __func__);
-      return -1;
-    } else if(nfds == -1) {
-      if(errno == EINTR || errno == EAGAIN) {
-        pmsg_warning("programmer is not responding, reselecting\n");
-        goto reselect;
-      } else {
-        pmsg_ext_error("select(): %s\n", strerror(errno));
-        return -1;
+// Unlink r from the queue and hand it back to the caller
+static void serial_async_complete(Serial_loop *loop, Serial_req *r, int status) {
+  Serial_req **pp = &loop->head, *prev = NULL;
+
+  for(; *pp && *pp != r; pp = &(*pp)->next)
+    prev = *pp;
+  if(!*pp)
+    return;
+  *pp = r->next;
+  if(loop->tail == r)
+    loop->tail = prev;
+
+  Serial_cb cb = r->cb;
+  void *arg = r->arg;
+  unsigned char *buf = r->buf;
+  size_t done = r->done;
+
+  mmt_free(r);
+  cb(arg, status, buf, done);
+}
+
+// Oldest request on the same fd and direction as r?
+static int serial_async_isfirst(const Serial_loop *loop, const Serial_req *r) {
+  for(const Serial_req *q = loop->head; q != r; q = q->next)
+    if(q->fd == r->fd && q->out == r->out)
+      return 0;
+  return 1;
+}
+
+static Serial_req *serial_async_first(const Serial_loop *loop, int fd, int out) {
+  for(Serial_req *q = loop->head; q; q = q->next)
+    if(q->fd == fd && q->out == out)
+      return q;
+  return NULL;
+}
+
+static void serial_async_want(Serial_loop *loop, int fd, short events) {
+  for(int i = 0; i < loop->nwant; i++)
+    if(loop->want[i].fd == fd) {
+      loop->want[i].events |= events;
+      return;
+    }
+  if(loop->nwant == loop->size) {
+    loop->size = loop->size? 2*loop->size: 8;
+    loop->want = mmt_realloc(loop->want, loop->size*sizeof *loop->want);
+    loop->have = mmt_realloc(loop->have, loop->size*sizeof *loop->have);
+  }
+  loop->want[loop->nwant].fd = fd;
+  loop->want[loop->nwant].revents = 0;
+  loop->want[loop->nwant++].events = events;
+}
+
+// Transfer as much as possible for the first request on fd in direction out
+static void serial_async_service(Serial_loop *loop, int fd, int out) {
+  Serial_req *r;
+
+  while((r = serial_async_first(loop, fd, out))) {
+    size_t chunk = r->len - r->done > 1024? 1024: r->len - r->done;
+    ssize_t rc = 0;
+
+    if(chunk) {
+      rc = out? write(fd, r->buf + r->done, chunk): read(fd, r->buf + r->done, chunk);
+      if(rc < 0) {
+        if(errno == EINTR)
+          continue;
+        if(errno != EAGAIN && errno != EWOULDBLOCK)
+          serial_async_complete(loop, r, -errno);
+        return;
+      }
+      if(rc == 0 && !out) {     // Peer closed connection
+        serial_async_complete(loop, r, -EPIPE);
+        return;
       }
+      r->done += rc;
+      r->deadline = avr_mstimestamp() + r->timeout;
+    }
+    if(r->done < r->len) {
+      if((size_t) rc < chunk)   // Short transfer: wait for readiness again
+        return;
+      continue;
     }
+    serial_async_complete(loop, r, 0);
+  }
+}
 
-    rc = read(fd->ifd, p, buflen - len > 1024? 1024: buflen - len);
-    if(rc < 0) {
-      pmsg_ext_error("unable to read: %s\n", strerror(errno));
-      return -1;
+#ifdef HAVE_EPOLL
+// Bring the epoll interest set in line with loop->want[]
+static int serial_async_sync(Serial_loop *loop) {
+  struct epoll_event ev;
+
+  for(int i = 0; i < loop->nhave; i++) {
+    int j;
+
+    for(j = 0; j < loop->nwant; j++)
+      if(loop->want[j].fd == loop->have[i].fd)
+        break;
+    if(j == loop->nwant) {
+      epoll_ctl(loop->epfd, EPOLL_CTL_DEL, loop->have[i].fd, NULL); // Fails silently if fd was closed
+      loop->have[i--] = loop->have[--loop->nhave];
     }
-    p += rc;
-    len += rc;
   }
 
-  if(verbose >= MSG_TRACE)
-    trace_buffer(__func__, buf, len);
+  for(int j = 0; j < loop->nwant; j++) {
+    int i, rc, op;
+
+    for(i = 0; i < loop->nhave; i++)
+      if(loop->have[i].fd == loop->want[j].fd)
+        break;
+    if(i < loop->nhave && loop->have[i].events == loop->want[j].events)
+      continue;
+    memset(&ev, 0, sizeof ev);
+    ev.events = (loop->want[j].events & POLLIN? EPOLLIN: 0) | (loop->want[j].events & POLLOUT? EPOLLOUT: 0);
+    ev.data.fd = loop->want[j].fd;
+    op = i < loop->nhave? EPOLL_CTL_MOD: EPOLL_CTL_ADD;
+    rc = epoll_ctl(loop->epfd, op, ev.data.fd, &ev);
+    if(rc < 0 && (errno == ENOENT || errno == EEXIST)) // fd was closed and reused meanwhile
+      rc = epoll_ctl(loop->epfd, op == EPOLL_CTL_ADD? EPOLL_CTL_MOD: EPOLL_CTL_ADD, ev.data.fd, &ev);
+    if(rc < 0)
+      return -1;
+    if(i == loop->nhave)
+      loop->nhave++;
+    loop->have[i] = loop->want[j];
+  }
 
   return 0;
 }
+#endif
 
-static int ser_drain(const union filedescriptor *fd, int display) {
-  struct timeval timeout;
-  fd_set rfds;
-  int nfds;
-  int rc;
-  unsigned char buf;
+// Wait up to ms milliseconds and service the ready fds; return -1 on error
+static int serial_async_wait(Serial_loop *loop, int ms) {
+  int n;
 
-  timeout.tv_sec = 0;
-  timeout.tv_usec = serial_drain_timeout*1000L;
+#ifdef HAVE_EPOLL
+  if(loop->epfd >= 0) {
+    struct epoll_event evs[16];
 
-  if(display) {
-    msg_info("drain>");
+    if(serial_async_sync(loop) < 0)
+      return -1;
+    do
+      n = epoll_wait(loop->epfd, evs, sizeof evs/sizeof *evs, ms);
+    while(n < 0 && errno == EINTR);
+    for(int i = 0; i < n; i++) {
+      unsigned e = evs[i].events;
+
+      if(e & (EPOLLIN | EPOLLERR | EPOLLHUP))
+        serial_async_service(loop, evs[i].data.fd, 0);
+      if(e & (EPOLLOUT | EPOLLERR | EPOLLHUP))
+        serial_async_service(loop, evs[i].data.fd, 1);
+    }
+    return n < 0? -1: 0;
   }
+#endif
 
-  while(1) {
-    FD_ZERO(&rfds);
-    FD_SET(fd->ifd, &rfds);
+  struct pollfd *pfds = loop->want;
+
+  do
+    n = poll(pfds, loop->nwant, ms);
+  while(n < 0 && errno == EINTR);
+  for(int i = 0; n > 0 && i < loop->nwant; i++) {
+    short e = pfds[i].revents;
+
+    if(e & (POLLIN | POLLERR | POLLHUP))
+      serial_async_service(loop, pfds[i].fd, 0);
+    if(e & (POLLOUT | POLLERR | POLLHUP))
+      serial_async_service(loop, pfds[i].fd, 1);
+    if(e & POLLNVAL)
+      for(int out = 0; out < 2; out++)
+        for(Serial_req *r; (r = serial_async_first(loop, pfds[i].fd, out));)
+          serial_async_complete(loop, r, -EBADF);
+  }
 
-  reselect:
-    nfds = select(fd->ifd + 1, &rfds, NULL, NULL, &timeout);
-    if(nfds == 0) {
-      if(display) {
-        msg_info("<drain\n");
-      }
+  return n < 0? -1: 0;
+}
 
-      break;
-    } else if(nfds == -1) {
-      if(errno == EINTR) {
-        goto reselect;
-      } else {
-        pmsg_ext_error("select(): %s\n", strerror(errno));
-        return -1;
+/*
+ * Run the loop until no requests are pending or, for non-negative timeout,
+ * until timeout ms have elapsed; return the number of pending requests, or
+ * -1 if waiting failed, in which case all pending requests have been
+ * completed with -errno
+ */
+int serial_loop_run(Serial_loop *loop, long timeout) {
+  uint64_t end = avr_mstimestamp() + (timeout > 0? timeout: 0);
+
+  if(!loop)
+    return -1;
+
+  while(loop->head) {
+    uint64_t now = avr_mstimestamp(), next = timeout < 0? UINT64_MAX: end;
+    int expired = 0;
+
+    // Arm and time out the first request per fd and direction
+    loop->nwant = 0;
+    for(Serial_req *r = loop->head, *nxt; r; r = nxt) {
+      nxt = r->next;
+      if(!serial_async_isfirst(loop, r))
+        continue;
+      if(!r->armed) {
+        r->armed = 1;
+        r->deadline = now + r->timeout;
+      }
+      if(r->timeout >= 0 && r->deadline <= now) {
+        serial_async_complete(loop, r, SERIAL_ASYNC_TIMEOUT);
+        expired = 1;            // Callback might have changed the queue
+        break;
       }
+      if(r->timeout >= 0 && r->deadline < next)
+        next = r->deadline;
+      serial_async_want(loop, r->fd, r->out? POLLOUT: POLLIN);
     }
+    if(expired)
+      continue;
+
+    if(timeout > 0 && now >= end)
+      break;
+    int ms = next == UINT64_MAX? -1: next > now? (int) (next - now > INT_MAX? INT_MAX: next - now): 0;
+
+    if(serial_async_wait(loop, ms) < 0) {
+      int err = -errno;
 
-    rc = read(fd->ifd, &buf, 1);
-    if(rc < 0) {
-      pmsg_ext_error("unable to read: %s\n", strerror(errno));
+      pmsg_ext_error("waiting for serial I/O failed: %s\n", strerror(errno));
+      while(loop->head)
+        serial_async_complete(loop, loop->head, err);
       return -1;
     }
+    if(timeout == 0)
+      break;
+  }
+
+  int n = 0;
+
+  for(Serial_req *r = loop->head; r; r = r->next)
+    n++;
+
+  return n;
+}
+
+// Session-private loop for the blocking serdev functions
+static Serial_loop *ser_loop(void) {
+  if(!cx->ser_loop)
+    cx->ser_loop = serial_loop_new();
+  return cx->ser_loop;
+}
+
+typedef struct {
+  int done, status;
+  size_t len;
+} Ser_wait;
+
+static void ser_wait_cb(void *arg, int status, unsigned char *buf, size_t len) {
+  Ser_wait *w = arg;
+
+  w->done = 1;
+  w->status = status;
+  w->len = len;
+}
+
+// Submit one request and block until it has completed; return its status
+static int ser_transfer(const union filedescriptor *fd, int out, unsigned char *buf, size_t len, long timeout) {
+  Serial_loop *loop = ser_loop();
+  Ser_wait w = { 0 };
+  int rc = out? serial_async_send(loop, fd, buf, len, timeout, ser_wait_cb, &w):
+    serial_async_recv(loop, fd, buf, len, timeout, ser_wait_cb, &w);
+
+  if(rc < 0)
+    return -EINVAL;
+  while(!w.done)
+    if(serial_loop_run(loop, -1) < 0 && !w.done)
+      return -EIO;
+
+  return w.status;
+}
+
+static int ser_send(const union filedescriptor *fd, const unsigned char *buf, size_t len) {
+  if(verbose >= MSG_TRACE)
+    trace_buffer(__func__, buf, len);
+
+  int rc = ser_transfer(fd, 1, (unsigned char *) buf, len, serial_send_timeout);
+
+  if(rc < 0) {
+    pmsg_ext_error("unable to write: %s\n", rc == SERIAL_ASYNC_TIMEOUT? "timeout": strerror(-rc));
+    return -1;
+  }
+
+  return 0;
+}
+
+static int ser_recv(const union filedescriptor *fd, unsigned char *buf, size_t buflen) {
+  int rc = ser_transfer(fd, 0, buf, buflen, serial_recv_timeout);
+
+  if(rc == SERIAL_ASYNC_TIMEOUT) {
+    pmsg_notice2("%s(): programmer is not responding\n", __func__);
+    return -1;
+  } else if(rc < 0) {
+    pmsg_ext_error("unable to read: %s\n", strerror(-rc));
+    return -1;
+  }
+
+  if(verbose >= MSG_TRACE)
+    trace_buffer(__func__, buf, buflen);
+
+  return 0;
+}
+
+static int ser_drain(const union filedescriptor *fd, int display) {
+  unsigned char buf;
+  int rc;
+
+  if(display) {
+    msg_info("drain>");
+  }
+
+  while((rc = ser_transfer(fd, 0, &buf, 1, serial_drain_timeout)) == 0) {
     if(display) {
       msg_info("%02x ", buf);
     }
   }
 
+  if(rc != SERIAL_ASYNC_TIMEOUT) {
+    pmsg_ext_error("unable to read: %s\n", strerror(-rc));
+    return -1;
+  }
+
+  if(display) {
+    msg_info("<drain\n");
+  }
+
   return 0;
 }
 
@@ -547,5 +868,5 @@ struct serial_device serial_serdev = {
   .flags = SERDEV_FL_CANSETSPEED,
 };
 
-struct serial_device *serdev = &serial_serdev;
+AVRDUDE_TLS struct serial_device *serdev = &serial_serdev;
 #endif                          // WIN32
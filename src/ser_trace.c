@@ -0,0 +1,352 @@
+/*
+ * avrdude - A Downloader/Uploader for AVR device programmers
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Recording and replay of the serdev exchange (--record, --replay)
+ *
+ * The serial_*() macros of libavrdude.h route through the functions below
+ * whenever a recording or replay is active. A recording stores every call
+ * to the current serdev (serial port, USB, HID, AVR-Doper, XBee) together
+ * with its time stamp, return value and data. A replay serves the recorded
+ * results to the same driver without hardware: data sent by the driver
+ * must match the recording byte by byte, and recorded receive timeouts are
+ * returned as timeouts, so retry paths of the driver are exercised, too.
+ * Records are served no earlier than their recorded time stamp, which keeps
+ * the timing of delays and busy waits in the driver as recorded.
+ *
+ * File format: the magic string below followed by records, each consisting
+ * of a one-byte type, a little endian 64-bit time stamp in us, 32-bit
+ * return value, 32-bit argument, 32-bit data length and the data.
+ */
+
+#include <ac_cfg.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+
+#include "avrdude.h"
+#include "libavrdude.h"
+
+#define TRACE_MAGIC "AVRDUDE-TRACE1\n"
+#define TRACE_HDRLEN 21         // Type, time stamp, rc, arg, data length
+
+enum {                          // Record types
+  TR_OPEN = 'O', TR_SETPARAMS = 'P', TR_CLOSE = 'C', TR_RAWCLOSE = 'c',
+  TR_SEND = 'W', TR_RECV = 'R', TR_DRAIN = 'D', TR_DTR_RTS = 'T',
+};
+
+typedef struct {
+  int type, rc, arg;
+  uint64_t us;
+  const unsigned char *data;
+  size_t len;
+} Trace_rec;
+
+static void put_le(unsigned char *p, uint64_t v, int n) {
+  for(int i = 0; i < n; i++, v >>= 8)
+    p[i] = v;
+}
+
+static uint64_t get_le(const unsigned char *p, int n) {
+  uint64_t v = 0;
+
+  for(int i = n - 1; i >= 0; i--)
+    v = v << 8 | p[i];
+  return v;
+}
+
+static void trace_put(int type, int rc, int arg, const void *data, size_t len) {
+  unsigned char hdr[TRACE_HDRLEN];
+
+  if(!cx->trace_fp)
+    return;
+  hdr[0] = type;
+  put_le(hdr + 1, avr_ustimestamp() - cx->trace_start, 8);
+  put_le(hdr + 9, (uint32_t) rc, 4);
+  put_le(hdr + 13, (uint32_t) arg, 4);
+  put_le(hdr + 17, len, 4);
+  if(fwrite(hdr, 1, sizeof hdr, cx->trace_fp) != sizeof hdr ||
+    (len && fwrite(data, 1, len, cx->trace_fp) != len)) {
+    pmsg_ext_error("cannot write to trace file: %s\n", strerror(errno));
+    fclose(cx->trace_fp);
+    cx->trace_fp = NULL;
+  }
+}
+
+// Decode the record at position pos of the replay buffer; return 0 at end of buffer
+static int trace_get(size_t pos, Trace_rec *r) {
+  const unsigned char *p = cx->replay_buf + pos;
+
+  if(pos + TRACE_HDRLEN > cx->replay_len)
+    return 0;
+  r->type = p[0];
+  r->us = get_le(p + 1, 8);
+  r->rc = (int32_t) get_le(p + 9, 4);
+  r->arg = (int32_t) get_le(p + 13, 4);
+  r->len = get_le(p + 17, 4);
+  r->data = p + TRACE_HDRLEN;
+
+  return pos + TRACE_HDRLEN + r->len <= cx->replay_len;
+}
+
+static int replay_mismatch(const char *what, const Trace_rec *r) {
+  if(!cx->replay_diverged++)
+    pmsg_error("replay diverges from recording at record %d: driver %s but recording has %s\n",
+      cx->replay_nrec, what, !r? "no more data":
+      r->type == TR_SEND? "a send": r->type == TR_RECV? "a receive": "a control call");
+  return -1;
+}
+
+/*
+ * Consume the next record if it has the given type; data records (send and
+ * receive) skip control records on the way, and any other type for a data
+ * record means the replay diverged. A consumed record is not served before
+ * its recorded time so the driver sees the pace of the original session.
+ */
+static int replay_next(int type, Trace_rec *r) {
+  Trace_rec rec;
+  size_t pos = cx->replay_pos;
+  int data = type == TR_SEND || type == TR_RECV;
+
+  while(trace_get(pos, &rec)) {
+    if(rec.type == type) {
+      cx->replay_pos = pos + TRACE_HDRLEN + rec.len;
+      cx->replay_nrec++;
+      *r = rec;
+
+      uint64_t now = avr_ustimestamp() - cx->trace_start;
+
+      if(rec.us > now)
+        usleep((unsigned int) (rec.us - now));
+      return 1;
+    }
+    if(!data || rec.type == TR_SEND || rec.type == TR_RECV)
+      break;
+    pos += TRACE_HDRLEN + rec.len;
+  }
+  if(data)
+    replay_mismatch(type == TR_SEND? "sends": "receives", trace_get(pos, &rec)? &rec: NULL);
+
+  return 0;
+}
+
+// Start recording the serdev exchange of this session to fname
+int serial_record(const char *fname) {
+  if(!(cx->trace_fp = fopen(fname, "wb"))) {
+    pmsg_ext_error("cannot create trace file %s: %s\n", fname, strerror(errno));
+    return -1;
+  }
+  fputs(TRACE_MAGIC, cx->trace_fp);
+  cx->trace_start = avr_ustimestamp();
+
+  return 0;
+}
+
+// Serve the serdev exchange of this session from a recording
+int serial_replay(const char *fname) {
+  FILE *fp = fopen(fname, "rb");
+  long size;
+
+  if(!fp) {
+    pmsg_ext_error("cannot open trace file %s: %s\n", fname, strerror(errno));
+    return -1;
+  }
+  if(fseek(fp, 0, SEEK_END) < 0 || (size = ftell(fp)) < (long) strlen(TRACE_MAGIC) || fseek(fp, 0, SEEK_SET) < 0) {
+    pmsg_error("trace file %s too short\n", fname);
+    fclose(fp);
+    return -1;
+  }
+  cx->replay_buf = mmt_malloc(size);
+  cx->replay_len = fread(cx->replay_buf, 1, size, fp);
+  fclose(fp);
+  if(memcmp(cx->replay_buf, TRACE_MAGIC, strlen(TRACE_MAGIC))) {
+    pmsg_error("%s is not an avrdude trace file\n", fname);
+    serial_trace_end();
+    return -1;
+  }
+  cx->replay_pos = strlen(TRACE_MAGIC);
+  cx->replay_nrec = 0;
+  cx->replay_diverged = 0;
+  cx->trace_start = avr_ustimestamp();
+
+  return 0;
+}
+
+// Finish recording or replay; return -1 if the replay diverged or left data unused
+int serial_trace_end(void) {
+  int ret = 0;
+
+  if(cx->trace_fp) {
+    if(fclose(cx->trace_fp))
+      ret = -1;
+    cx->trace_fp = NULL;
+  }
+  if(cx->replay_buf) {
+    Trace_rec r;
+
+    for(size_t pos = cx->replay_pos; trace_get(pos, &r); pos += TRACE_HDRLEN + r.len)
+      if(r.type == TR_SEND || r.type == TR_RECV) {
+        if(!cx->replay_diverged)
+          pmsg_warning("replay finished before the end of the recording (record %d)\n", cx->replay_nrec);
+        ret = -1;
+        break;
+      }
+    if(cx->replay_diverged)
+      ret = -1;
+    mmt_free(cx->replay_buf);
+    cx->replay_buf = NULL;
+  }
+
+  return ret;
+}
+
+int serial_trace_open(const char *port, union pinfo pinfo, union filedescriptor *fd) {
+  unsigned char data[20];
+  Trace_rec r;
+  int rc;
+
+  if(cx->replay_buf) {
+    if(!replay_next(TR_OPEN, &r))
+      return -1;
+    // Restore the USB parameters some drivers read from the file descriptor
+    memset(fd, 0, sizeof *fd);
+    if(r.len >= sizeof data) {
+      fd->usb.rep = get_le(r.data, 4);
+      fd->usb.wep = get_le(r.data + 4, 4);
+      fd->usb.eep = get_le(r.data + 8, 4);
+      fd->usb.max_xfer = get_le(r.data + 12, 4);
+      fd->usb.use_interrupt_xfer = get_le(r.data + 16, 4);
+    }
+    return r.rc;
+  }
+
+  rc = serdev->open(port, pinfo, fd);
+  if(cx->trace_fp) {
+    put_le(data, fd->usb.rep, 4);
+    put_le(data + 4, fd->usb.wep, 4);
+    put_le(data + 8, fd->usb.eep, 4);
+    put_le(data + 12, fd->usb.max_xfer, 4);
+    put_le(data + 16, fd->usb.use_interrupt_xfer, 4);
+    trace_put(TR_OPEN, rc, 0, data, sizeof data);
+  }
+
+  return rc;
+}
+
+int serial_trace_setparams(const union filedescriptor *fd, long baud, unsigned long cflags) {
+  Trace_rec r;
+
+  if(cx->replay_buf)
+    return replay_next(TR_SETPARAMS, &r)? r.rc: 0;
+
+  int rc = serdev->setparams(fd, baud, cflags);
+
+  trace_put(TR_SETPARAMS, rc, baud, NULL, 0);
+  return rc;
+}
+
+void serial_trace_close(union filedescriptor *fd) {
+  Trace_rec r;
+
+  if(cx->replay_buf) {
+    replay_next(TR_CLOSE, &r);
+    return;
+  }
+  serdev->close(fd);
+  trace_put(TR_CLOSE, 0, 0, NULL, 0);
+}
+
+void serial_trace_rawclose(union filedescriptor *fd) {
+  Trace_rec r;
+
+  if(cx->replay_buf) {
+    replay_next(TR_RAWCLOSE, &r);
+    return;
+  }
+  serdev->rawclose(fd);
+  trace_put(TR_RAWCLOSE, 0, 0, NULL, 0);
+}
+
+int serial_trace_send(const union filedescriptor *fd, const unsigned char *buf, size_t buflen) {
+  Trace_rec r;
+
+  if(cx->replay_buf) {
+    if(cx->replay_diverged || !replay_next(TR_SEND, &r))
+      return -1;
+    if(r.len != buflen || memcmp(r.data, buf, buflen)) {
+      if(verbose >= MSG_TRACE) {
+        trace_buffer("recorded", r.data, r.len);
+        trace_buffer("sent", buf, buflen);
+      }
+      return replay_mismatch("sends different data", &r);
+    }
+    return r.rc;
+  }
+
+  int rc = serdev->send(fd, buf, buflen);
+
+  trace_put(TR_SEND, rc, buflen, buf, buflen);
+  return rc;
+}
+
+int serial_trace_recv(const union filedescriptor *fd, unsigned char *buf, size_t buflen) {
+  Trace_rec r;
+
+  if(cx->replay_buf) {
+    if(cx->replay_diverged || !replay_next(TR_RECV, &r))
+      return -1;
+    if((size_t) r.arg != buflen)
+      pmsg_notice2("replay record %d: driver receives %lu bytes, recording %d\n",
+        cx->replay_nrec, (unsigned long) buflen, r.arg);
+    memcpy(buf, r.data, r.len < buflen? r.len: buflen);
+    return r.rc;
+  }
+
+  int rc = serdev->recv(fd, buf, buflen);
+  // Serial devices return 0 for a full buffer, frame-based USB devices the number of bytes
+  size_t n = rc == 0? buflen: rc > 0 && (size_t) rc <= buflen? (size_t) rc: 0;
+
+  trace_put(TR_RECV, rc, buflen, buf, n);
+  return rc;
+}
+
+int serial_trace_drain(const union filedescriptor *fd, int display) {
+  Trace_rec r;
+
+  if(cx->replay_buf)
+    return replay_next(TR_DRAIN, &r)? r.rc: 0;
+
+  int rc = serdev->drain(fd, display);
+
+  trace_put(TR_DRAIN, rc, display, NULL, 0);
+  return rc;
+}
+
+int serial_trace_set_dtr_rts(const union filedescriptor *fd, int is_on) {
+  Trace_rec r;
+
+  if(cx->replay_buf)
+    return replay_next(TR_DTR_RTS, &r)? r.rc: 0;
+
+  int rc = serdev->set_dtr_rts(fd, is_on);
+
+  trace_put(TR_DTR_RTS, rc, is_on, NULL, 0);
+  return rc;
+}
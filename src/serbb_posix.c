@@ -126,8 +126,7 @@ static int serbb_setpin(const PROGRAMMER *pgm, int pinfunc, int value) {
     return -1;
   }
 
-  if(pgm->ispdelay > 1)
-    bitbang_delay(pgm->ispdelay);
+  bitbang_pin_delay(pgm);
 
   return 0;
 }
@@ -220,9 +219,6 @@ static int serbb_open(PROGRAMMER *pgm, const char *port) {
   int flags;
   int r;
 
-  if(pgm->bitclock)
-    pmsg_warning("-c %s does not support adjustable bitclock speed using -B; use -i instead\n", pgmid);
-
   if(bitbang_check_prerequisites(pgm) < 0)
     return -1;
 
@@ -792,28 +792,11 @@ static int serialupdi_paged_load(const PROGRAMMER *pgm, const AVRPART *p, const
     return -1;
   }
 
-  if((int) n_bytes > m->readsize) {
-    unsigned int read_offset = addr;
-    int remaining_bytes = n_bytes;
-    int read_bytes = 0;
-    int rc;
+  // One streamed read for the whole range; flash is read in words for twice the block size
+  if(mem_is_in_flash(m) && n_bytes > 2 && !(addr%2) && !(n_bytes%2))
+    return updi_read_data_words(pgm, m->offset + addr, m->buf + addr, n_bytes/2) < 0? -1: (int) n_bytes;
 
-    while(remaining_bytes > 0) {
-      rc = updi_read_data(pgm, m->offset + read_offset, m->buf + read_offset,
-        remaining_bytes > m->readsize? m->readsize: remaining_bytes);
-      if(rc < 0) {
-        pmsg_error("paged load operation failed\n");
-        return rc;
-      } else {
-        read_bytes += rc;
-        read_offset += m->readsize;
-        remaining_bytes -= m->readsize;
-      }
-    }
-    return read_bytes;
-  } else {
-    return updi_read_data(pgm, m->offset + addr, m->buf + addr, n_bytes);
-  }
+  return updi_read_data(pgm, m->offset + addr, m->buf + addr, n_bytes);
 }
 
 static int serialupdi_paged_write(const PROGRAMMER *pgm, const AVRPART *p, const AVRMEM *m,
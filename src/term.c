@@ -425,17 +425,18 @@ static unsigned char *readbuf(const PROGRAMMER *pgm, const AVRPART *p, int argc,
   }
 
   report_progress(0, 1, "Reading");
-  for(int j = 0; j < toread; j++) {
+  for(int j = 0, n; j < toread; j += n) {     // Read in chunks that wrap round at end of memory
     int addr = (whence + j)%maxsize;
-    int rc = pgm->read_byte_cached(pgm, p, mem, addr, &buf[j]);
 
-    if(rc != 0) {
+    n = toread - j < maxsize - addr? toread - j: maxsize - addr;
+    if(pgm->read_range_cached(pgm, p, mem, addr, buf + j, n) != 0) {
       report_progress(1, -1, NULL);
-      pmsg_error("(%s) error reading %s address 0x%05lx of part %s\n", cmd, mem->desc, (long) whence + j, p->desc);
+      pmsg_error("(%s) error reading %s range [0x%05x, 0x%05x] of part %s\n",
+        cmd, mem->desc, addr, addr + n - 1, p->desc);
       mmt_free(buf);
       return NULL;
     }
-    report_progress(j, toread, NULL);
+    report_progress(j + n, toread, NULL);
   }
   report_progress(1, 1, NULL);
 
@@ -882,34 +883,44 @@ static int cmd_write(const PROGRAMMER *pgm, const AVRPART *p, int argc, const ch
 
   if(0 < len + bytes_grown)
     report_progress(0, 1, avr_has_paged_access(pgm, p, mem)? "Caching": "Writing");
+  uint8_t *rbuf = mmt_malloc(len + bytes_grown + 1);
+
   for(i = 0; i < len + bytes_grown; i++) {
-    report_progress(i, len + bytes_grown, NULL);
     if(!tags[i])
       continue;
 
-    uint8_t b;
-    int rc = pgm->write_byte_cached(pgm, p, mem, addr + i, buf[i]);
+    int n = 1;                  // Write runs of tagged bytes in one go
+
+    while(i + n < len + bytes_grown && tags[i + n])
+      n++;
+
+    int rc = pgm->write_range_cached(pgm, p, mem, addr + i, buf + i, n);
 
-    if(rc == LIBAVRDUDE_SOFTFAIL) {
-      pmsg_warning("(write) programmer write protects %s address 0x%04x\n", mem->desc, addr + i);
-    } else if(rc) {
-      pmsg_error("(write) error writing 0x%02x at 0x%05x (rc = %d)\n", buf[i], addr + i, (int) rc);
-      // if(rc == -1)
-      //   imsg_error("write operation not supported on memory %s\n", mem->desc);
-    } else if(pgm->read_byte_cached(pgm, p, mem, addr + i, &b) < 0) {
+    if(rc && rc != LIBAVRDUDE_SOFTFAIL) {
+      pmsg_error("(write) error writing %d byte%s at 0x%05x (rc = %d)\n", n, str_plural(n), addr + i, (int) rc);
+    } else if(pgm->read_range_cached(pgm, p, mem, addr + i, rbuf, n) < 0) {
       pmsg_error("(write) readback from %s failed\n", mem->desc);
-    } else {                    // Read back byte b is now set
-      int bitmask = avr_mem_bitmask(p, mem, addr + i);
+    } else {                    // Read back bytes are now set
+      for(int k = 0; k < n; k++) {
+        int a = addr + i + k, bitmask = avr_mem_bitmask(p, mem, a);
 
-      if((b & bitmask) != (buf[i] & bitmask)) {
-        pmsg_error("(write) verification error writing 0x%02x at 0x%05x cell=0x%02x", buf[i], addr + i, b);
+        if((rbuf[k] & bitmask) == (buf[i + k] & bitmask))
+          continue;
+        if(rc == LIBAVRDUDE_SOFTFAIL && pgm->readonly && pgm->readonly(pgm, p, mem, a)) {
+          pmsg_warning("(write) programmer write protects %s address 0x%04x\n", mem->desc, a);
+          continue;
+        }
+        pmsg_error("(write) verification error writing 0x%02x at 0x%05x cell=0x%02x", buf[i + k], a, rbuf[k]);
         if(bitmask != 0xff)
           msg_error(" using bit mask 0x%02x", bitmask);
         msg_error("\n");
       }
     }
+    i += n - 1;
+    report_progress(i + 1, len + bytes_grown, NULL);
   }
   report_progress(1, 1, NULL);
+  mmt_free(rbuf);
 
   mmt_free(buf);
 
@@ -989,18 +1000,18 @@ static int cmd_save(const PROGRAMMER *pgm, const AVRPART *p, int argc, const cha
   }
   // Read memory from device/cache
   report_progress(0, 1, "Reading");
-  for(int i = 0; i < n; i++) {
-    for(int j = seglist[i].addr; j < seglist[i].addr + seglist[i].len; j++) {
-      int rc = pgm->read_byte_cached(pgm, p, mem, j, mem->buf + j);
+  for(int i = 0, done = 0; i < n; i++) {
+    int j = seglist[i].addr, len = seglist[i].len;
 
-      if(rc < 0) {
-        report_progress(1, -1, NULL);
-        pmsg_error("(save) error reading %s address 0x%0*x of part %s\n",
-          mem->desc, j < 16? 1: j < 256? 2: j < 65536? 4: 5, j, p->desc);
-        return -1;
-      }
-      report_progress(j, nbytes, NULL);
+    if(len > 0 && pgm->read_range_cached(pgm, p, mem, j, mem->buf + j, len) < 0) {
+      int e = j + len - 1;
+
+      report_progress(1, -1, NULL);
+      pmsg_error("(save) error reading %s range [0x%0*x, 0x%0*x] of part %s\n", mem->desc,
+        j < 16? 1: j < 256? 2: j < 65536? 4: 5, j, e < 16? 1: e < 256? 2: e < 65536? 4: 5, e, p->desc);
+      return -1;
     }
+    report_progress(done += len, nbytes, NULL);
   }
   report_progress(1, 1, NULL);
 
@@ -1133,6 +1144,14 @@ static int cmd_verify(const PROGRAMMER *pgm, const AVRPART *p, int argc, const c
   pgm->flush_cache(pgm, p);     // Flush cache before any device memory access
   int ret = do_op(pgm, p, &upd, UF_AUTO_ERASE | UF_NOHEADING);  // -V -U argv[1]:v:file
 
+  int nr;
+  const Mismatch_range *mr = avr_mismatches(&nr);
+
+  for(int k = 0; k < nr; k++)   // List which address ranges differ
+    term_out("%s %s %s%s\n", k? "        ": "mismatch", mr[k].memdesc,
+      str_ccinterval(mr[k].beg, mr[k].end), mr[k].ro? " (read only, ignored)": "");
+  avr_clear_mismatches();
+
   mmt_free(upd.filename);
   mmt_free(upd.memstr);
 
@@ -1305,11 +1324,14 @@ static int cmd_erase(const PROGRAMMER *pgm, const AVRPART *p, int argc, const ch
     }
 
     msg_info("[0x%04x, 0x%04x]; undo with abort\n", beg, end);
-    for(int addr = beg; addr <= end; addr++)
-      if(!pgm->readonly || !pgm->readonly(pgm, p, flm, addr))
-        if(pgm->write_byte_cached(pgm, p, flm, addr, 0xff) == -1)
-          return -1;
-    return 0;
+    unsigned char *ff = mmt_malloc(end - beg + 1);
+
+    memset(ff, 0xff, end - beg + 1);
+    // Write protected spots in between are left alone and yield a soft failure
+    rc = pgm->write_range_cached(pgm, p, flm, beg, ff, end - beg + 1);
+    mmt_free(ff);
+
+    return rc < 0 && rc != LIBAVRDUDE_SOFTFAIL? -1: 0;
   }
 
   if(rc) {
@@ -2758,8 +2780,15 @@ static int do_cmd(const PROGRAMMER *pgm, const AVRPART *p, int argc, const char
         }
       }
 
-  if(matches == 1)
-    return cmd[hold].func(pgm, p, argc, argv);
+  if(matches == 1) {
+    int noprogress = cx->avr_range_noprogress, ret;
+
+    cx->avr_range_noprogress = 1;       // Commands report their own progress
+    ret = cmd[hold].func(pgm, p, argc, argv);
+    cx->avr_range_noprogress = noprogress;
+
+    return ret;
+  }
 
   pmsg_error("(cmd) command %s is %s", argv[0], matches > 1? "ambiguous": "invalid");
   if(matches > 1)
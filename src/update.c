@@ -463,6 +463,32 @@ int update_dryrun(const AVRPART *p, UPDATE *upd) {
   return ret;
 }
 
+/*
+ * Decode the input file of a -U write or verify operation once so that
+ * sessions with their own copy of part p can share the image, see
+ * fileio_share(); p must have its memories initialised.
+ *
+ * Return 0 on success or when there is nothing to share, and < 0 on error
+ */
+int update_share_input(const AVRPART *p, const UPDATE *upd) {
+  if(upd->cmdline || !upd->memstr || (upd->op != DEVICE_WRITE && upd->op != DEVICE_VERIFY))
+    return 0;
+
+  int multi = is_multimem(upd->memstr), rc;
+  AVRMEM *mem = multi? fileio_any_memory("any"): avr_locate_mem(p, upd->memstr);
+
+  if(!mem)                      // Session will skip this -U
+    return 0;
+  // Same as update_all_from_file()
+  rc = fileio_share(upd->op == DEVICE_WRITE? FIO_READ: FIO_READ_FOR_VERIFY, upd->filename, upd->format, p, mem);
+  if(rc < 0)
+    pmsg_error("reading from file %s failed\n", str_infilename(upd->filename));
+  if(multi)
+    avr_free_mem(mem);
+
+  return rc < 0? rc: 0;
+}
+
 static int update_avr_write(const PROGRAMMER *pgm, const AVRPART *p, const AVRMEM *mem,
   const UPDATE *upd, enum updateflags flags, int size, int multiple) {
 
@@ -523,12 +549,19 @@ static int update_avr_write(const PROGRAMMER *pgm, const AVRPART *p, const AVRME
   } else {
     if(pbar)
       report_progress(0, 1, "Writing");
+    cx->avr_pages_checked = cx->avr_pages_skipped = 0;
+    double start = avr_timestamp();
+
     rc = avr_write_mem(pgm, p, mem, size, (flags & UF_AUTO_ERASE) != 0);
+    avr_phase_end(AVR_PH_WRITE, start);
     report_progress(1, 1, NULL);
   }
 
   if(rc < 0)
     return -1;
+  if(cx->avr_pages_checked)
+    pmsg_info("%d of %d %s page%s unchanged on device and not written\n", cx->avr_pages_skipped,
+      cx->avr_pages_checked, m_name, str_plural(cx->avr_pages_checked));
   // @@@ has there has been output in the meantime to make the ", x bytes written" look out of place?
   if(pbar && !(flags & UF_VERIFY))
     pmsg_info("%d byte%s of %s written", fs.nbytes, str_plural(fs.nbytes), m_name);
@@ -552,16 +585,19 @@ static int update_avr_verify(const PROGRAMMER *pgm, const AVRPART *p, const AVRM
   led_set(pgm, LED_VFY);
   if(pbar)
     report_progress(0, 1, caption);
-  int rc = avr_read_mem(pgm, p, mem, v);
+  double start = avr_timestamp();
+  int rc = avr_read_mem_verify(pgm, p, mem, v);
 
   report_progress(1, 1, NULL);
   if(rc < 0) {
+    avr_phase_end(AVR_PH_VERIFY, start);
     pmsg_error("unable to read all of %s (rc = %d)\n", m_name, rc);
     led_set(pgm, LED_ERR);
     goto error;
   }
 
   rc = avr_verify_mem(pgm, p, v, mem, size);
+  avr_phase_end(AVR_PH_VERIFY, start);
   if(rc < 0) {
     pmsg_error("%s verification mismatch\n", mem->desc);
     led_set(pgm, LED_ERR);
@@ -658,6 +694,7 @@ int do_op(const PROGRAMMER *pgm, const AVRPART *p, const UPDATE *upd, enum updat
 
   int allsize, len, maxrlen = 0, ns = 0;
 
+  avr_clear_mismatches();       // Only keep the mismatch ranges of this operation
   if(is_multimem(umstr)) {
     umemlist = memory_list(umstr, pgm, p, &ns, &rwvsoftfail, NULL);
 
@@ -720,8 +757,11 @@ int do_op(const PROGRAMMER *pgm, const AVRPART *p, const UPDATE *upd, enum updat
         const char *m_name = avr_mem_name(p, m);
 
         report_progress(0, 1, str_ccprintf(" - %-*s", maxrlen, m_name));
+        double start = avr_timestamp();
         int ret = avr_read_mem(pgm, p, m, NULL);
 
+        avr_phase_end(AVR_PH_READ, start);
+
         report_progress(1, 1, NULL);
         if(ret < 0) {
           pmsg_warning("unable to read %s (ret = %d), skipping...\n", m_name, ret);
@@ -755,7 +795,10 @@ int do_op(const PROGRAMMER *pgm, const AVRPART *p, const UPDATE *upd, enum updat
       pmsg_info("reading %s memory ...\n", mem_desc);
       if(mem->size > 32)
         report_progress(0, 1, rcap);
+      double start = avr_timestamp();
+
       rc = avr_read(pgm, p, umstr, 0);
+      avr_phase_end(AVR_PH_READ, start);
       report_progress(1, 1, NULL);
       if(rc < 0) {
         pmsg_error("unable to read all of %s (rc = %d)\n", mem_desc, rc);
@@ -80,6 +80,7 @@
 #define UPDI_ASI_CRC_STATUS 0x0C
 
 #define UPDI_CTRLA_IBDLY_BIT    7
+#define UPDI_CTRLA_RSD_BIT      3
 #define UPDI_CTRLB_CCDETDIS_BIT 3
 #define UPDI_CTRLB_UPDIDIS_BIT  2
 
@@ -395,7 +395,7 @@ int updi_link_ld_ptr_inc16(const PROGRAMMER *pgm, unsigned char *buffer, uint16_
     pmsg_debug("LD_PTR_INC send operation failed\n");
     return -1;
   }
-  return updi_physical_recv(pgm, buffer, words << 2);
+  return updi_physical_recv(pgm, buffer, words << 1);
 }
 
 int updi_link_st_ptr_inc(const PROGRAMMER *pgm, unsigned char *buffer, uint16_t size) {
@@ -626,6 +626,126 @@ int updi_link_st_ptr_inc16_RSD(const PROGRAMMER *pgm, unsigned char *buffer, uin
   return 0;
 }
 
+/*
+ * Streaming ST_PTR + REPEAT + LD/ST *ptr++ for any number of bytes
+ *
+ * Response signatures are disabled for the duration (the RSD trick of
+ * updi_link_st_ptr_inc16_RSD()), so the target does not ACK the pointer
+ * setting nor the stores, and all commands that need no answer are coalesced
+ * into one serial write. UPDI is half-duplex on a single wire: a read still
+ * costs one exchange per block of UPDI_MAX_REPEAT_SIZE loads, but that is one
+ * write of REPEAT + LD and one read of the whole block instead of three
+ * separate commands each waiting for their echo and ACK.
+ */
+
+#define UPDI_CTRLA_SESSION (1 << UPDI_CTRLA_IBDLY_BIT)    // As set by updi_link_init_session_parameters()
+#define UPDI_CTRLA_STREAM (UPDI_CTRLA_SESSION | 1 << UPDI_CTRLA_RSD_BIT)
+
+// Put STCS CTRLA into buf and return the number of bytes
+static int updi_link_put_ctrla(unsigned char *buf, uint8_t value) {
+  buf[0] = UPDI_PHY_SYNC;
+  buf[1] = UPDI_STCS | UPDI_CS_CTRLA;
+  buf[2] = value;
+  return 3;
+}
+
+// Put ST_PTR address into buf and return the number of bytes
+static int updi_link_put_st_ptr(const PROGRAMMER *pgm, unsigned char *buf, uint32_t address) {
+  int is24 = updi_get_datalink_mode(pgm) == UPDI_LINK_MODE_24BIT;
+
+  buf[0] = UPDI_PHY_SYNC;
+  buf[1] = UPDI_STS | UPDI_ST | UPDI_PTR_ADDRESS | (is24? UPDI_DATA_24: UPDI_DATA_16);
+  buf[2] = address & 0xFF;
+  buf[3] = (address >> 8) & 0xFF;
+  buf[4] = (address >> 16) & 0xFF;
+  return is24? 5: 4;
+}
+
+// Put REPEAT (if needed) and the LD/ST *ptr++ instruction into buf and return the number of bytes
+static int updi_link_put_repeat(unsigned char *buf, int reps, uint8_t instruction) {
+  int n = 0;
+
+  if(reps > 1) {
+    buf[n++] = UPDI_PHY_SYNC;
+    buf[n++] = UPDI_REPEAT | UPDI_REPEAT_BYTE;
+    buf[n++] = (reps - 1) & 0xFF;
+  }
+  buf[n++] = UPDI_PHY_SYNC;
+  buf[n++] = instruction;
+  return n;
+}
+
+// Read size bytes from address onwards using LD8 or, if words is set, LD16; return size or -1
+int updi_link_ld_ptr_stream(const PROGRAMMER *pgm, uint32_t address, unsigned char *buffer, uint32_t size,
+  int words) {
+
+  unsigned char cmd[3 + 5 + 3 + 2];
+  int n, width = words? 2: 1, ret = 0;
+
+  pmsg_debug("LD%d stream of %lu bytes from 0x%06X\n", 8*width, (unsigned long) size, address);
+  if(size%width) {
+    pmsg_debug("odd number of bytes for LD16 stream\n");
+    return -1;
+  }
+
+  n = updi_link_put_ctrla(cmd, UPDI_CTRLA_STREAM);
+  n += updi_link_put_st_ptr(pgm, cmd + n, address);
+  for(uint32_t done = 0; done < size; n = 0) {
+    int reps = (size - done)/width;
+
+    if(reps > UPDI_MAX_REPEAT_SIZE)
+      reps = UPDI_MAX_REPEAT_SIZE;
+    n += updi_link_put_repeat(cmd + n, reps, UPDI_LD | UPDI_PTR_INC | (words? UPDI_DATA_16: UPDI_DATA_8));
+    if(updi_physical_send(pgm, cmd, n) < 0) {
+      pmsg_debug("LD stream send operation failed\n");
+      ret = -1;
+      break;
+    }
+    if(updi_physical_recv(pgm, buffer + done, reps*width) < 0) {
+      pmsg_debug("LD stream recv operation failed at 0x%06lX\n", (unsigned long) (address + done));
+      ret = -1;
+      break;
+    }
+    done += reps*width;
+  }
+
+  // Re-enable response signatures whether or not the stream succeeded
+  if(updi_link_stcs(pgm, UPDI_CS_CTRLA, UPDI_CTRLA_SESSION) < 0)
+    ret = -1;
+
+  return ret < 0? ret: (int) size;
+}
+
+// Write words 16-bit words from buffer to address onwards in one serial write; return 0 or -1
+int updi_link_st_ptr_stream16(const PROGRAMMER *pgm, uint32_t address, unsigned char *buffer, uint32_t words) {
+  uint32_t nblocks = (words + UPDI_MAX_REPEAT_SIZE - 1)/UPDI_MAX_REPEAT_SIZE;
+  size_t len = 3 + 5 + nblocks*(3 + 2) + 2*words + 3;
+  unsigned char *cmd = mmt_malloc(len);
+  int n, ret = 0;
+
+  pmsg_debug("ST16 stream of %lu words to 0x%06X\n", (unsigned long) words, address);
+
+  n = updi_link_put_ctrla(cmd, UPDI_CTRLA_STREAM);
+  n += updi_link_put_st_ptr(pgm, cmd + n, address);
+  for(uint32_t done = 0; done < words;) {
+    int reps = words - done > UPDI_MAX_REPEAT_SIZE? UPDI_MAX_REPEAT_SIZE: (int) (words - done);
+
+    n += updi_link_put_repeat(cmd + n, reps, UPDI_ST | UPDI_PTR_INC | UPDI_DATA_16);
+    memcpy(cmd + n, buffer + 2*done, 2*reps);
+    n += 2*reps;
+    done += reps;
+  }
+  n += updi_link_put_ctrla(cmd + n, UPDI_CTRLA_SESSION);
+
+  if(updi_physical_send(pgm, cmd, n) < 0) {
+    pmsg_debug("ST16 stream send operation failed\n");
+    ret = -1;
+  }
+  mmt_free(cmd);
+
+  return ret;
+}
+
 int updi_link_repeat(const PROGRAMMER *pgm, uint16_t repeats) {
 /*
     def repeat(self, repeats):
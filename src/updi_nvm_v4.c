@@ -450,6 +450,19 @@ static int nvm_write_V4(const PROGRAMMER *pgm, const AVRPART *p, uint32_t addres
   return 0;
 }
 
+// Return 0 if NVM controller ready, 1 if busy and -1 on write error
+static int nvm_poll_V4(const PROGRAMMER *pgm, const AVRPART *p) {
+  uint8_t status;
+
+  if(updi_read_byte(pgm, p->nvm_base + UPDI_V4_NVMCTRL_STATUS, &status) < 0)
+    return 1;                   // Try again
+  if(status & UPDI_V4_NVM_STATUS_WRITE_ERROR_MASK) {
+    pmsg_error("unable to write NVM status, error %d\n", status >> UPDI_V4_NVM_STATUS_WRITE_ERROR_BIT);
+    return -1;
+  }
+  return !!(status & ((1 << UPDI_V4_NVM_STATUS_EEPROM_BUSY_BIT) | (1 << UPDI_V4_NVM_STATUS_FLASH_BUSY_BIT)));
+}
+
 int updi_nvm_wait_ready_V4(const PROGRAMMER *pgm, const AVRPART *p) {
 /*
     def wait_nvm_ready(self, timeout_ms=100):
@@ -477,26 +490,10 @@ int updi_nvm_wait_ready_V4(const PROGRAMMER *pgm, const AVRPART *p) {
         self.logger.error("Wait NVM ready timed out")
         return False
 */
-  unsigned long start_time;
-  unsigned long current_time;
-  uint8_t status;
-
-  start_time = avr_ustimestamp();
-  do {
-    if(updi_read_byte(pgm, p->nvm_base + UPDI_V4_NVMCTRL_STATUS, &status) >= 0) {
-      if(status & UPDI_V4_NVM_STATUS_WRITE_ERROR_MASK) {
-        pmsg_error("unable to write NVM status, error %d\n", status >> UPDI_V4_NVM_STATUS_WRITE_ERROR_BIT);
-        return -1;
-      }
-      if(!(status & ((1 << UPDI_V4_NVM_STATUS_EEPROM_BUSY_BIT) | (1 << UPDI_V4_NVM_STATUS_FLASH_BUSY_BIT)))) {
-        return 0;
-      }
-    }
-    current_time = avr_ustimestamp();
-  } while((current_time - start_time) < 10000000);
+  int rc = avr_nvm_wait(pgm, p, nvm_poll_V4, updi_get_nvm_cmd(pgm), NULL, AVR_NVM_TIMEOUT_US);
 
-  pmsg_error("wait NVM ready timed out\n");
-  return -1;
+  updi_set_nvm_cmd(pgm, UPDI_V4_NVMCTRL_CTRLA_NOCMD); // Nothing pending for next wait
+  return rc;
 }
 
 int updi_nvm_command_V4(const PROGRAMMER *pgm, const AVRPART *p, uint8_t command) {
@@ -511,6 +508,7 @@ int updi_nvm_command_V4(const PROGRAMMER *pgm, const AVRPART *p, uint8_t command
         return self.readwrite.write_byte(self.device.nvmctrl_address + constants.UPDI_NVMCTRL_CTRLA, command)
 */
   pmsg_debug("NVMCMD %d executing\n", command);
+  updi_set_nvm_cmd(pgm, command);
 
   return updi_write_byte(pgm, p->nvm_base + UPDI_V4_NVMCTRL_CTRLA, command);
 }
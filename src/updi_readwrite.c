@@ -146,22 +146,14 @@ int updi_read_data(const PROGRAMMER *pgm, uint32_t address, uint8_t *buffer, uin
 */
   pmsg_debug("reading %d bytes from 0x%06X\n", size, address);
 
-  if(size > UPDI_MAX_REPEAT_SIZE) {
-    pmsg_debug("cannot read that many bytes in one go\n");
-    return -1;
-  }
+  // Stream multi-byte reads: pointer, repeat and load go out in one write
+  if(size > 1)
+    return updi_link_ld_ptr_stream(pgm, address, buffer, size, 0);
 
   if(updi_link_st_ptr(pgm, address) < 0) {
     pmsg_debug("ST_PTR operation failed\n");
     return -1;
   }
-
-  if(size > 1) {
-    if(updi_link_repeat(pgm, size) < 0) {
-      pmsg_debug("repeat operation failed\n");
-      return -1;
-    }
-  }
   return updi_link_ld_ptr_inc(pgm, buffer, size);
 }
 
@@ -243,24 +235,15 @@ int updi_read_data_words(const PROGRAMMER *pgm, uint32_t address, uint8_t *buffe
         # Do the read
         return self.datalink.ld_ptr_inc16(words)
 */
-  pmsg_debug("reading %d words from 0x%06X", size, address);
+  pmsg_debug("reading %d words from 0x%06X\n", size, address);
 
-  if(size > (UPDI_MAX_REPEAT_SIZE >> 1)) {
-    pmsg_debug("cannot read that many words in one go\n");
-    return -1;
-  }
+  if(size > 1)
+    return updi_link_ld_ptr_stream(pgm, address, buffer, 2*size, 1);
 
   if(updi_link_st_ptr(pgm, address) < 0) {
     pmsg_debug("ST_PTR operation failed\n");
     return -1;
   }
-
-  if(size > 1) {
-    if(updi_link_repeat(pgm, size) < 0) {
-      pmsg_debug("repeat operation failed\n");
-      return -1;
-    }
-  }
   return updi_link_ld_ptr_inc16(pgm, buffer, size);
 }
 
@@ -292,13 +275,6 @@ int updi_write_data_words(const PROGRAMMER *pgm, uint32_t address, uint8_t *buff
   if(size == 2) {
     return updi_link_st16(pgm, address, buffer[0] + (buffer[1] << 8));
   }
-  if(size > UPDI_MAX_REPEAT_SIZE << 1) {
-    pmsg_debug("invalid length\n");
-    return -1;
-  }
-  if(updi_link_st_ptr(pgm, address) < 0) {
-    pmsg_debug("ST_PTR operation failed\n");
-    return -1;
-  }
-  return updi_link_st_ptr_inc16_RSD(pgm, buffer, size >> 1, -1);
+  // Pointer, repeats and data go out in one write with response signatures disabled
+  return updi_link_st_ptr_stream16(pgm, address, buffer, size >> 1);
 }
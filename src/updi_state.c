@@ -54,3 +54,11 @@ updi_rts_mode updi_get_rts_mode(const PROGRAMMER *pgm) {
 void updi_set_rts_mode(const PROGRAMMER *pgm, updi_rts_mode mode) {
   ((updi_state *) (pgm->cookie))->rts_mode = mode;
 }
+
+uint8_t updi_get_nvm_cmd(const PROGRAMMER *pgm) {
+  return ((updi_state *) (pgm->cookie))->nvm_cmd;
+}
+
+void updi_set_nvm_cmd(const PROGRAMMER *pgm, uint8_t cmd) {
+  ((updi_state *) (pgm->cookie))->nvm_cmd = cmd;
+}
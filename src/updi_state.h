@@ -69,6 +69,7 @@ typedef struct {
   updi_datalink_mode datalink_mode;
   updi_nvm_mode nvm_mode;
   updi_rts_mode rts_mode;
+  uint8_t nvm_cmd;              // NVM command pending completion, keys avr_nvm_wait()
 } updi_state;
 
 #ifdef __cplusplus
@@ -82,6 +83,8 @@ extern "C" {
   void updi_set_nvm_mode(const PROGRAMMER *pgm, updi_nvm_mode mode);
   updi_rts_mode updi_get_rts_mode(const PROGRAMMER *pgm);
   void updi_set_rts_mode(const PROGRAMMER *pgm, updi_rts_mode mode);
+  uint8_t updi_get_nvm_cmd(const PROGRAMMER *pgm);
+  void updi_set_nvm_cmd(const PROGRAMMER *pgm, uint8_t cmd);
 
 #ifdef __cplusplus
 }
@@ -319,7 +319,9 @@ typedef struct {
       nometadata,               // Don't support metadata at all
       noautoreset,              // Don't reset the board after opening the serial port
       delay,                    // Additional delay [ms] after resetting the board, can be negative
-      strict;                   // Use strict synchronisation protocol
+      strict,                   // Use strict synchronisation protocol
+      autobaud,                 // Probe for the fastest baud rate an autobaud bootloader sustains
+      maxbaud;                  // Highest baud rate to try for autobaud
 
   char title[254];              // Use instead of filename for metadata - same size as filename
   char iddesc[64];              // Location of Urclock ID, eg F.12324.6 or E.-4.4 (default E.257.6)
@@ -2244,17 +2246,8 @@ static void urclock_disable(const PROGRAMMER *pgm) {
 }
 
 
-static int urclock_open(PROGRAMMER *pgm, const char *port) {
-  if(pgm->bitclock)
-    pmsg_warning("-c %s does not support adjustable bitclock speed; ignoring -B\n", pgmid);
-
-  union pinfo pinfo;
-  pgm->port = port;
-  pinfo.serialinfo.baud = pgm->baudrate? pgm->baudrate: 115200;
-  pinfo.serialinfo.cflags = SERIAL_8N1;
-  if(serial_open(port, pinfo, &pgm->fd) == -1)
-    return -1;
-
+// Reset the board through DTR/RTS unless -x noautoreset and wait until it comes out of reset
+static void urclock_reset(const PROGRAMMER *pgm) {
   if(!ur.noautoreset) {
     // This code assumes a negative-logic USB to TTL serial adapter
     // Set RTS/DTR high to discharge the series-capacitor, if present
@@ -2270,6 +2263,221 @@ static int urclock_open(PROGRAMMER *pgm, const char *port) {
 
   if((120+ur.delay) > 0)
     usleep((120+ur.delay)*1000); // Wait until board comes out of reset
+}
+
+
+/*
+ * Autobaud urboot bootloaders (v7.7+, capability 'a') measure the baud rate from the first sync
+ * byte after reset, so the host can choose any rate the UART of the part and the serial adapter
+ * sustain. -x autobaud probes the rates below in ascending order, each time resetting the board,
+ * getting in sync and then checking UR_BAUD_PROBES further sync requests. The fastest rate
+ * without any error is locked in for the session and remembered per port and part in a small
+ * state file, so later sessions only need to confirm it. Bootloaders with fixed baud rates, eg,
+ * optiboot, fail the first probe above the -b rate and the session carries on at that rate.
+ */
+#define UR_BAUD_PROBES 32
+#define UR_BAUD_FILE "avrdude/urclock-baud"
+
+static const long ur_bauds[] = {
+  230400, 250000, 460800, 500000, 921600, 1000000, 1500000, 2000000,
+};
+
+// Return the state file with cached baud rates (to be freed by caller) or NULL
+static char *ur_baudfile(void) {
+#if !defined(WIN32)
+  const char *dir;
+
+  if((dir = getenv("XDG_STATE_HOME")) && *dir)
+    return mmt_sprintf("%s/" UR_BAUD_FILE, dir);
+  if((dir = getenv("HOME")) && *dir)
+    return mmt_sprintf("%s/.local/state/" UR_BAUD_FILE, dir);
+#endif
+
+  return NULL;
+}
+
+// Key for the state file: port and part (* if not known yet)
+static char *ur_baudkey(const PROGRAMMER *pgm) {
+  return mmt_sprintf("%s %s", pgm->port, partdesc && *partdesc? partdesc: "*");
+}
+
+// Return the cached baud rate for this port and part or 0 if there is none
+static long ur_getcachedbaud(const PROGRAMMER *pgm) {
+  char *fname = ur_baudfile(), *key = ur_baudkey(pgm), line[1024];
+  size_t klen = strlen(key);
+  long baud = 0;
+  FILE *fp;
+
+  if(fname && (fp = fopen(fname, "r"))) {
+    while(fgets(line, sizeof line, fp))
+      if(str_starts(line, key) && line[klen] == ' ') {
+        baud = strtol(line + klen + 1, NULL, 10);
+        break;
+      }
+    fclose(fp);
+  }
+  mmt_free(fname);
+  mmt_free(key);
+
+  return baud > 0? baud: 0;
+}
+
+// Replace the cached baud rate for this port and part (baud = 0 removes the entry)
+static void ur_putcachedbaud(const PROGRAMMER *pgm, long baud) {
+  char *fname = ur_baudfile(), *key = ur_baudkey(pgm), *tmp = NULL, line[1024];
+  size_t klen = strlen(key);
+  FILE *in, *out;
+
+  if(!fname)
+    goto done;
+
+#if !defined(WIN32)
+  for(char *p = strchr(fname + 1, '/'); p; p = strchr(p + 1, '/')) {
+    *p = 0;
+    mkdir(fname, 0777);         // Create missing parent directories, ignoring errors
+    *p = '/';
+  }
+#endif
+
+  tmp = mmt_sprintf("%s.%ld", fname, (long) getpid());
+  if(!(out = fopen(tmp, "w"))) {
+    pmsg_notice("cannot write baud rate cache %s: %s\n", tmp, strerror(errno));
+    goto done;
+  }
+  if((in = fopen(fname, "r"))) {
+    while(fgets(line, sizeof line, in))
+      if(!(str_starts(line, key) && line[klen] == ' '))
+        fputs(line, out);
+    fclose(in);
+  }
+  if(baud > 0)
+    fprintf(out, "%s %ld\n", key, baud);
+  if(fclose(out) || rename(tmp, fname)) {
+    pmsg_notice("cannot update baud rate cache %s: %s\n", fname, strerror(errno));
+    unlink(tmp);
+  }
+
+done:
+  mmt_free(tmp);
+  mmt_free(fname);
+  mmt_free(key);
+}
+
+/*
+ * Reset the board and try to get in sync at the given baud rate; return the number of failed
+ * sync probes out of UR_BAUD_PROBES or -1 if the bootloader did not respond at all
+ */
+static int urclock_trybaud(const PROGRAMMER *pgm, long baud) {
+  unsigned char iob[2], insync = 0, ok = 0, seen = 0;
+  const AVRPART *part = partdesc? locate_part(part_list, partdesc): NULL;
+  double kbd = baud/1000.0;
+  int errs = 0;
+
+  if(serial_setparams(&pgm->fd, baud, SERIAL_8N1) < 0)
+    return -1;
+  urclock_reset(pgm);
+
+  serial_recv_timeout = 25 + (kbd < 115? 160/kbd: 0);
+  serial_drain_timeout = 20 + (kbd < 115? 80/kbd: 0);
+  ur.sync_silence = 2;
+
+  // Same sync sequence as urclock_getsync() but without the long retries for slow boards
+  for(int attempt = 0; attempt < 4 && seen < 2; attempt++) {
+    iob[0] = attempt == 0 && part && part->autobaud_sync? part->autobaud_sync:
+      attempt == 0 || ur.strict? Cmnd_STK_GET_SYNC: Sync_CRC_EOP;
+    iob[1] = Sync_CRC_EOP;
+    if(urclock_send(pgm, iob, 2) < 0 || urclock_recv(pgm, iob, 2) < 0)
+      continue;
+    if(seen && iob[0] == insync && iob[1] == ok && iob[0] != iob[1])
+      seen = 2;
+    else {
+      insync = iob[0], ok = iob[1], seen = 1;
+      serial_drain(&pgm->fd, 0);
+    }
+  }
+
+  if(seen == 2) {
+    for(int i = 0; i < UR_BAUD_PROBES; i++) {
+      iob[0] = Cmnd_STK_GET_SYNC;
+      iob[1] = Sync_CRC_EOP;
+      if(urclock_send(pgm, iob, 2) < 0 || urclock_recv(pgm, iob, 2) < 0 || iob[0] != insync || iob[1] != ok) {
+        errs++;
+        serial_drain(&pgm->fd, 0);
+      }
+    }
+    pmsg_notice("%ld baud: %d of %d sync probes failed\n", baud, errs, UR_BAUD_PROBES);
+  } else
+    pmsg_notice("%ld baud: no sync\n", baud);
+
+  ur.sync_silence = 0;
+
+  return seen == 2? errs: -1;
+}
+
+// Find fastest reliable baud rate for an autobaud bootloader and leave it in sync at that rate
+static int urclock_autobaud(PROGRAMMER *pgm) {
+  long base = pgm->baudrate? pgm->baudrate: 115200, best = 0, cached = ur_getcachedbaud(pgm);
+  long maxbaud = ur.maxbaud > 0? ur.maxbaud: 2000000;
+
+  if(cached) {
+    if(urclock_trybaud(pgm, cached) == 0)
+      best = cached;
+    else
+      pmsg_notice("cached baud rate %ld no longer works; probing again\n", cached);
+  }
+
+  if(!best) {
+    if(urclock_trybaud(pgm, base) < 0) {
+      pmsg_warning("no sync at %ld baud; skipping -x autobaud\n", base);
+      ur_putcachedbaud(pgm, 0);
+      if(serial_setparams(&pgm->fd, base, SERIAL_8N1) < 0)
+        return -1;
+      urclock_reset(pgm);
+      return 0;
+    }
+    best = base;
+    int insync = 1;             // Is the bootloader in sync at best?
+    for(size_t i = 0; i < sizeof ur_bauds/sizeof *ur_bauds; i++) {
+      if(ur_bauds[i] <= base || ur_bauds[i] > maxbaud)
+        continue;
+      if(urclock_trybaud(pgm, ur_bauds[i]) != 0) {
+        insync = 0;
+        break;
+      }
+      best = ur_bauds[i];
+    }
+    if(!insync && urclock_trybaud(pgm, best) < 0)
+      return -1;
+    ur_putcachedbaud(pgm, best);
+  }
+
+  if(best != base)
+    pmsg_notice("using %ld baud for this session\n", best);
+  pgm->baudrate = best;
+  ur.gs.seen = 0;
+
+  return 0;
+}
+
+
+static int urclock_open(PROGRAMMER *pgm, const char *port) {
+  if(pgm->bitclock)
+    pmsg_warning("-c %s does not support adjustable bitclock speed; ignoring -B\n", pgmid);
+
+  union pinfo pinfo;
+  pgm->port = port;
+  pinfo.serialinfo.baud = pgm->baudrate? pgm->baudrate: 115200;
+  pinfo.serialinfo.cflags = SERIAL_8N1;
+  if(serial_open(port, pinfo, &pgm->fd) == -1)
+    return -1;
+
+  if(ur.autobaud && ur.noautoreset)
+    pmsg_warning("-x autobaud needs to reset the board; ignoring -x autobaud\n");
+  if(ur.autobaud && !ur.noautoreset) {
+    if(urclock_autobaud(pgm) < 0)
+      return -1;
+  } else
+    urclock_reset(pgm);
 
   pmsg_debug("%4lld ms: enter urclock_getsync()\n", (long long) avr_mstimestamp());
   if(urclock_getsync(pgm) < 0)
@@ -2486,9 +2694,11 @@ static int urclock_parseextparms(const PROGRAMMER *pgm, LISTID extparms) {
     {"nodate", &ur.nodate, NA,            "Do not store application filename and no date either"},
     {"nostore", &ur.nostore, NA,          "Do not store metadata except a flag saying so"},
     {"nometadata", &ur.nometadata, NA,    "Do not support metadata at all"},
-    {"noautoreset", &ur.nometadata, NA,   "Do not reset the board after opening the serial port"},
+    {"noautoreset", &ur.noautoreset, NA,  "Do not reset the board after opening the serial port"},
     {"delay", &ur.delay, ARG,             "Additional <n> ms delay after reset, can be negative"},
     {"strict", &ur.strict, NA,            "Use strict synchronisation protocol"},
+    {"autobaud", &ur.autobaud, NA,        "Probe for and cache fastest baud rate of autobaud b/loader"},
+    {"maxbaud", &ur.maxbaud, ARG,         "Highest baud rate that -x autobaud tries (default 2000000)"},
     {"help", &help, NA,                   "Show this help menu and exit"},
   };
 
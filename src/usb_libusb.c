@@ -21,7 +21,9 @@
 
 #include <ac_cfg.h>
 
-#if defined(HAVE_LIBUSB)
+#include "usbdevs.h"
+
+#if defined(HAVE_LIBUSB) && !defined(USE_LIBUSB_1_0_SERDEV)
 #include <ctype.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -41,8 +43,6 @@
 #include "avrdude.h"
 #include "libavrdude.h"
 
-#include "usbdevs.h"
-
 #if defined(WIN32)
 
 // Someone has defined interface to struct in Cygwin
@@ -462,4 +462,4 @@ struct serial_device usb_serdev_frame = {
   .drain = usbdev_drain,
   .flags = SERDEV_FL_NONE,
 };
-#endif                          // HAVE_LIBUSB
+#endif                          // HAVE_LIBUSB && !USE_LIBUSB_1_0_SERDEV
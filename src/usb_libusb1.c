@@ -0,0 +1,584 @@
+/*
+ * avrdude - A Downloader/Uploader for AVR device programmers
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * USB interface via the asynchronous libusb-1.0 API for avrdude
+ *
+ * Where libusb-1.0 is available this file provides usb_serdev and
+ * usb_serdev_frame instead of the libusb-0.1 implementation in usb_libusb.c.
+ * Each IN endpoint in use keeps USB1_NIN transfers of max_xfer bytes queued
+ * with libusb_submit_transfer(), so the host controller collects the answer
+ * of the device while avrdude is still sending or processing; completed
+ * transfers are consumed in submission order and then resubmitted. A frame
+ * to send is split into max_xfer packets exactly as before, but up to
+ * USB1_NOUT of them are in flight at the same time. Events are handled in
+ * the calling thread whenever it waits for a transfer: queued URBs progress
+ * in the kernel regardless, and no other thread touches the session state.
+ */
+
+#include <ac_cfg.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+
+#include "avrdude.h"
+#include "libavrdude.h"
+
+#include "usbdevs.h"
+
+#if defined(USE_LIBUSB_1_0_SERDEV)
+
+#if defined(HAVE_LIBUSB_1_0_LIBUSB_H)
+#include <libusb-1.0/libusb.h>
+#else
+#include <libusb.h>
+#endif
+
+#define USB1_NIN      4         // Transfers queued per IN endpoint
+#define USB1_NOUT    16         // Max OUT packets in flight per send
+#define USB1_NEP      4         // Max IN endpoints with a queue
+#define USB1_TIMEOUT 10000      // Time out in ms for a transfer to complete
+
+typedef struct {
+  struct libusb_transfer *xfer;
+  unsigned char *buf;
+  int done;                     // Set by usb1_callback() on completion or cancellation
+} Usb1_slot;
+
+typedef struct {                // Queue of IN transfers for one endpoint
+  int ep;
+  Usb1_slot slot[USB1_NIN];
+  int head;                     // Oldest transfer, ie, next to complete
+  int ptr;                      // Bytes of the head transfer already consumed by usb1_recv()
+} Usb1_inq;
+
+typedef struct {
+  libusb_context *ctx;
+  libusb_device_handle *dev;
+  int iface, max_xfer, interrupt;
+  Usb1_inq inq[USB1_NEP];
+  int ninq;
+} Usb1_dev;
+
+static void LIBUSB_CALL usb1_callback(struct libusb_transfer *xfer) {
+  *(int *) xfer->user_data = 1;
+}
+
+// Handle events until *done is set; return -1 on time out or error
+static int usb1_wait(Usb1_dev *u, int *done, int timeout) {
+  uint64_t end = avr_mstimestamp() + timeout;
+
+  while(!*done) {
+    struct timeval tv = { 0, 100000 };
+    int rc = libusb_handle_events_timeout_completed(u->ctx, &tv, done);
+
+    if(rc < 0 && rc != LIBUSB_ERROR_INTERRUPTED) {
+      pmsg_notice2("%s(): %s\n", __func__, libusb_strerror(rc));
+      return -1;
+    }
+    if(!*done && avr_mstimestamp() > end)
+      return -1;
+  }
+
+  return 0;
+}
+
+static int usb1_fill(Usb1_dev *u, struct libusb_transfer *xfer, int ep, unsigned char *buf, int len,
+  int *done, unsigned timeout) {
+
+  *done = 0;
+  if(u->interrupt)
+    libusb_fill_interrupt_transfer(xfer, u->dev, ep, buf, len, usb1_callback, done, timeout);
+  else
+    libusb_fill_bulk_transfer(xfer, u->dev, ep, buf, len, usb1_callback, done, timeout);
+
+  return libusb_submit_transfer(xfer);
+}
+
+static int usb1_submit_in(Usb1_dev *u, Usb1_inq *q, int i) {
+  Usb1_slot *s = q->slot + i;
+  // IN transfers wait for the device indefinitely; usb1_take() times out instead
+  int rc = usb1_fill(u, s->xfer, q->ep, s->buf, u->max_xfer, &s->done, 0);
+
+  if(rc < 0) {
+    pmsg_notice2("%s(): cannot queue read on EP 0x%02x: %s\n", __func__, q->ep, libusb_strerror(rc));
+    s->done = 1;
+    s->xfer->status = LIBUSB_TRANSFER_ERROR;
+  }
+
+  return rc;
+}
+
+// Cancel all outstanding transfers of q and wait for their cancellation
+static void usb1_cancel(Usb1_dev *u, Usb1_inq *q) {
+  for(int i = 0; i < USB1_NIN; i++)
+    if(!q->slot[i].done)
+      libusb_cancel_transfer(q->slot[i].xfer);
+  for(int i = 0; i < USB1_NIN; i++)
+    if(usb1_wait(u, &q->slot[i].done, 1000) < 0)
+      pmsg_warning("cannot cancel read on EP 0x%02x\n", q->ep);
+}
+
+// Drop whatever q has received and queue fresh transfers
+static void usb1_restart(Usb1_dev *u, Usb1_inq *q) {
+  usb1_cancel(u, q);
+  q->head = q->ptr = 0;
+  for(int i = 0; i < USB1_NIN; i++)
+    usb1_submit_in(u, q, (q->head + i)%USB1_NIN);
+}
+
+// Return the queue of IN endpoint ep, setting it up if needed
+static Usb1_inq *usb1_queue(Usb1_dev *u, int ep) {
+  Usb1_inq *q;
+
+  for(int i = 0; i < u->ninq; i++)
+    if(u->inq[i].ep == ep)
+      return u->inq + i;
+
+  if(u->ninq == USB1_NEP) {
+    pmsg_error("too many read endpoints\n");
+    return NULL;
+  }
+  q = u->inq + u->ninq++;
+  q->ep = ep;
+  q->head = q->ptr = 0;
+  for(int i = 0; i < USB1_NIN; i++) {
+    q->slot[i].xfer = libusb_alloc_transfer(0);
+    q->slot[i].buf = mmt_malloc(u->max_xfer);
+    q->slot[i].done = 1;
+  }
+  for(int i = 0; i < USB1_NIN; i++)
+    usb1_submit_in(u, q, i);
+
+  return q;
+}
+
+/*
+ * Wait for the head transfer of q and return the number of bytes it received
+ * or -1 on error; the caller consumes q->slot[q->head].buf and then calls
+ * usb1_release()
+ */
+static int usb1_take(Usb1_dev *u, Usb1_inq *q, int timeout) {
+  Usb1_slot *s = q->slot + q->head;
+
+  if(usb1_wait(u, &s->done, timeout) < 0) {
+    pmsg_notice2("%s(): read on EP 0x%02x timed out\n", __func__, q->ep);
+    usb1_restart(u, q);         // Do not serve late answers to the next request
+    return -1;
+  }
+  if(s->xfer->status != LIBUSB_TRANSFER_COMPLETED) {
+    pmsg_notice2("%s(): read on EP 0x%02x failed, status %d\n", __func__, q->ep, (int) s->xfer->status);
+    if(s->xfer->status == LIBUSB_TRANSFER_STALL)
+      libusb_clear_halt(u->dev, q->ep);
+    usb1_restart(u, q);
+    return -1;
+  }
+
+  return s->xfer->actual_length;
+}
+
+// Resubmit the consumed head transfer at the end of the queue
+static void usb1_release(Usb1_dev *u, Usb1_inq *q) {
+  int i = q->head;
+
+  q->head = (q->head + 1)%USB1_NIN;
+  q->ptr = 0;
+  usb1_submit_in(u, q, i);
+}
+
+/*
+ * The baud parameter is meaningless for USB devices, so we reuse it to pass
+ * the desired USB device ID.
+ */
+static int usb1_open(const char *port, union pinfo pinfo, union filedescriptor *fd) {
+  char string[256], product[256], *s, serno[64] = { 0 };
+  const char *serp;
+  libusb_context *ctx;
+  libusb_device **list;
+  libusb_device_handle *dev;
+  ssize_t ndev;
+  int rc;
+
+  // -P usb[:serialnumber], see usb_libusb.c
+  if((serp = strchr(port, ':')) && *++serp) {
+    for(s = serno; *serp && s < serno + sizeof serno - 1; serp++)
+      if(*serp != ':')
+        *s++ = *serp;
+    *s = 0;
+  }
+
+  if(fd->usb.max_xfer == 0)
+    fd->usb.max_xfer = USBDEV_MAX_XFER_MKII;
+
+  if((rc = libusb_init(&ctx)) < 0) {
+    pmsg_error("cannot initialise libusb: %s\n", libusb_strerror(rc));
+    return -1;
+  }
+  if((ndev = libusb_get_device_list(ctx, &list)) < 0) {
+    pmsg_error("cannot list USB devices: %s\n", libusb_strerror((int) ndev));
+    libusb_exit(ctx);
+    return -1;
+  }
+
+  for(ssize_t d = 0; d < ndev; d++) {
+    struct libusb_device_descriptor desc;
+    struct libusb_config_descriptor *conf = NULL;
+    const struct libusb_interface_descriptor *alt = NULL;
+    int iface, cfg;
+
+    if(libusb_get_device_descriptor(list[d], &desc) < 0 ||
+      desc.idVendor != pinfo.usbinfo.vid || desc.idProduct != pinfo.usbinfo.pid)
+      continue;
+
+    if((rc = libusb_open(list[d], &dev)) < 0) {
+      pmsg_warning("cannot open device: %s\n", libusb_strerror(rc));
+      cx->usb_access_error = 1;
+      continue;
+    }
+
+    if(libusb_get_string_descriptor_ascii(dev, desc.iSerialNumber, (unsigned char *) string, sizeof string) < 0) {
+      pmsg_warning("cannot read serial number\n");
+      cx->usb_access_error = 1;
+      if(*serno) {              // No chance of serno matches
+        libusb_close(dev);
+        goto none_matching;
+      }
+      strcpy(string, "[unknown]");
+    }
+    if(serdev)
+      serdev->usbsn = cache_string(string);
+    if(libusb_get_string_descriptor_ascii(dev, desc.iProduct, (unsigned char *) product, sizeof product) < 0) {
+      pmsg_warning("cannot read product name\n");
+      strcpy(product, "[unnamed product]");
+    }
+    if(serdev)
+      serdev->usbproduct = cache_string(product);
+
+    // Same device quirks as usbdev_open() in usb_libusb.c
+    if(str_casestarts(product, "MPLAB") && (str_caseends(product, "Snap ICD")
+        || str_caseends(product, "PICkit 4"))) {
+      pinfo.usbinfo.flags = 0;
+      fd->usb.wep = 2;
+    }
+    if(str_contains(product, "CMSIS-DAP")) {
+      pinfo.usbinfo.flags |= PINFO_FL_USEHID;
+      fd->usb.eep = 0;
+    }
+    if(str_contains(product, "mEDBG")) {
+      fd->usb.rep = 0x81;
+      fd->usb.wep = 0x02;
+    }
+
+    pmsg_notice("%s(): found %s, serno: %s\n", __func__, product, string);
+    if(*serno) {
+      int x = strlen(string) - strlen(serno);
+
+      if(x < 0 || !str_caseeq(string + x, serno)) {
+        pmsg_debug("%s(): serial number does not match\n", __func__);
+        libusb_close(dev);
+        continue;
+      }
+    }
+
+    if(libusb_get_config_descriptor(list[d], 0, &conf) < 0) {
+      pmsg_warning("USB device has no configuration\n");
+      goto trynext;
+    }
+    // Only set the configuration if needed: doing so resets the device's endpoints
+    if(libusb_get_configuration(dev, &cfg) < 0 || cfg != conf->bConfigurationValue)
+      if((rc = libusb_set_configuration(dev, conf->bConfigurationValue)) < 0)
+        pmsg_notice("(config %d) %s\n", conf->bConfigurationValue, libusb_strerror(rc));
+
+    // Many Linux systems attach the usbhid driver to any HID-class device
+    libusb_set_auto_detach_kernel_driver(dev, 1);
+
+    fd->usb.use_interrupt_xfer = 0;
+    for(iface = 0; iface < conf->bNumInterfaces; iface++) {
+      alt = conf->interface[iface].altsetting;
+      cx->usb_interface = alt->bInterfaceNumber;
+      if((rc = libusb_claim_interface(dev, cx->usb_interface)) < 0) {
+        pmsg_warning("(i/face %d) %s\n", cx->usb_interface, libusb_strerror(rc));
+        cx->usb_access_error = 1;
+        continue;
+      }
+      if(pinfo.usbinfo.flags & PINFO_FL_USEHID) {
+        // Only consider an interface that is of class HID
+        if(alt->bInterfaceClass != LIBUSB_CLASS_HID) {
+          libusb_release_interface(dev, cx->usb_interface);
+          continue;
+        }
+        fd->usb.use_interrupt_xfer = 1;
+      }
+      break;
+    }
+    if(iface == conf->bNumInterfaces) {
+      pmsg_warning("no usable interface found\n");
+      goto trynext;
+    }
+
+    if(fd->usb.rep == 0) {      // Try finding out what our read endpoint is
+      for(int i = 0; i < alt->bNumEndpoints; i++)
+        if(alt->endpoint[i].bEndpointAddress & LIBUSB_ENDPOINT_IN) {
+          fd->usb.rep = alt->endpoint[i].bEndpointAddress;
+          pmsg_notice2("%s(): using read endpoint 0x%02x\n", __func__, fd->usb.rep);
+          break;
+        }
+      if(fd->usb.rep == 0) {
+        pmsg_warning("cannot find a read endpoint, using 0x%02x\n", USBDEV_BULK_EP_READ_MKII);
+        fd->usb.rep = USBDEV_BULK_EP_READ_MKII;
+      }
+    }
+    for(int i = 0; i < alt->bNumEndpoints; i++) {
+      const struct libusb_endpoint_descriptor *ep = alt->endpoint + i;
+
+      if((ep->bEndpointAddress == fd->usb.rep || ep->bEndpointAddress == fd->usb.wep) &&
+        ep->wMaxPacketSize < fd->usb.max_xfer) {
+        pmsg_notice("max packet size expected %d, but found %d due to EP 0x%02x's wMaxPacketSize\n",
+          fd->usb.max_xfer, ep->wMaxPacketSize, ep->bEndpointAddress);
+        fd->usb.max_xfer = ep->wMaxPacketSize;
+      }
+    }
+    if(pinfo.usbinfo.flags & PINFO_FL_USEHID)
+      if(libusb_control_transfer(dev, 0x21, 0x0a /* SET_IDLE */ , 0, 0, NULL, 0, 100) < 0)
+        pmsg_warning("SET_IDLE failed\n");
+
+    libusb_free_config_descriptor(conf);
+    libusb_free_device_list(list, 1);
+
+    Usb1_dev *u = mmt_malloc(sizeof *u);
+
+    u->ctx = ctx;
+    u->dev = dev;
+    u->iface = cx->usb_interface;
+    u->max_xfer = fd->usb.max_xfer;
+    u->interrupt = fd->usb.use_interrupt_xfer;
+    fd->usb.handle = u;
+
+    // Have reads pending before the first command goes out
+    usb1_queue(u, fd->usb.rep);
+    if(fd->usb.eep)
+      usb1_queue(u, fd->usb.eep);
+
+    return 0;
+
+  trynext:
+    if(conf)
+      libusb_free_config_descriptor(conf);
+    libusb_close(dev);
+  }
+
+none_matching:
+  libusb_free_device_list(list, 1);
+  libusb_exit(ctx);
+  if((pinfo.usbinfo.flags & PINFO_FL_SILENT) == 0)
+    pmsg_error("%s%s USB device %s (%04x:%04x)\n",
+      cx->usb_access_error? "found but could not access": "did not find any",
+      *serno && !cx->usb_access_error? " (matching)": "", port, pinfo.usbinfo.vid, pinfo.usbinfo.pid);
+
+  return -1;
+}
+
+static void usb1_close(union filedescriptor *fd) {
+  Usb1_dev *u = (Usb1_dev *) fd->usb.handle;
+
+  if(u == NULL)
+    return;
+
+  for(int i = 0; i < u->ninq; i++) {
+    usb1_cancel(u, u->inq + i);
+    for(int k = 0; k < USB1_NIN; k++) {
+      libusb_free_transfer(u->inq[i].slot[k].xfer);
+      mmt_free(u->inq[i].slot[k].buf);
+    }
+  }
+  (void) libusb_release_interface(u->dev, u->iface);
+
+#if defined(__linux__)
+  // Without this reset, the AVRISP mkII seems to stall the second time we try to connect to it
+  libusb_reset_device(u->dev);
+#endif
+
+  libusb_close(u->dev);
+  libusb_exit(u->ctx);
+  mmt_free(u);
+  fd->usb.handle = NULL;
+}
+
+/*
+ * Split the frame into packets of at most max_xfer bytes, as the device needs
+ * to see a short packet to know the frame is finished; submit up to USB1_NOUT
+ * of them at once and wait for all to complete.
+ */
+static int usb1_send(const union filedescriptor *fd, const unsigned char *bp, size_t mlen) {
+  Usb1_dev *u = (Usb1_dev *) fd->usb.handle;
+  struct libusb_transfer *xfer[USB1_NOUT];
+  int done[USB1_NOUT], size[USB1_NOUT], n, ret = 0;
+  const unsigned char *p = bp;
+  size_t len = mlen;
+
+  if(u == NULL)
+    return -1;
+
+  for(n = 0; n < USB1_NOUT; n++)
+    xfer[n] = libusb_alloc_transfer(0);
+
+  do {
+    for(n = 0; n < USB1_NOUT && (n == 0 || mlen > 0); n++) {
+      size[n] = (int) mlen < fd->usb.max_xfer? (int) mlen: fd->usb.max_xfer;
+      if((ret = usb1_fill(u, xfer[n], fd->usb.wep, (unsigned char *) bp, size[n], done + n, USB1_TIMEOUT)) < 0) {
+        pmsg_error("cannot submit %d bytes: %s\n", size[n], libusb_strerror(ret));
+        break;
+      }
+      bp += size[n];
+      mlen -= size[n];
+    }
+    for(int i = 0; i < n; i++) {
+      if(usb1_wait(u, done + i, USB1_TIMEOUT + 1000) < 0) {
+        libusb_cancel_transfer(xfer[i]);
+        usb1_wait(u, done + i, 1000);
+      }
+      if(ret >= 0 && (xfer[i]->status != LIBUSB_TRANSFER_COMPLETED || xfer[i]->actual_length != size[i])) {
+        pmsg_error("wrote %d out of %d bytes, status %d\n", xfer[i]->actual_length, size[i], (int) xfer[i]->status);
+        ret = -1;
+      }
+    }
+  } while(ret >= 0 && mlen > 0);
+
+  for(n = 0; n < USB1_NOUT; n++)
+    libusb_free_transfer(xfer[n]);
+
+  if(ret < 0)
+    return -1;
+  if(verbose >= MSG_TRACE)
+    trace_buffer(__func__, p, len);
+
+  return 0;
+}
+
+// Byte stream read served from the queued transfers of the read endpoint
+static int usb1_recv(const union filedescriptor *fd, unsigned char *buf, size_t nbytes) {
+  Usb1_dev *u = (Usb1_dev *) fd->usb.handle;
+  Usb1_inq *q;
+  size_t i = 0;
+
+  if(u == NULL || !(q = usb1_queue(u, fd->usb.rep)))
+    return -1;
+
+  while(i < nbytes) {
+    int got = usb1_take(u, q, USB1_TIMEOUT), amnt;
+
+    if(got < 0)
+      return -1;
+    amnt = got - q->ptr > (int) (nbytes - i)? (int) (nbytes - i): got - q->ptr;
+    memcpy(buf + i, q->slot[q->head].buf + q->ptr, amnt);
+    q->ptr += amnt;
+    i += amnt;
+    if(q->ptr >= got)
+      usb1_release(u, q);
+  }
+
+  if(verbose >= MSG_TRACE2)
+    trace_buffer(__func__, buf, i);
+
+  return 0;
+}
+
+/*
+ * Read packets until a short packet arrives and return the length of the
+ * assembled frame, or -1 on error; see usbdev_recv_frame() in usb_libusb.c
+ */
+static int usb1_recv_frame(const union filedescriptor *fd, unsigned char *buf, size_t nbytes) {
+  Usb1_dev *u = (Usb1_dev *) fd->usb.handle;
+  Usb1_inq *q;
+  unsigned char *p = buf;
+  int rv, n;
+
+  if(u == NULL)
+    return -1;
+
+  // If there's an event EP, and it has data pending, return it first
+  if(fd->usb.eep != 0 && (q = usb1_queue(u, fd->usb.eep))) {
+    struct timeval zero = { 0, 0 };
+
+    libusb_handle_events_timeout_completed(u->ctx, &zero, NULL);
+    if(q->slot[q->head].done && (rv = usb1_take(u, q, 0)) >= 0) {
+      if(rv > 4 && rv <= (int) nbytes) {
+        memcpy(buf, q->slot[q->head].buf, rv);
+        usb1_release(u, q);
+        n = rv | USB_RECV_FLAG_EVENT;
+        goto printout;
+      }
+      if(rv > 0)
+        pmsg_warning("short event len = %d, ignored\n", rv);
+      usb1_release(u, q);
+    }
+  }
+
+  if(!(q = usb1_queue(u, fd->usb.rep)))
+    return -1;
+
+  n = 0;
+  do {
+    if((rv = usb1_take(u, q, USB1_TIMEOUT)) < 0)
+      return -1;
+    if(rv > (int) nbytes) {
+      usb1_release(u, q);
+      return -1;                // Buffer overflow
+    }
+    memcpy(buf, q->slot[q->head].buf, rv);
+    usb1_release(u, q);
+    buf += rv;
+    n += rv;
+    nbytes -= rv;
+  } while(nbytes > 0 && rv == fd->usb.max_xfer);
+
+printout:
+  if(verbose >= MSG_TRACE)
+    trace_buffer(__func__, p, n & USB_RECV_LENGTH_MASK);
+
+  return n;
+}
+
+static int usb1_drain(const union filedescriptor *fd, int display) {
+  // Endpoints start afresh after configuration, see usbdev_drain() in usb_libusb.c
+  return 0;
+}
+
+// Device descriptor for the JTAG ICE mkII
+struct serial_device usb_serdev = {
+  .open = usb1_open,
+  .close = usb1_close,
+  .rawclose = usb1_close,
+  .send = usb1_send,
+  .recv = usb1_recv,
+  .drain = usb1_drain,
+  .flags = SERDEV_FL_NONE,
+};
+
+// Device descriptor for the AVRISP mkII
+struct serial_device usb_serdev_frame = {
+  .open = usb1_open,
+  .close = usb1_close,
+  .rawclose = usb1_close,
+  .send = usb1_send,
+  .recv = usb1_recv_frame,
+  .drain = usb1_drain,
+  .flags = SERDEV_FL_NONE,
+};
+#endif                          // USE_LIBUSB_1_0_SERDEV
@@ -78,6 +78,12 @@
 #define USBDEV_BULK_EP_READ_MKII  0x82
 #define USBDEV_MAX_XFER_MKII 64
 
+// Native libusb-1.0 implementation of usb_serdev and usb_serdev_frame, see usb_libusb1.c
+#if defined(HAVE_LIBUSB) && defined(HAVE_LIBUSB_1_0) && !defined(WIN32) && \
+  (defined(HAVE_LIBUSB_1_0_LIBUSB_H) || defined(HAVE_LIBUSB_H))
+#define USE_LIBUSB_1_0_SERDEV
+#endif
+
 // STK600
 #define USBDEV_BULK_EP_WRITE_STK600 0x02
 #define USBDEV_BULK_EP_READ_STK600 0x83